@@ -0,0 +1,544 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "archive.h"
+
+#define ARCHIVE_BUFFER (1 << 20)
+#define BLOCK_ALIGN    8
+
+#define ROW(field) offsetof(TelemetryRecord, field)
+
+const ArchiveColumn archive_columns[ARCHIVE_COLUMNS] = {
+    { "tick",     ROW(tick),         COLUMN_U64,    CODEC_DOD },
+    { "sim_time", ROW(sim_time),     COLUMN_DOUBLE, CODEC_DOD },
+    { "throttle", ROW(car.throttle), COLUMN_DOUBLE, CODEC_XOR },
+    { "brake",    ROW(car.brake),    COLUMN_DOUBLE, CODEC_RLE },
+    { "steer",    ROW(car.steer),    COLUMN_DOUBLE, CODEC_XOR },
+    { "gear",     ROW(car.gear),     COLUMN_INT,    CODEC_RLE },
+    { "speed",    ROW(car.speed),    COLUMN_DOUBLE, CODEC_XOR },
+    { "x",        ROW(car.x),        COLUMN_DOUBLE, CODEC_DOD },
+    { "y",        ROW(car.y),        COLUMN_DOUBLE, CODEC_DOD },
+    { "heading",  ROW(car.heading),  COLUMN_DOUBLE, CODEC_XOR },
+    { "rpm",      ROW(car.rpm),      COLUMN_DOUBLE, CODEC_XOR },
+    { "power",    ROW(car.power),    COLUMN_DOUBLE, CODEC_XOR },
+    { "torque",   ROW(car.torque),   COLUMN_DOUBLE, CODEC_XOR },
+    { "fuel",     ROW(car.fuel),     COLUMN_DOUBLE, CODEC_XOR },
+    { "reverse",  ROW(car.reverse),  COLUMN_BOOL,   CODEC_RLE },
+};
+
+static inline uint64_t zigzag(int64_t v) {
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static inline int64_t unzigzag(uint64_t z) {
+    return (int64_t)(z >> 1) ^ -(int64_t)(z & 1);
+}
+
+/* Every column is handled as 64 raw bits: doubles by pattern, ints zigzagged. */
+static uint64_t column_raw(int column, const TelemetryRecord *row) {
+    const ArchiveColumn *c = &archive_columns[column];
+    const char *p = (const char *)row + c->offset;
+    uint64_t raw;
+    int i;
+
+    switch (c->type) {
+    case COLUMN_INT:
+        memcpy(&i, p, sizeof(i));
+        return zigzag(i);
+    case COLUMN_BOOL:
+        return *(const bool *)p;
+    default:
+        memcpy(&raw, p, sizeof(raw));
+        return raw;
+    }
+}
+
+double archive_value(int column, uint64_t raw) {
+    double d;
+
+    switch (archive_columns[column].type) {
+    case COLUMN_U64:
+        return (double)raw;
+    case COLUMN_INT:
+        return (double)unzigzag(raw);
+    case COLUMN_BOOL:
+        return raw ? 1.0 : 0.0;
+    default:
+        memcpy(&d, &raw, sizeof(d));
+        return d;
+    }
+}
+
+int archive_column_index(const char *name) {
+    for (int c = 0; c < ARCHIVE_COLUMNS; c++)
+        if (strcmp(archive_columns[c].name, name) == 0)
+            return c;
+    return -1;
+}
+
+/* ---------------- ENCODING ---------------- */
+
+typedef struct {
+    uint8_t *data;
+    size_t   len, cap;
+    uint64_t acc;               // bits not yet in data, right-aligned
+    int      nbits;
+
+    uint64_t prev, prev_delta;  // DOD, XOR
+    int      lead, trail;       // XOR window; lead < 0: none yet
+    uint64_t run_value;         // RLE
+    uint32_t run;
+
+    double   min, max;
+} ColumnEncoder;
+
+struct ArchiveVehicle {
+    uint32_t      rows;
+    ColumnEncoder col[ARCHIVE_COLUMNS];
+};
+
+static void put_byte(ColumnEncoder *e, uint8_t b) {
+    if (e->len == e->cap) {
+        e->cap = e->cap ? e->cap * 2 : 1024;
+        e->data = realloc(e->data, e->cap);
+    }
+    e->data[e->len++] = b;
+}
+
+static void put_bits(ColumnEncoder *e, uint64_t value, int n) {
+    if (n > 32) {
+        put_bits(e, value >> 32, n - 32);
+        n = 32;
+    }
+    e->acc = (e->acc << n) | (value & ((1ull << n) - 1));
+    e->nbits += n;
+    while (e->nbits >= 8) {
+        e->nbits -= 8;
+        put_byte(e, (uint8_t)(e->acc >> e->nbits));
+    }
+}
+
+static void put_varint(ColumnEncoder *e, uint64_t v) {
+    while (v >= 0x80) {
+        put_byte(e, (uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    put_byte(e, (uint8_t)v);
+}
+
+/* 0 | 10+7 | 110+9 | 1110+12 | 1111+len(6)+len bits, of the zigzagged value */
+static void put_dod(ColumnEncoder *e, int64_t dod) {
+    uint64_t z = zigzag(dod);
+
+    if (z == 0) {
+        put_bits(e, 0, 1);
+    } else if (z < (1u << 7)) {
+        put_bits(e, 0x2, 2);
+        put_bits(e, z, 7);
+    } else if (z < (1u << 9)) {
+        put_bits(e, 0x6, 3);
+        put_bits(e, z, 9);
+    } else if (z < (1u << 12)) {
+        put_bits(e, 0xE, 4);
+        put_bits(e, z, 12);
+    } else {
+        int len = 64 - __builtin_clzll(z);
+        put_bits(e, 0xF, 4);
+        put_bits(e, (uint64_t)(len - 1), 6);
+        put_bits(e, z, len);
+    }
+}
+
+/* 0: same | 10 + bits in the previous window | 11 + lead(6) + len-1(6) + bits */
+static void put_xor(ColumnEncoder *e, uint64_t x) {
+    if (x == 0) {
+        put_bits(e, 0, 1);
+        return;
+    }
+
+    int lead  = __builtin_clzll(x);
+    int trail = __builtin_ctzll(x);
+    if (e->lead >= 0 && lead >= e->lead && trail >= e->trail) {
+        put_bits(e, 0x2, 2);
+        put_bits(e, x >> e->trail, 64 - e->lead - e->trail);
+    } else {
+        int sig = 64 - lead - trail;
+        put_bits(e, 0x3, 2);
+        put_bits(e, (uint64_t)lead, 6);
+        put_bits(e, (uint64_t)(sig - 1), 6);
+        put_bits(e, x >> trail, sig);
+        e->lead  = lead;
+        e->trail = trail;
+    }
+}
+
+static void encoder_add(ColumnEncoder *e, int column, uint64_t raw, bool first) {
+    double v = archive_value(column, raw);
+
+    if (first) {
+        e->min = e->max = v;
+        e->prev = raw;
+        e->prev_delta = 0;
+        e->lead = -1;
+        if (archive_columns[column].codec == CODEC_RLE) {
+            e->run_value = raw;
+            e->run = 1;
+        } else {
+            put_bits(e, raw, 64);
+        }
+        return;
+    }
+
+    if (v < e->min) e->min = v;
+    if (v > e->max) e->max = v;
+
+    switch (archive_columns[column].codec) {
+    case CODEC_DOD: {
+        uint64_t delta = raw - e->prev;
+        put_dod(e, (int64_t)(delta - e->prev_delta));
+        e->prev_delta = delta;
+        break;
+    }
+    case CODEC_XOR:
+        put_xor(e, raw ^ e->prev);
+        break;
+    case CODEC_RLE:
+        if (raw == e->run_value) {
+            e->run++;
+        } else {
+            put_varint(e, e->run);
+            put_varint(e, e->run_value);
+            e->run_value = raw;
+            e->run = 1;
+        }
+        break;
+    }
+    e->prev = raw;
+}
+
+static void encoder_finish(ColumnEncoder *e, int column) {
+    if (archive_columns[column].codec == CODEC_RLE) {
+        put_varint(e, e->run);
+        put_varint(e, e->run_value);
+    }
+    if (e->nbits > 0)
+        put_byte(e, (uint8_t)(e->acc << (8 - e->nbits)));
+    e->nbits = 0;
+    e->acc = 0;
+}
+
+/* ---------------- WRITING ---------------- */
+
+static void flush_block(ArchiveWriter *w, uint32_t vehicle, ArchiveVehicle *v) {
+    ArchiveBlock b = { .magic = ARCHIVE_BLOCK_MAGIC, .vehicle = vehicle, .rows = v->rows };
+    uint32_t offset = sizeof(ArchiveBlock);
+
+    for (int c = 0; c < ARCHIVE_COLUMNS; c++) {
+        ColumnEncoder *e = &v->col[c];
+        encoder_finish(e, c);
+        b.column[c] = (ArchiveColumnInfo){ offset, (uint32_t)e->len, e->min, e->max };
+        offset += (uint32_t)e->len;
+    }
+    uint32_t pad = (BLOCK_ALIGN - offset % BLOCK_ALIGN) % BLOCK_ALIGN;
+    b.bytes = offset + pad;
+
+    static const uint8_t zeros[BLOCK_ALIGN];
+    fwrite(&b, sizeof(b), 1, w->f);
+    for (int c = 0; c < ARCHIVE_COLUMNS; c++) {
+        fwrite(v->col[c].data, 1, v->col[c].len, w->f);
+        v->col[c].len = 0;
+    }
+    fwrite(zeros, 1, pad, w->f);
+
+    w->blocks++;
+    w->bytes += b.bytes;
+    v->rows = 0;
+}
+
+ArchiveWriter *archive_create(const char *path, double dt) {
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        perror(path);
+        return NULL;
+    }
+    setvbuf(f, NULL, _IOFBF, ARCHIVE_BUFFER);
+
+    ArchiveWriter *w = calloc(1, sizeof(ArchiveWriter));
+    w->f = f;
+    w->vehicles = calloc(MAX_VEHICLES, sizeof(ArchiveVehicle *));
+
+    ArchiveHeader h = {
+        .version    = ARCHIVE_VERSION,
+        .columns    = ARCHIVE_COLUMNS,
+        .block_rows = ARCHIVE_BLOCK_ROWS,
+        .dt         = dt,
+    };
+    memcpy(h.magic, ARCHIVE_MAGIC, sizeof(h.magic));
+    fwrite(&h, sizeof(h), 1, f);
+    w->bytes = sizeof(h);
+    return w;
+}
+
+void archive_append(ArchiveWriter *w, const TelemetryRecord *row) {
+    if (row->vehicle >= MAX_VEHICLES)
+        return;
+
+    ArchiveVehicle *v = w->vehicles[row->vehicle];
+    if (!v)
+        v = w->vehicles[row->vehicle] = calloc(1, sizeof(ArchiveVehicle));
+
+    for (int c = 0; c < ARCHIVE_COLUMNS; c++)
+        encoder_add(&v->col[c], c, column_raw(c, row), v->rows == 0);
+
+    w->rows++;
+    if (++v->rows == ARCHIVE_BLOCK_ROWS)
+        flush_block(w, row->vehicle, v);
+}
+
+void archive_flush(ArchiveWriter *w) {
+    for (uint32_t i = 0; i < MAX_VEHICLES; i++)
+        if (w->vehicles[i] && w->vehicles[i]->rows)
+            flush_block(w, i, w->vehicles[i]);
+    fflush(w->f);
+}
+
+void archive_close(ArchiveWriter *w) {
+    if (!w)
+        return;
+
+    archive_flush(w);
+    for (uint32_t i = 0; i < MAX_VEHICLES; i++) {
+        ArchiveVehicle *v = w->vehicles[i];
+        if (!v)
+            continue;
+        for (int c = 0; c < ARCHIVE_COLUMNS; c++)
+            free(v->col[c].data);
+        free(v);
+    }
+    if (fclose(w->f) != 0)
+        perror("archive");
+    free(w->vehicles);
+    free(w);
+}
+
+/* ---------------- READING ---------------- */
+
+ArchiveReader *archive_open(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return NULL;
+    }
+
+    struct stat st;
+    fstat(fd, &st);
+    if ((size_t)st.st_size < sizeof(ArchiveHeader)) {
+        fprintf(stderr, "%s: too short for an archive\n", path);
+        close(fd);
+        return NULL;
+    }
+
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        return NULL;
+    }
+
+    const ArchiveHeader *h = map;
+    if (memcmp(h->magic, ARCHIVE_MAGIC, sizeof(h->magic)) != 0 ||
+        h->version != ARCHIVE_VERSION || h->columns != ARCHIVE_COLUMNS ||
+        h->block_rows != ARCHIVE_BLOCK_ROWS) {
+        fprintf(stderr, "%s: not a version %d archive from this build\n",
+                path, ARCHIVE_VERSION);
+        munmap(map, (size_t)st.st_size);
+        return NULL;
+    }
+
+    ArchiveReader *r = calloc(1, sizeof(ArchiveReader));
+    r->data   = map;
+    r->size   = (size_t)st.st_size;
+    r->header = h;
+    return r;
+}
+
+void archive_close_reader(ArchiveReader *r) {
+    if (!r)
+        return;
+    munmap((void *)r->data, r->size);
+    free(r);
+}
+
+const ArchiveBlock *archive_next_block(const ArchiveReader *r, const ArchiveBlock *prev) {
+    size_t at = prev ? (size_t)((const uint8_t *)prev - r->data) + prev->bytes
+                     : sizeof(ArchiveHeader);
+    if (at + sizeof(ArchiveBlock) > r->size)
+        return NULL;
+
+    /* A block cut short by a dead writer ends the archive */
+    const ArchiveBlock *b = (const ArchiveBlock *)(r->data + at);
+    if (b->magic != ARCHIVE_BLOCK_MAGIC || b->bytes < sizeof(ArchiveBlock) ||
+        b->bytes > r->size - at || b->rows == 0 || b->rows > ARCHIVE_BLOCK_ROWS)
+        return NULL;
+    for (int c = 0; c < ARCHIVE_COLUMNS; c++)
+        if (b->column[c].offset > b->bytes ||
+            b->column[c].bytes > b->bytes - b->column[c].offset)
+            return NULL;
+    return b;
+}
+
+bool archive_block_overlaps(const ArchiveBlock *b, int column, double lo, double hi) {
+    return b->column[column].max >= lo && b->column[column].min <= hi;
+}
+
+/* ---------------- DECODING ---------------- */
+
+/* MSB-first bit reader; reads past the end return zeros. */
+typedef struct {
+    const uint8_t *p, *end;
+    uint64_t buf;               // left-aligned
+    int      avail;
+} BitReader;
+
+static inline void refill(BitReader *r) {
+    if (r->end - r->p >= 8) {
+        uint64_t w;
+        memcpy(&w, r->p, sizeof(w));
+        r->buf |= __builtin_bswap64(w) >> r->avail;
+        r->p += (63 - r->avail) >> 3;
+        r->avail |= 56;
+    } else {
+        while (r->avail <= 56) {
+            uint64_t byte = r->p < r->end ? *r->p++ : 0;
+            r->buf |= byte << (56 - r->avail);
+            r->avail += 8;
+        }
+    }
+}
+
+static inline uint64_t get_bits(BitReader *r, int n) {     // 1 .. 56
+    if (r->avail < n)
+        refill(r);
+    uint64_t v = r->buf >> (64 - n);
+    r->buf <<= n;
+    r->avail -= n;
+    return v;
+}
+
+static inline uint64_t get_wide(BitReader *r, int n) {     // 1 .. 64
+    if (n <= 32)
+        return get_bits(r, n);
+    uint64_t hi = get_bits(r, n - 32);
+    return (hi << 32) | get_bits(r, 32);
+}
+
+static void decode_dod(BitReader *r, uint64_t *raw, uint32_t rows) {
+    uint64_t delta = 0;
+
+    raw[0] = get_wide(r, 64);
+    for (uint32_t i = 1; i < rows; i++) {
+        uint64_t z;
+        if (r->avail < 16)
+            refill(r);
+
+        if (!get_bits(r, 1))
+            z = 0;
+        else if (!get_bits(r, 1))
+            z = get_bits(r, 7);
+        else if (!get_bits(r, 1))
+            z = get_bits(r, 9);
+        else if (!get_bits(r, 1))
+            z = get_bits(r, 12);
+        else
+            z = get_wide(r, (int)get_bits(r, 6) + 1);
+
+        delta += (uint64_t)unzigzag(z);
+        raw[i] = raw[i - 1] + delta;
+    }
+}
+
+static void decode_xor(BitReader *r, uint64_t *raw, uint32_t rows) {
+    int lead = 0, trail = 0;
+
+    raw[0] = get_wide(r, 64);
+    for (uint32_t i = 1; i < rows; i++) {
+        if (!get_bits(r, 1)) {
+            raw[i] = raw[i - 1];
+            continue;
+        }
+        if (get_bits(r, 1)) {
+            lead = (int)get_bits(r, 6);
+            int sig = (int)get_bits(r, 6) + 1;
+            trail = 64 - lead - sig;
+        }
+        raw[i] = raw[i - 1] ^ (get_wide(r, 64 - lead - trail) << trail);
+    }
+}
+
+static uint64_t get_varint(const uint8_t **p, const uint8_t *end) {
+    uint64_t v = 0;
+    for (int shift = 0; *p < end && shift < 64; shift += 7) {
+        uint8_t b = *(*p)++;
+        v |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80))
+            break;
+    }
+    return v;
+}
+
+static void decode_rle(const uint8_t *p, const uint8_t *end, uint64_t *raw, uint32_t rows) {
+    uint32_t i = 0;
+    while (i < rows) {
+        uint64_t run   = get_varint(&p, end);
+        uint64_t value = get_varint(&p, end);
+        if (run == 0 || run > rows - i)
+            run = rows - i;             // corrupt: fill the rest
+        for (uint64_t k = 0; k < run; k++)
+            raw[i++] = value;
+    }
+}
+
+void archive_decode_column(const ArchiveBlock *b, int column, uint64_t *raw) {
+    const uint8_t *p = (const uint8_t *)b + b->column[column].offset;
+    const uint8_t *end = p + b->column[column].bytes;
+
+    if (archive_columns[column].codec == CODEC_RLE) {
+        decode_rle(p, end, raw, b->rows);
+        return;
+    }
+
+    BitReader r = { p, end, 0, 0 };
+    if (archive_columns[column].codec == CODEC_DOD)
+        decode_dod(&r, raw, b->rows);
+    else
+        decode_xor(&r, raw, b->rows);
+}
+
+void archive_decode_block(const ArchiveBlock *b, TelemetryRecord *rows) {
+    uint64_t raw[ARCHIVE_BLOCK_ROWS];
+
+    memset(rows, 0, b->rows * sizeof(TelemetryRecord));
+    for (int c = 0; c < ARCHIVE_COLUMNS; c++) {
+        const ArchiveColumn *col = &archive_columns[c];
+        archive_decode_column(b, c, raw);
+
+        for (uint32_t i = 0; i < b->rows; i++) {
+            char *p = (char *)&rows[i] + col->offset;
+            if (col->type == COLUMN_INT) {
+                int v = (int)unzigzag(raw[i]);
+                memcpy(p, &v, sizeof(v));
+            } else if (col->type == COLUMN_BOOL) {
+                *(bool *)p = raw[i] != 0;
+            } else {
+                memcpy(p, &raw[i], sizeof(raw[i]));
+            }
+        }
+    }
+    for (uint32_t i = 0; i < b->rows; i++)
+        rows[i].vehicle = b->vehicle;
+}
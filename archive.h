@@ -0,0 +1,120 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "common.h"
+#include "telemetry.h"
+
+/*
+ * Columnar, compressed telemetry archive: the same rows as a .tlm file
+ * (TelemetryRecord), at a fraction of the size.
+ *
+ * After an ArchiveHeader the file is a sequence of blocks.  A block holds
+ * up to ARCHIVE_BLOCK_ROWS consecutive rows of one vehicle, stored column
+ * by column, each column compressed on its own:
+ *
+ *   DOD  delta-of-delta of the 64-bit pattern: 0 costs one bit, so the
+ *        tick counter, sim time and smooth positions shrink the most
+ *   XOR  Gorilla-style XOR with the previous value, for noisy floats
+ *   RLE  (run, value) varint pairs, for values that hold for many ticks
+ *
+ * The block header records each column's offset, size and min/max, so a
+ * query skips any block whose range cannot match without decoding it.
+ * Blocks are appended as they fill, so an archive whose writer died is
+ * still readable up to its last complete block.  Every codec is lossless:
+ * rows decode to the bits that went in.
+ */
+
+#define ARCHIVE_MAGIC       "CARARC\r\n"
+#define ARCHIVE_VERSION     1
+#define ARCHIVE_BLOCK_MAGIC 0x4B4C4243u     // "CBLK"
+#define ARCHIVE_BLOCK_ROWS  1024
+#define ARCHIVE_COLUMNS     15
+
+#define CODEC_DOD 1
+#define CODEC_XOR 2
+#define CODEC_RLE 3
+
+#define COLUMN_U64    1
+#define COLUMN_DOUBLE 2
+#define COLUMN_INT    3
+#define COLUMN_BOOL   4
+
+typedef struct {
+    const char *name;
+    size_t      offset;         // into TelemetryRecord
+    uint8_t     type;           // COLUMN_*
+    uint8_t     codec;          // CODEC_*
+} ArchiveColumn;
+
+extern const ArchiveColumn archive_columns[ARCHIVE_COLUMNS];
+
+typedef struct {
+    char     magic[8];          // ARCHIVE_MAGIC
+    uint32_t version;
+    uint32_t columns;           // ARCHIVE_COLUMNS
+    uint32_t block_rows;        // ARCHIVE_BLOCK_ROWS
+    uint32_t reserved;
+    double   dt;
+} ArchiveHeader;
+
+typedef struct {
+    uint32_t offset;            // from the start of the block
+    uint32_t bytes;
+    double   min, max;
+} ArchiveColumnInfo;
+
+typedef struct {
+    uint32_t magic;             // ARCHIVE_BLOCK_MAGIC
+    uint32_t vehicle;
+    uint32_t rows;
+    uint32_t bytes;             // whole block, this header included
+    ArchiveColumnInfo column[ARCHIVE_COLUMNS];
+} ArchiveBlock;
+
+/* ---------------- WRITING ---------------- */
+
+typedef struct ArchiveVehicle ArchiveVehicle;
+
+typedef struct {
+    FILE            *f;
+    ArchiveVehicle **vehicles;  // [MAX_VEHICLES], open block per vehicle
+    uint64_t         rows, blocks, bytes;
+} ArchiveWriter;
+
+/* NULL (with a message) on failure. */
+ArchiveWriter *archive_create(const char *path, double dt);
+void archive_append(ArchiveWriter *w, const TelemetryRecord *row);
+void archive_flush(ArchiveWriter *w);      // write out the partial blocks
+void archive_close(ArchiveWriter *w);      // flushes first
+
+/* ---------------- READING ---------------- */
+
+typedef struct {
+    const uint8_t       *data;
+    size_t               size;
+    const ArchiveHeader *header;
+} ArchiveReader;
+
+ArchiveReader *archive_open(const char *path);
+void archive_close_reader(ArchiveReader *r);
+
+/* The block after `prev` (NULL: the first); NULL at the end. */
+const ArchiveBlock *archive_next_block(const ArchiveReader *r, const ArchiveBlock *prev);
+
+/* Could any row of the block have lo <= column <= hi? */
+bool archive_block_overlaps(const ArchiveBlock *b, int column, double lo, double hi);
+
+/* Decode one column to its raw 64-bit values, or a whole block to rows. */
+void archive_decode_column(const ArchiveBlock *b, int column, uint64_t *raw);
+void archive_decode_block(const ArchiveBlock *b, TelemetryRecord *rows);
+
+/* A raw column value as a number, for comparisons and printing. */
+double archive_value(int column, uint64_t raw);
+
+int archive_column_index(const char *name);     // -1 if unknown
+
+#endif
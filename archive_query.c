@@ -0,0 +1,157 @@
+/*
+ * Query a columnar telemetry archive (see archive.h), printing the rows
+ * that match as CSV in telemetry_dump's format.
+ *
+ *     ./archive_query [-v vehicle] [-w column=lo:hi]... [-b] run.car
+ *
+ * Each -w keeps rows with lo <= column <= hi (either bound may be left
+ * out).  A block is skipped without decoding when its vehicle or its
+ * min/max statistics rule it out.  -b decodes the matching blocks without
+ * printing and reports the decode rate.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <getopt.h>
+
+#include "archive.h"
+
+typedef struct {
+    int    column;
+    double lo, hi;
+} Filter;
+
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static bool parse_filter(const char *arg, Filter *f) {
+    char name[32];
+    const char *eq = strchr(arg, '=');
+    if (!eq || eq - arg >= (long)sizeof(name))
+        return false;
+    memcpy(name, arg, (size_t)(eq - arg));
+    name[eq - arg] = '\0';
+
+    f->column = archive_column_index(name);
+    const char *colon = strchr(eq + 1, ':');
+    if (f->column < 0 || !colon)
+        return false;
+
+    f->lo = colon == eq + 1 ? -INFINITY : atof(eq + 1);
+    f->hi = colon[1] == '\0' ? INFINITY : atof(colon + 1);
+    return true;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-v vehicle] [-w column=lo:hi]... [-b] FILE.car\n"
+                    "columns:", prog);
+    for (int c = 0; c < ARCHIVE_COLUMNS; c++)
+        fprintf(stderr, " %s", archive_columns[c].name);
+    fprintf(stderr, "\n");
+}
+
+int main(int argc, char **argv) {
+    long vehicle = -1;
+    bool bench = false;
+    Filter filters[ARCHIVE_COLUMNS];
+    int num_filters = 0;
+
+    int c;
+    while ((c = getopt(argc, argv, "v:w:b")) != -1) {
+        if (c == 'v') {
+            vehicle = atol(optarg);
+        } else if (c == 'w' && num_filters < ARCHIVE_COLUMNS &&
+                   parse_filter(optarg, &filters[num_filters])) {
+            num_filters++;
+        } else if (c == 'b') {
+            bench = true;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (optind != argc - 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    ArchiveReader *r = archive_open(argv[optind]);
+    if (!r)
+        return 1;
+
+    if (!bench)
+        printf("vehicle,tick,sim_time,throttle,brake,steer,gear,speed,"
+               "x,y,heading,rpm,power,torque,fuel,reverse\n");
+
+    static TelemetryRecord rows[ARCHIVE_BLOCK_ROWS];
+    static uint64_t raw[ARCHIVE_BLOCK_ROWS];
+    static bool keep[ARCHIVE_BLOCK_ROWS];
+    uint64_t blocks = 0, skipped = 0, decoded = 0, matched = 0, packed = 0;
+    double start = now_seconds();
+
+    for (const ArchiveBlock *b = archive_next_block(r, NULL); b; b = archive_next_block(r, b)) {
+        blocks++;
+
+        bool may_match = vehicle < 0 || b->vehicle == (uint32_t)vehicle;
+        for (int f = 0; may_match && f < num_filters; f++)
+            may_match = archive_block_overlaps(b, filters[f].column, filters[f].lo, filters[f].hi);
+        if (!may_match) {
+            skipped++;
+            continue;
+        }
+
+        /* Filter columns first: the rest is only decoded if a row is left */
+        uint32_t left = b->rows;
+        memset(keep, 1, b->rows * sizeof(bool));
+        for (int f = 0; left && f < num_filters; f++) {
+            archive_decode_column(b, filters[f].column, raw);
+            for (uint32_t i = 0; i < b->rows; i++) {
+                double v = archive_value(filters[f].column, raw[i]);
+                if (keep[i] && !(v >= filters[f].lo && v <= filters[f].hi)) {
+                    keep[i] = false;
+                    left--;
+                }
+            }
+        }
+        if (!left)
+            continue;
+
+        archive_decode_block(b, rows);
+        decoded += b->rows;
+        packed += b->bytes;
+        matched += left;
+        if (bench)
+            continue;
+
+        for (uint32_t i = 0; i < b->rows; i++) {
+            if (!keep[i])
+                continue;
+            const TelemetryRecord *row = &rows[i];
+            const CarSnapshot *car = &row->car;
+            printf("%u,%llu,%.4f,%.3f,%.3f,%.3f,%d,%.6f,%.3f,%.3f,%.6f,%.1f,%.1f,%.2f,%.4f,%d\n",
+                   row->vehicle, (unsigned long long)row->tick, row->sim_time,
+                   car->throttle, car->brake, car->steer, car->gear, car->speed,
+                   car->x, car->y, car->heading, car->rpm, car->power, car->torque,
+                   car->fuel, car->reverse);
+        }
+    }
+
+    double elapsed = now_seconds() - start;
+    fprintf(stderr, "%llu blocks, %llu skipped; %llu rows decoded, %llu matched\n",
+            (unsigned long long)blocks, (unsigned long long)skipped,
+            (unsigned long long)decoded, (unsigned long long)matched);
+    if (bench && elapsed > 0.0)
+        fprintf(stderr, "decode: %.1f M rows/s, %.0f MB/s of rows (%.0f MB/s compressed)\n",
+                decoded / elapsed / 1e6,
+                decoded * sizeof(TelemetryRecord) / elapsed / 1e6,
+                packed / elapsed / 1e6);
+
+    archive_close_reader(r);
+    return 0;
+}
@@ -0,0 +1,187 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <libgen.h>
+#include <pthread.h>
+
+#include "checkpoint.h"
+
+/* ---------------- WRITING ---------------- */
+
+static bool write_all(int fd, const void *buf, size_t len) {
+    const char *p = buf;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0)
+            return false;
+        p += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+/* So the rename itself survives a crash */
+static void sync_dir(const char *path) {
+    char copy[4096];
+    snprintf(copy, sizeof(copy), "%s", path);
+
+    int fd = open(dirname(copy), O_RDONLY | O_DIRECTORY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+bool checkpoint_write(const char *path, CheckpointHeader *h,
+                      const VehicleCheckpoint *vehicles, uint32_t count) {
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+    memcpy(h->magic, CHECKPOINT_MAGIC, sizeof(h->magic));
+    h->version     = CHECKPOINT_VERSION;
+    h->record_size = sizeof(VehicleCheckpoint);
+    h->count       = count;
+
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror(tmp);
+        return false;
+    }
+
+    bool ok = write_all(fd, h, sizeof(*h)) &&
+              write_all(fd, vehicles, count * sizeof(VehicleCheckpoint)) &&
+              fsync(fd) == 0;
+    if (close(fd) != 0)
+        ok = false;
+
+    if (!ok || rename(tmp, path) != 0) {
+        perror(path);
+        unlink(tmp);
+        return false;
+    }
+    sync_dir(path);
+    return true;
+}
+
+/* ---------------- READING ---------------- */
+
+VehicleCheckpoint *checkpoint_read(const char *path, CheckpointHeader *h) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return NULL;
+    }
+
+    if (fread(h, sizeof(*h), 1, f) != 1 ||
+        memcmp(h->magic, CHECKPOINT_MAGIC, sizeof(h->magic)) != 0 ||
+        h->version != CHECKPOINT_VERSION ||
+        h->record_size != sizeof(VehicleCheckpoint) ||
+        h->count > MAX_VEHICLES) {
+        fprintf(stderr, "%s: not a version %d checkpoint from this build\n",
+                path, CHECKPOINT_VERSION);
+        fclose(f);
+        return NULL;
+    }
+
+    VehicleCheckpoint *vehicles = calloc(h->count ? h->count : 1, sizeof(VehicleCheckpoint));
+    if (fread(vehicles, sizeof(VehicleCheckpoint), h->count, f) != h->count) {
+        fprintf(stderr, "%s: truncated checkpoint\n", path);
+        free(vehicles);
+        vehicles = NULL;
+    }
+    fclose(f);
+    return vehicles;
+}
+
+/* ---------------- BACKGROUND WRITER ---------------- */
+
+struct CheckpointWriter {
+    const char *path;
+    pthread_t   thread;
+
+    pthread_mutex_t lock;
+    pthread_cond_t  wake;
+    bool            queued;         // `queue` holds a checkpoint to write
+    bool            stopping;
+    CheckpointHeader   header;
+    VehicleCheckpoint *queue;
+    uint32_t           count;
+
+    VehicleCheckpoint *writing;     // the thread's own copy
+    unsigned           written;
+};
+
+static void *writer_main(void *arg) {
+    CheckpointWriter *w = arg;
+
+    for (;;) {
+        pthread_mutex_lock(&w->lock);
+        while (!w->queued && !w->stopping)
+            pthread_cond_wait(&w->wake, &w->lock);
+        if (!w->queued) {
+            pthread_mutex_unlock(&w->lock);
+            return NULL;
+        }
+        VehicleCheckpoint *v = w->queue;
+        w->queue = w->writing;
+        w->writing = v;
+        CheckpointHeader h = w->header;
+        uint32_t count = w->count;
+        w->queued = false;
+        pthread_mutex_unlock(&w->lock);
+
+        bool ok = checkpoint_write(w->path, &h, v, count);
+
+        pthread_mutex_lock(&w->lock);
+        if (ok)
+            w->written++;
+        pthread_mutex_unlock(&w->lock);
+    }
+}
+
+CheckpointWriter *checkpoint_writer_start(const char *path) {
+    CheckpointWriter *w = calloc(1, sizeof(*w));
+    w->path = path;
+    w->queue = malloc(MAX_VEHICLES * sizeof(VehicleCheckpoint));
+    w->writing = malloc(MAX_VEHICLES * sizeof(VehicleCheckpoint));
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->wake, NULL);
+
+    if (pthread_create(&w->thread, NULL, writer_main, w) != 0) {
+        perror("checkpoint writer");
+        free(w->queue);
+        free(w->writing);
+        free(w);
+        return NULL;
+    }
+    return w;
+}
+
+void checkpoint_writer_submit(CheckpointWriter *w, const CheckpointHeader *h,
+                              const VehicleCheckpoint *vehicles, uint32_t count) {
+    pthread_mutex_lock(&w->lock);
+    w->header = *h;
+    memcpy(w->queue, vehicles, count * sizeof(VehicleCheckpoint));
+    w->count = count;
+    w->queued = true;
+    pthread_cond_signal(&w->wake);
+    pthread_mutex_unlock(&w->lock);
+}
+
+unsigned checkpoint_writer_stop(CheckpointWriter *w) {
+    pthread_mutex_lock(&w->lock);
+    w->stopping = true;
+    pthread_cond_signal(&w->wake);
+    pthread_mutex_unlock(&w->lock);
+    pthread_join(w->thread, NULL);
+
+    unsigned written = w->written;
+    pthread_mutex_destroy(&w->lock);
+    pthread_cond_destroy(&w->wake);
+    free(w->queue);
+    free(w->writing);
+    free(w);
+    return written;
+}
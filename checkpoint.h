@@ -0,0 +1,73 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "common.h"
+
+/*
+ * Checkpoints: the whole state of a run, enough to resume it at the tick
+ * it was taken.
+ *
+ * Stages keep no state between steps (see protocol.h), so the server's
+ * per-vehicle state is all there is.  Each vehicle is captured at the end
+ * of a tick, so vehicles running at their own pace may be captured at
+ * different ticks.  A file is a CheckpointHeader followed by `count`
+ * VehicleCheckpoints.  It is written to PATH.tmp, synced and renamed over
+ * PATH, so PATH is always either the previous checkpoint or the new one.
+ */
+
+#define CHECKPOINT_MAGIC   "CARCKP\r\n"
+#define CHECKPOINT_VERSION 1
+
+/* Engine outputs integrated since the fuel stage last ran (--stage-rate) */
+typedef struct {
+    double time, throttle, speed, rpm, power;
+} FuelAverage;
+
+typedef struct {
+    char     magic[8];                  // CHECKPOINT_MAGIC
+    uint32_t version;
+    uint32_t record_size;               // sizeof(VehicleCheckpoint)
+    uint32_t count;
+    uint32_t tick_mode;                 // server's TICK_*
+    double   dt;
+    double   stage_period[NUM_STAGES];  // 0 = every tick
+} CheckpointHeader;
+
+typedef struct {
+    uint32_t    vehicle;
+    uint32_t    reserved;
+    uint64_t    ticks;                  // completed
+    double      sim_time;               // at the start of the next tick
+    double      last_shift_time;        // transmission's
+    double      stage_due[NUM_STAGES];
+    double      stage_from[NUM_STAGES];
+    FuelAverage fuel_avg;
+    CarSnapshot car;
+} VehicleCheckpoint;
+
+/* Atomic replace of `path`; false (with a message) on failure. */
+bool checkpoint_write(const char *path, CheckpointHeader *h,
+                      const VehicleCheckpoint *vehicles, uint32_t count);
+
+/* malloc'd array of h->count vehicles; NULL (with a message) on failure. */
+VehicleCheckpoint *checkpoint_read(const char *path, CheckpointHeader *h);
+
+/*
+ * Background writer, so the syncs of a periodic checkpoint stay off the
+ * caller's tick path.  checkpoint_writer_submit() copies the vehicles and
+ * returns; if the previous checkpoint is still being written, the copy
+ * waits for it, and a later submit replaces a copy still waiting.
+ */
+typedef struct CheckpointWriter CheckpointWriter;
+
+CheckpointWriter *checkpoint_writer_start(const char *path);
+void checkpoint_writer_submit(CheckpointWriter *w, const CheckpointHeader *h,
+                              const VehicleCheckpoint *vehicles, uint32_t count);
+
+/* Finish the waiting write and stop; returns how many files were written. */
+unsigned checkpoint_writer_stop(CheckpointWriter *w);
+
+#endif
@@ -2,17 +2,20 @@
 #define COMMON_H
 
 #include <stdbool.h>
-#include <pthread.h>
+#include <stdatomic.h>
+
+#include "histogram.h"
 
 
 
 #define SHM_NAME "/car_sim_shm"
 
+/* One CarShared slot per vehicle; vehicle 0 sits at offset 0. */
+#define MAX_VEHICLES 4096
 
 
-typedef struct {
-    pthread_mutex_t lock;   
 
+typedef struct {
    
     double throttle;        // 0 .. 1
     double brake;           // 0 .. 1
@@ -37,6 +40,115 @@ typedef struct {
     
     bool shutdown;          // set true by server on exit
 
+} CarSnapshot;
+
+/*
+ * Single-writer seqlock.  The server is the only writer and publishes a
+ * whole tick at once; seq is odd while a publish is in progress.  Readers
+ * never block the writer: they copy and retry if seq moved underneath them.
+ */
+typedef struct {
+    atomic_uint seq;
+    CarSnapshot data;
 } CarShared;
 
+static inline void car_publish(CarShared *car, const CarSnapshot *snap) {
+    unsigned seq = atomic_load_explicit(&car->seq, memory_order_relaxed);
+
+    atomic_store_explicit(&car->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    car->data = *snap;
+
+    atomic_store_explicit(&car->seq, seq + 2, memory_order_release);
+}
+
+static inline void car_read(const CarShared *car, CarSnapshot *snap) {
+    for (;;) {
+        unsigned seq = atomic_load_explicit(&car->seq, memory_order_acquire);
+        if (seq & 1)
+            continue;
+
+        *snap = car->data;
+
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&car->seq, memory_order_relaxed) == seq)
+            return;
+    }
+}
+
+/* Server tick scheduler, written by the server only (see tick_sched.h). */
+typedef struct {
+    long         period_ns;
+    int          policy;        // OVERRUN_*
+    atomic_ulong ticks;
+    atomic_ulong skipped;       // deadlines dropped under OVERRUN_SKIP
+    LatencyHist  lateness;      // wake-up time minus deadline
+} SchedStats;
+
+/*
+ * Where tick time goes, written by the server only.  Stage histograms run
+ * from a request being sent to its reply being handled, so for socket
+ * clients they include both transfers and the client's own work.
+ */
+#define NUM_STAGES 3            // engine, transmission, fuel (CLIENT_* - 1)
+
+typedef struct {
+    LatencyHist  stage[NUM_STAGES];
+    LatencyHist  tick;          // tick start to its last reply
+    LatencyHist  wait;          // server blocked in epoll_wait
+    atomic_ulong overruns;      // tick due while the previous one was in flight
+    atomic_ulong stale;         // replies dropped as left over
+} TickStats;
+
+/*
+ * Area-of-interest subscriptions (view.h has the viewer side).
+ *
+ * A viewer claims a free slot and fills in a filter; every tick round the
+ * server works out which vehicles match each due slot, with a spatial
+ * lookup rather than a scan, and publishes their ids in the slot.  The
+ * viewer then reads only those vehicles' CarShared.  Slots of viewers
+ * that died without letting go are freed by the server.
+ */
+#define MAX_VIEWERS  256
+#define MAX_VIEW_IDS 64
+
+#define VIEW_FREE    0
+#define VIEW_CLAIMED 1          // being set up by its viewer
+#define VIEW_ACTIVE  2
+
+#define VIEW_REGION  1          // x0 <= x < x1 and y0 <= y < y1
+#define VIEW_IDS     2          // one of ids[]
+
+typedef struct {
+    unsigned flags;             // VIEW_REGION | VIEW_IDS, both must hold; 0 = all
+    double   x0, y0, x1, y1;
+    int      num_ids;
+    int      ids[MAX_VIEW_IDS];
+    double   rate;              // frames per second of sim time, 0 = every tick
+} ViewFilter;
+
+typedef struct {
+    /* Written by the viewer; filter under filter_seq, odd while changing */
+    atomic_int   state;         // VIEW_*
+    int          owner;         // pid
+    atomic_uint  filter_seq;
+    ViewFilter   filter;
+
+    /* Written by the server, under seq as CarShared */
+    atomic_uint  seq;
+    unsigned     frame;         // frames published to this subscription
+    double       sim_time;
+    int          count;
+    int          match[MAX_VEHICLES];   // vehicle ids, ascending
+} ViewSlot;
+
+typedef struct {
+    CarShared  cars[MAX_VEHICLES];
+    SchedStats sched;
+    TickStats  stats;
+    atomic_uint view_claims;    // bumped by every view_subscribe
+    ViewSlot   views[MAX_VIEWERS];
+} SimShared;
+
 #endif
@@ -0,0 +1,189 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "compact.h"
+
+/* ---------------- ALLOCATION ---------------- */
+
+CompactFleet *compact_alloc(int count) {
+    CompactFleet *c = calloc(1, sizeof(CompactFleet));
+    c->count  = count;
+    c->cars   = calloc(count ? count : 1, sizeof(CompactCar));
+    c->inputs = calloc(count ? count : 1, sizeof(CompactInput));
+    c->block  = fleet_alloc(COMPACT_BLOCK);
+    c->model  = vehicle_model_default();
+    return c;
+}
+
+void compact_free(CompactFleet *c) {
+    if (!c)
+        return;
+    free(c->cars);
+    free(c->inputs);
+    fleet_free(c->block);
+    free(c);
+}
+
+size_t compact_bytes_per_vehicle() {
+    return sizeof(CompactCar) + sizeof(CompactInput);
+}
+
+/* ---------------- QUANTIZATION ---------------- */
+
+static inline double clampd(double v, double lo, double hi) {
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+/*
+ * Round to nearest by adding a half and truncating: nearbyint() is a
+ * library call on x86-64 without SSE4.1, and packing runs every step.
+ */
+static inline uint16_t quant_u16(double v, double scale) {
+    return (uint16_t)(clampd(v * scale, 0.0, 65535.0) + 0.5);
+}
+
+static inline int16_t quant_s16(double v, double scale) {
+    double q = clampd(v * scale, -32768.0, 32767.0);
+    return (int16_t)(q + (q < 0.0 ? -0.5 : 0.5));
+}
+
+static inline uint32_t quant_u32(double v, double scale) {
+    return (uint32_t)(clampd(v * scale, 0.0, 4294967295.0) + 0.5);
+}
+
+static inline int32_t quant_s32(double v, double scale) {
+    double q = clampd(v * scale, -2147483648.0, 2147483647.0);
+    return (int32_t)(q + (q < 0.0 ? -0.5 : 0.5));
+}
+
+/*
+ * Tile-relative coordinate (m) into *tile and a fixed-point offset.
+ * Rounding up to the tile's far edge carries into the next tile.
+ */
+static inline void pack_axis(double rel, int16_t *tile, uint32_t *offset) {
+    double r = rel * COMPACT_POS_SCALE;
+    long long q = (long long)(r + (r < 0.0 ? -0.5 : 0.5));
+    *tile += (int16_t)(q >> 32);
+    *offset = (uint32_t)q;
+}
+
+static inline double unpack_axis(int16_t tile, uint32_t offset) {
+    return tile * COMPACT_TILE + offset / COMPACT_POS_SCALE;
+}
+
+static inline uint8_t pack_state(int gear, bool reverse, bool engine_on) {
+    int g = gear < -1 ? 0 : (gear > 6 ? 7 : gear + 1);
+    return (uint8_t)(g | (reverse ? COMPACT_REVERSE : 0) | (engine_on ? COMPACT_ENGINE_ON : 0));
+}
+
+static inline int state_gear(uint8_t state) {
+    return (state & COMPACT_GEAR_MASK) - 1;
+}
+
+/* ---------------- CONVERSIONS ---------------- */
+
+void compact_pack(CompactFleet *c, int i, const CarSnapshot *snap, bool engine_on) {
+    CompactCar *car = &c->cars[i];
+
+    car->tx = car->ty = 0;
+    pack_axis(snap->x, &car->tx, &car->ox);
+    pack_axis(snap->y, &car->ty, &car->oy);
+
+    car->speed   = quant_u32(snap->speed, COMPACT_SPEED_SCALE);
+    car->heading = quant_s32(snap->heading, COMPACT_HEADING_SCALE);
+    car->fuel    = quant_u32(snap->fuel, COMPACT_FUEL_SCALE);
+    car->rpm     = quant_u16(snap->rpm, COMPACT_RPM_SCALE);
+    car->torque  = quant_u16(snap->torque, COMPACT_TORQUE_SCALE);
+    car->state   = pack_state(snap->gear, snap->reverse, engine_on);
+    memset(car->spare, 0, sizeof(car->spare));
+}
+
+/* Pedals and steer as the engine step outputs them, from the inputs */
+void compact_unpack(const CompactFleet *c, int i, CarSnapshot *snap) {
+    const CompactCar *car = &c->cars[i];
+    const CompactInput *in = &c->inputs[i];
+
+    memset(snap, 0, sizeof(*snap));
+
+    snap->x       = unpack_axis(car->tx, car->ox);
+    snap->y       = unpack_axis(car->ty, car->oy);
+    snap->speed   = car->speed / COMPACT_SPEED_SCALE;
+    snap->heading = car->heading / COMPACT_HEADING_SCALE;
+    snap->fuel    = car->fuel / COMPACT_FUEL_SCALE;
+    snap->rpm     = car->rpm / COMPACT_RPM_SCALE;
+    snap->torque  = car->torque / COMPACT_TORQUE_SCALE;
+    snap->power   = fmin(snap->torque * snap->rpm * 2.0 * PI / 60.0, c->model->max_power);
+    snap->gear    = state_gear(car->state);
+    snap->reverse = car->state & COMPACT_REVERSE;
+
+    bool on = car->state & COMPACT_ENGINE_ON;
+    snap->brake    = clampd(in->brake / COMPACT_PEDAL_SCALE, 0.0, 1.0);
+    snap->steer    = clampd(in->steer / COMPACT_STEER_SCALE, -1.0, 1.0);
+    snap->throttle = on && snap->fuel > 0.0 && snap->brake == 0.0 ?
+                     clampd(in->throttle / COMPACT_PEDAL_SCALE, 0.0, 1.0) : 0.0;
+}
+
+void compact_pack_input(CompactFleet *c, int i, double throttle, double brake, double steer,
+                        bool reverse) {
+    CompactInput *in = &c->inputs[i];
+    in->throttle = quant_u16(throttle, COMPACT_PEDAL_SCALE);
+    in->brake    = quant_u16(brake, COMPACT_PEDAL_SCALE);
+    in->steer    = quant_s16(steer, COMPACT_STEER_SCALE);
+    in->flags    = reverse ? COMPACT_IN_REVERSE : 0;
+    in->spare    = 0;
+}
+
+void compact_unpack_block(const CompactFleet *c, int start, FleetState *f) {
+    const CompactCar *car = c->cars + start;
+    const CompactInput *in = c->inputs + start;
+
+    for (int i = 0; i < f->count; i++) {
+        f->throttle_in[i] = in[i].throttle * (1.0 / COMPACT_PEDAL_SCALE);
+        f->brake_in[i]    = in[i].brake * (1.0 / COMPACT_PEDAL_SCALE);
+        f->steer_in[i]    = in[i].steer * (1.0 / COMPACT_STEER_SCALE);
+        f->reverse_in[i]  = in[i].flags & COMPACT_IN_REVERSE;
+        f->engine_on[i]   = (car[i].state & COMPACT_ENGINE_ON) != 0;
+
+        f->x[i]       = car[i].ox * (1.0 / COMPACT_POS_SCALE);
+        f->y[i]       = car[i].oy * (1.0 / COMPACT_POS_SCALE);
+        f->speed[i]   = car[i].speed * (1.0 / COMPACT_SPEED_SCALE);
+        f->heading[i] = car[i].heading * (1.0 / COMPACT_HEADING_SCALE);
+        f->fuel[i]    = car[i].fuel * (1.0 / COMPACT_FUEL_SCALE);
+        f->gear[i]    = state_gear(car[i].state);
+        f->reverse[i] = (car[i].state & COMPACT_REVERSE) != 0;
+    }
+}
+
+void compact_pack_block(CompactFleet *c, int start, const FleetState *f) {
+    CompactCar *car = c->cars + start;
+
+    for (int i = 0; i < f->count; i++) {
+        pack_axis(f->x[i], &car[i].tx, &car[i].ox);
+        pack_axis(f->y[i], &car[i].ty, &car[i].oy);
+
+        car[i].speed   = quant_u32(f->speed[i], COMPACT_SPEED_SCALE);
+        car[i].heading = quant_s32(f->heading[i], COMPACT_HEADING_SCALE);
+        car[i].fuel    = quant_u32(f->fuel[i], COMPACT_FUEL_SCALE);
+        car[i].rpm     = quant_u16(f->rpm[i], COMPACT_RPM_SCALE);
+        car[i].torque  = quant_u16(f->torque[i], COMPACT_TORQUE_SCALE);
+        car[i].state   = pack_state(f->gear[i], f->reverse[i], f->engine_on[i]);
+    }
+}
+
+/* ---------------- STEP ---------------- */
+
+void compact_step(CompactFleet *c, double dt) {
+    FleetState *f = c->block;
+    f->model = c->model;
+
+    for (int start = 0; start < c->count; start += COMPACT_BLOCK) {
+        int n = c->count - start;
+        f->count = n < COMPACT_BLOCK ? n : COMPACT_BLOCK;
+
+        compact_unpack_block(c, start, f);
+        fleet_step(f, dt);
+        compact_pack_block(c, start, f);
+    }
+    f->count = COMPACT_BLOCK;
+}
@@ -0,0 +1,126 @@
+#ifndef COMPACT_H
+#define COMPACT_H
+
+#include <stdint.h>
+
+#include "common.h"
+#include "engine_params.h"
+#include "fleet_kernel.h"
+
+/*
+ * Compact vehicle state for very large fleets.
+ *
+ * A CarSnapshot is 112 bytes and a FleetState vehicle 124; a CompactCar is
+ * 32 and its driver inputs 8 more, so a million vehicles fit in 40 MB.
+ * Positions are 48-bit fixed point (a 4096 m tile and a 2^-20 m offset
+ * within it), engine outputs and driver inputs are quantized to 16 bits,
+ * and gear, reverse and engine state share one byte.
+ *
+ * Speed, heading and fuel change by less than a 16-bit step per tick
+ * (speed by about 1e-3 m/s at 60 Hz), so rounding them to 16 bits every
+ * tick would bias them the same way each time.  They are 32-bit fixed
+ * point instead.  The throttle, brake and steer a step outputs are its
+ * clamped inputs, so they are not stored at all.
+ *
+ * Nothing reads a CompactCar's fields directly: compact_pack() and
+ * compact_unpack() convert to and from a CarSnapshot, and compact_step()
+ * unpacks a block of vehicles into a FleetState, runs fleet_step() on it
+ * and packs it back.  Positions are stepped relative to their tile, so
+ * precision does not depend on how far a vehicle is from the origin.
+ *
+ * Worst-case error of one pack/unpack round trip (half a step):
+ *
+ *     x, y      4.8e-7 m                 rpm      0.125 (0 .. 16384)
+ *     speed     1.5e-8 m/s (0 .. 128)    torque   0.016 Nm (0 .. 2048)
+ *     heading   7.3e-10 rad              pedals   7.6e-6
+ *     fuel      3.0e-8 L (0 .. 256)      steer    1.5e-5
+ *
+ * Power is not stored either; it is min(torque * rpm * 2 pi / 60,
+ * max_power) as the engine step computes it.  Values outside a range are
+ * clamped.  compact_bench checks the bounds and reports how far a compact
+ * fleet drifts from a full-precision one.
+ */
+
+#define COMPACT_TILE       4096.0               // m
+#define COMPACT_POS_SCALE  1048576.0            // offset units per m (2^20)
+#define COMPACT_SPEED_SCALE   33554432.0        // per m/s (2^25)
+#define COMPACT_HEADING_SCALE (2147483648.0 / PI)   // per radian, -pi .. pi
+#define COMPACT_FUEL_SCALE    16777216.0        // per litre (2^24)
+#define COMPACT_RPM_SCALE     4.0
+#define COMPACT_TORQUE_SCALE  32.0              // per Nm
+#define COMPACT_PEDAL_SCALE   65535.0           // throttle, brake 0 .. 1
+#define COMPACT_STEER_SCALE   32767.0           // -1 .. 1
+
+/* CompactCar.state: gear + 1 in the low three bits, then the flags */
+#define COMPACT_GEAR_MASK  0x07
+#define COMPACT_REVERSE    0x08
+#define COMPACT_ENGINE_ON  0x10
+
+/* CompactInput.flags */
+#define COMPACT_IN_REVERSE 0x01
+
+/* Vehicles unpacked per fleet_step() call: the block stays in L2 */
+#define COMPACT_BLOCK 1024
+
+typedef struct {
+    uint32_t ox, oy;        // offset in the tile, 1 / COMPACT_POS_SCALE m
+    uint32_t speed;
+    int32_t  heading;
+    uint32_t fuel;
+    int16_t  tx, ty;        // tile
+    uint16_t rpm;           // after the engine step
+    uint16_t torque;
+    uint8_t  state;         // COMPACT_*
+    uint8_t  spare[3];
+} CompactCar;
+
+typedef struct {
+    uint16_t throttle;
+    uint16_t brake;
+    int16_t  steer;
+    uint8_t  flags;         // COMPACT_IN_*
+    uint8_t  spare;
+} CompactInput;
+
+_Static_assert(sizeof(CompactCar) == 32, "CompactCar must stay 32 bytes");
+_Static_assert(sizeof(CompactInput) == 8, "CompactInput must stay 8 bytes");
+
+typedef struct {
+    int count;
+    const VehicleModel *model;  // default after compact_alloc
+    CompactCar   *cars;
+    CompactInput *inputs;
+    FleetState   *block;        // compact_step's scratch
+} CompactFleet;
+
+CompactFleet *compact_alloc(int count);     // all vehicles zero
+void compact_free(CompactFleet *c);
+
+/* Bytes held per vehicle, not counting the fixed-size scratch block. */
+size_t compact_bytes_per_vehicle();
+
+/* ---------------- CONVERSIONS ---------------- */
+
+/*
+ * Vehicle i to and from a snapshot.  Packing takes the vehicle's state
+ * only; its inputs go in with compact_pack_input(), and unpacking derives
+ * the snapshot's throttle, brake and steer from them as a step would.
+ */
+void compact_pack(CompactFleet *c, int i, const CarSnapshot *snap, bool engine_on);
+void compact_unpack(const CompactFleet *c, int i, CarSnapshot *snap);
+
+void compact_pack_input(CompactFleet *c, int i, double throttle, double brake, double steer,
+                        bool reverse);
+
+/* Vehicles start .. start + f->count - 1 to and from a FleetState, with
+ * positions relative to each vehicle's tile origin.  Only what fleet_step()
+ * reads is unpacked. */
+void compact_unpack_block(const CompactFleet *c, int start, FleetState *f);
+void compact_pack_block(CompactFleet *c, int start, const FleetState *f);
+
+/* ---------------- STEP ---------------- */
+
+/* fleet_step() over the whole fleet, one block at a time. */
+void compact_step(CompactFleet *c, double dt);
+
+#endif
@@ -0,0 +1,218 @@
+/*
+ * Compact fleet benchmark.
+ *
+ * Packs a varied fleet spread over many tiles, checks that every field
+ * comes back within the error bounds in compact.h, then steps the compact
+ * fleet and a full-precision FleetState from the same start and reports
+ * memory, speed and how far the compact fleet has drifted.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <getopt.h>
+
+#include "compact.h"
+#include "tick_sched.h"
+
+#define DT 0.016
+#define WORLD 100000.0      // m, vehicles are spread over +-WORLD in x and y
+
+static unsigned long long rng_state = 0x9e3779b97f4a7c15ULL;
+
+static double rnd() {
+    rng_state = rng_state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (rng_state >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* As fleet_bench's fleet, packed straight into c */
+static void fill_fleet(CompactFleet *c, FleetState *ref) {
+    rng_state = 0x9e3779b97f4a7c15ULL;
+
+    for (int i = 0; i < c->count; i++) {
+        CarSnapshot s = { 0 };
+        s.speed   = rnd() < 0.1 ? 0.0 : rnd() * 40.0;
+        s.heading = (rnd() * 2.0 - 1.0) * 3.1;
+        s.x       = (rnd() * 2.0 - 1.0) * WORLD;
+        s.y       = (rnd() * 2.0 - 1.0) * WORLD;
+        s.fuel    = rnd() < 0.05 ? 0.0 : rnd() * 100.0;
+        s.gear    = (int)(rnd() * 7.0) - 1;
+        s.reverse = s.gear < 0;
+        s.rpm     = 850.0 + rnd() * 6000.0;
+        s.torque  = rnd() * 250.0;
+        s.power   = fmin(s.torque * s.rpm * 2.0 * PI / 60.0, c->model->max_power);
+
+        bool engine_on  = rnd() < 0.9;
+        bool reverse_in = rnd() < 0.1;
+        double brake_in    = rnd() < 0.2 ? rnd() : 0.0;
+        double throttle_in = rnd();
+        double steer_in    = rnd() < 0.5 ? 0.0 : rnd() * 2.0 - 1.0;
+
+        compact_pack(c, i, &s, engine_on);
+        compact_pack_input(c, i, throttle_in, brake_in, steer_in, reverse_in);
+
+        ref->speed[i] = s.speed;    ref->heading[i] = s.heading;
+        ref->x[i] = s.x;            ref->y[i] = s.y;
+        ref->fuel[i] = s.fuel;      ref->gear[i] = s.gear;
+        ref->reverse[i] = s.reverse;
+        ref->rpm[i] = s.rpm;        ref->torque[i] = s.torque;
+        ref->power[i] = s.power;
+        ref->engine_on[i] = engine_on;
+        ref->reverse_in[i] = reverse_in;
+        ref->brake_in[i] = brake_in;
+        ref->throttle_in[i] = throttle_in;
+        ref->steer_in[i] = steer_in;
+    }
+}
+
+typedef struct {
+    const char *name;
+    double bound;
+    double worst;
+} FieldError;
+
+static void note(FieldError *e, double a, double b) {
+    e->worst = fmax(e->worst, fabs(a - b));
+}
+
+/* Round trip of every vehicle against the values it was packed from */
+static bool check_round_trip(const CompactFleet *c, const FleetState *ref) {
+    FieldError e[] = {
+        { .name = "x, y",    .bound = 0.5 / COMPACT_POS_SCALE },
+        { .name = "heading", .bound = 0.5 / COMPACT_HEADING_SCALE },
+        { .name = "speed",   .bound = 0.5 / COMPACT_SPEED_SCALE },
+        { .name = "rpm",     .bound = 0.5 / COMPACT_RPM_SCALE },
+        { .name = "torque",  .bound = 0.5 / COMPACT_TORQUE_SCALE },
+        { .name = "pedals",  .bound = 0.5 / COMPACT_PEDAL_SCALE },
+        { .name = "steer",   .bound = 0.5 / COMPACT_STEER_SCALE },
+        { .name = "fuel",    .bound = 0.5 / COMPACT_FUEL_SCALE },
+        { .name = "power",   .bound = 1.0 },       // as a fraction of what rounded torque and rpm allow
+        { .name = "flags",   .bound = 0.0 },
+    };
+    int n = sizeof(e) / sizeof(e[0]);
+
+    for (int i = 0; i < c->count; i++) {
+        CarSnapshot s;
+        compact_unpack(c, i, &s);
+        bool engine_on = c->cars[i].state & COMPACT_ENGINE_ON;
+        const CompactInput *in = &c->inputs[i];
+
+        note(&e[0], s.x, ref->x[i]);
+        note(&e[0], s.y, ref->y[i]);
+        note(&e[1], s.heading, ref->heading[i]);
+        note(&e[2], s.speed, ref->speed[i]);
+        note(&e[3], s.rpm, ref->rpm[i]);
+        note(&e[4], s.torque, ref->torque[i]);
+        note(&e[5], in->throttle / COMPACT_PEDAL_SCALE, ref->throttle_in[i]);
+        note(&e[5], s.brake, ref->brake_in[i]);
+        note(&e[6], s.steer, ref->steer_in[i]);
+        note(&e[7], s.fuel, ref->fuel[i]);
+        double power_bound = (e[4].bound * ref->rpm[i] + ref->torque[i] * e[3].bound +
+                              e[4].bound * e[3].bound) * 2.0 * PI / 60.0;
+        note(&e[8], fabs(s.power - ref->power[i]) / power_bound, 0.0);
+        note(&e[9], (s.gear != ref->gear[i]) + (s.reverse != ref->reverse[i]) +
+                    (engine_on != ref->engine_on[i]), 0.0);
+    }
+
+    bool ok = true;
+    printf("round trip, worst error over %d vehicles:\n", c->count);
+    for (int k = 0; k < n; k++) {
+        bool within = e[k].worst <= e[k].bound * (1.0 + 1e-9);
+        printf("  %-8s %10.3g   bound %10.3g%s\n", e[k].name, e[k].worst, e[k].bound,
+               within ? "" : "   EXCEEDED");
+        ok = ok && within;
+    }
+    return ok;
+}
+
+/* Start the reference from the compact fleet's values, so that drift
+ * measures stepping alone */
+static void unpack_all(const CompactFleet *c, FleetState *ref) {
+    for (int i = 0; i < c->count; i++) {
+        CarSnapshot s;
+        compact_unpack(c, i, &s);
+        ref->speed[i] = s.speed;
+        ref->heading[i] = s.heading;
+        ref->x[i] = s.x;
+        ref->y[i] = s.y;
+        ref->fuel[i] = s.fuel;
+        ref->throttle_in[i] = c->inputs[i].throttle / COMPACT_PEDAL_SCALE;
+        ref->brake_in[i] = c->inputs[i].brake / COMPACT_PEDAL_SCALE;
+        ref->steer_in[i] = c->inputs[i].steer / COMPACT_STEER_SCALE;
+    }
+}
+
+static void report_drift(const CompactFleet *c, const FleetState *ref) {
+    double pos = 0.0, speed = 0.0, heading = 0.0, pos_sum = 0.0;
+
+    for (int i = 0; i < c->count; i++) {
+        CarSnapshot s;
+        compact_unpack(c, i, &s);
+        double d = hypot(s.x - ref->x[i], s.y - ref->y[i]);
+        pos = fmax(pos, d);
+        pos_sum += d;
+        speed = fmax(speed, fabs(s.speed - ref->speed[i]));
+        double dh = fabs(s.heading - ref->heading[i]);
+        heading = fmax(heading, fmin(dh, 2.0 * PI - dh));     // -pi and pi are one angle
+    }
+    printf("  drift: position max %.3g m (mean %.3g), speed max %.3g m/s, "
+           "heading max %.3g rad\n", pos, pos_sum / c->count, speed, heading);
+}
+
+int main(int argc, char **argv) {
+    int count = 1000000;
+    int steps = 200;
+
+    static const struct option opts[] = {
+        { "vehicles", required_argument, NULL, 'n' },
+        { "steps",    required_argument, NULL, 's' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    int c;
+    while ((c = getopt_long(argc, argv, "n:s:", opts, NULL)) != -1) {
+        if (c == 'n') {
+            count = atoi(optarg);
+        } else if (c == 's') {
+            steps = atoi(optarg);
+        } else {
+            fprintf(stderr, "Usage: %s [-n vehicles] [-s steps]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    CompactFleet *compact = compact_alloc(count);
+    FleetState *ref = fleet_alloc(count);
+
+    fill_fleet(compact, ref);
+    bool ok = check_round_trip(compact, ref);
+
+    size_t full_bytes = sizeof(double) * 13 + sizeof(int) * 5;
+    printf("%d vehicles: compact %zu B each (%.1f MB), full precision %zu B each (%.1f MB)\n",
+           count, compact_bytes_per_vehicle(), count * compact_bytes_per_vehicle() / 1e6,
+           full_bytes, count * full_bytes / 1e6);
+
+    unpack_all(compact, ref);
+
+    long long t0 = sched_now_ns();
+    for (int s = 0; s < steps; s++)
+        fleet_step(ref, DT);
+    double t_ref = (sched_now_ns() - t0) / 1e9;
+
+    t0 = sched_now_ns();
+    for (int s = 0; s < steps; s++)
+        compact_step(compact, DT);
+    double t_compact = (sched_now_ns() - t0) / 1e9;
+
+    double total = (double)count * steps;
+    printf("%d steps (%.1f s of driving)\n", steps, steps * DT);
+    printf("  full precision: %8.1f M vehicle-steps/s\n", total / t_ref / 1e6);
+    printf("  compact       : %8.1f M vehicle-steps/s  (%.2fx)\n",
+           total / t_compact / 1e6, t_ref / t_compact);
+    report_drift(compact, ref);
+
+    compact_free(compact);
+    fleet_free(ref);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,117 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "drive_script.h"
+
+#define SCRIPT_COLUMNS 6
+
+DriveScript *drive_script_load(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return NULL;
+    }
+
+    DriveScript *s = calloc(1, sizeof(DriveScript));
+    int capacity = 0;
+    char line[256];
+    int lineno = 0;
+
+    while (fgets(line, sizeof(line), f)) {
+        lineno++;
+
+        char *hash = strchr(line, '#');
+        if (hash)
+            *hash = '\0';
+
+        /* time throttle brake steer engine reverse: each column given
+         * must parse as a number in full */
+        double col[SCRIPT_COLUMNS] = { 0, 0, 0, 0, 1, 0 };
+        int n = 0;
+        char word[64];
+        int used;
+        const char *p = line;
+        bool bad = false;
+
+        while (!bad && sscanf(p, "%63s%n", word, &used) == 1) {
+            char *end;
+            p += used;
+            if (n == SCRIPT_COLUMNS) {
+                bad = true;
+                break;
+            }
+            col[n++] = strtod(word, &end);
+            bad = end == word || *end != '\0';
+        }
+        if (bad) {
+            fprintf(stderr, "%s:%d: expected up to %d numbers: time throttle brake steer "
+                            "engine reverse\n", path, lineno, SCRIPT_COLUMNS);
+            fclose(f);
+            drive_script_free(s);
+            return NULL;
+        }
+        if (n == 0)
+            continue;   // blank or comment
+
+        double t = col[0];
+
+        if (s->count > 0 && t < s->entries[s->count - 1].t) {
+            fprintf(stderr, "%s:%d: time goes backwards\n", path, lineno);
+            fclose(f);
+            drive_script_free(s);
+            return NULL;
+        }
+
+        if (s->count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            s->entries = realloc(s->entries, capacity * sizeof(ScriptEntry));
+        }
+
+        ScriptEntry *e = &s->entries[s->count++];
+        e->t = t;
+        e->in.throttle  = col[1];
+        e->in.brake     = col[2];
+        e->in.steer     = col[3];
+        e->in.engine_on = col[4] != 0;
+        e->in.reverse   = col[5] != 0;
+    }
+
+    fclose(f);
+
+    if (s->count == 0) {
+        fprintf(stderr, "%s: empty drive script\n", path);
+        drive_script_free(s);
+        return NULL;
+    }
+
+    return s;
+}
+
+void drive_script_free(DriveScript *s) {
+    if (!s)
+        return;
+    free(s->entries);
+    free(s);
+}
+
+void drive_script_at(DriveScript *s, double t, DriverInput *out) {
+    if (t < s->entries[0].t) {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+
+    /* Time normally only moves forward: walk on from the last hit. */
+    int i = s->cursor;
+    if (s->entries[i].t > t)
+        i = 0;
+    while (i + 1 < s->count && s->entries[i + 1].t <= t)
+        i++;
+
+    s->cursor = i;
+    *out = s->entries[i].in;
+}
+
+double drive_script_end(const DriveScript *s) {
+    return s->entries[s->count - 1].t;
+}
@@ -0,0 +1,45 @@
+#ifndef DRIVE_SCRIPT_H
+#define DRIVE_SCRIPT_H
+
+#include <stdbool.h>
+
+#include "protocol.h"
+
+/*
+ * Scripted driver inputs.
+ *
+ * A script is a text file with one line per change of input:
+ *
+ *     # time  throttle  brake  steer  engine  reverse
+ *     0.0     0.0       0      0.0    1       0
+ *     1.0     1.0       0      0.0    1       0
+ *     20.0    0.0       1      0.3    1       0
+ *
+ * time is simulation seconds; each line holds until the next one.  Blank
+ * lines and '#' comments are ignored, trailing columns may be omitted
+ * (they default to 0, engine to 1).  Anything else that is not a number,
+ * or a seventh column, makes the script malformed.
+ */
+
+typedef struct {
+    double      t;
+    DriverInput in;
+} ScriptEntry;
+
+typedef struct {
+    ScriptEntry *entries;
+    int          count;
+    int          cursor;    // last entry returned, for O(1) forward lookup
+} DriveScript;
+
+/* NULL (with a message on stderr) if the file is missing or malformed. */
+DriveScript *drive_script_load(const char *path);
+void drive_script_free(DriveScript *s);
+
+/* Inputs in effect at simulation time t (all zero before the first line). */
+void drive_script_at(DriveScript *s, double t, DriverInput *out);
+
+/* Time of the last entry. */
+double drive_script_end(const DriveScript *s);
+
+#endif
@@ -5,65 +5,27 @@
 #include <string.h>
 #include <unistd.h>
 #include <ncurses.h>
-#include <sys/socket.h>
-#include <arpa/inet.h>
 #include <math.h>
 #include <stdbool.h>
 #include <time.h>
+#include <getopt.h>
 
-#define SERVER_PORT 9734
-#define CLIENT_ID 1
+#include "protocol.h"
+#include "transport.h"
+#include "drive_script.h"
+#include "sim_plugin.h"
+#include "session.h"
 
 #define PI 3.14159265359
-#define MAX_RPM 7000.0
-#define IDLE_RPM 900.0
-#define MAX_FORWARD_SPEED 100.0
-#define MAX_REVERSE_SPEED 5.50
-
-#define ENGINE_OFF_DECEL 3.0
-#define BRAKE_DECEL 30.0
-#define THROTTLE_INCREMENT 0.05
-#define STEER_INCREMENT 0.1
-
-#define STEERING_RATE (20.0 * PI / 180.0)
-#define CENTERING_RATE (33.0 * PI / 180.0)
-#define HEADING_DEADZONE (0.5 * PI / 180.0)
-
-#define ROLLING_RESISTANCE 100.0
-#define DRAG_FORCE 400.0
-#define SYSTEM_EFFICIENCY 0.85
-#define DRIVELINE_EFFICIENCY 0.95
-#define FINAL_DRIVE 3.5
-#define WHEEL_RADIUS 0.3
-#define MAX_ENGINE_POWER 150000.0 
 
-typedef struct
-{
-    double speed;
-    double fuel;
-    int gear;
-    double heading;
-    double x;
-    double y;
-} EngineStateIn;
+#define THROTTLE_RATE 3.0   // per second while W is held
+#define STEER_RATE_INPUT 6.0  // per second while A/D is held
 
-typedef struct
-{
-    double throttle;
-    double brake;
-    double steer;
-    int reverse;
-
-    double speed;
-    double heading;
-    double x;
-    double y;
-
-    double rpm;
-    double power;
-    double torque;
-} EngineStateOut;
+// A key counts as held until this long (wall clock) after its last
+// press/auto-repeat, so control feel does not depend on the tick rate.
+#define KEY_HOLD_TIME 0.07
 
+// What the display shows; the physics lives in engine_step.c
 typedef struct
 {
     // Controls
@@ -86,176 +48,40 @@ typedef struct
     double rpm;
     double power;
     double torque;
-    double actual_power;
 
 } CarState;
 
-double gear_ratios[] = {0.0, 3.5, 2.0, 1.5, 1.0, 0.8};
-
 CarState car = {0};
+EngineState engine = {0};
 int last_key_pressed = 0;
 
-// Key states
-bool key_w_held = false;
-bool key_s_held = false;
-bool key_a_held = false;
-bool key_d_held = false;
+// Key states: wall-clock time of the last press
+double key_w_time = -1.0;
+double key_s_time = -1.0;
+double key_a_time = -1.0;
+double key_d_time = -1.0;
 
 bool running = true;
 
-void calculate_physics(double dt)
+double wall_time()
 {
-    if (!car.engine_on || car.gear == 0)
-    {
-        car.rpm = car.engine_on ? IDLE_RPM : 0.0;
-        car.torque = 0.0;
-        car.power = 0.0;
-        return;
-    }
-
-    /*Calculate RPM from speed */
-    double GR = gear_ratios[car.gear];
-
-    if (car.speed > 0.1)
-    {
-        car.rpm = (car.speed * 60.0 * GR * FINAL_DRIVE) /
-                  (2.0 * PI * WHEEL_RADIUS);
-    }
-    else
-    {
-        car.rpm = IDLE_RPM;
-    }
-
-    /* clamp RPM */
-    if (car.rpm < IDLE_RPM)
-        car.rpm = IDLE_RPM;
-    if (car.rpm > MAX_RPM)
-        car.rpm = MAX_RPM;
-
-    double peak_torque = 250.0; 
-    double peak_rpm = 3500.0;   
-
-    double torque_factor;
-
-    if (car.rpm <= peak_rpm)
-    {
-        /* Torque rises from idle to peak RPM */
-        torque_factor = car.rpm / peak_rpm;
-    }
-    else
-    {
-        /* Torque falls after peak RPM */
-        torque_factor = (MAX_RPM - car.rpm) /
-                        (MAX_RPM - peak_rpm);
-    }
-
-    if (torque_factor < 0.0)
-        torque_factor = 0.0;
-
-    car.torque = peak_torque * torque_factor * car.throttle;
-
- 
-
-    car.power = (car.torque * car.rpm * 2.0 * PI) / 60.0;
-
-    /* clamp engine power */
-    if (car.power > MAX_ENGINE_POWER)
-        car.power = MAX_ENGINE_POWER;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
 }
 
-void update_speed(double dt)
+double clamp(double v, double lo, double hi)
 {
-    bool braking = (car.brake > 0.0);
-
-    if (!car.engine_on)
-    {
-        // engine off
-        if (car.speed > 0.0)
-        {
-            car.speed -= ENGINE_OFF_DECEL * dt;
-            if (car.speed < 0.0)
-                car.speed = 0.0;
-        }
-        car.throttle = 0.0;
-    }
-    else if (braking)
-    {
-        // Braking
-        if (car.speed > 0.0)
-        {
-            car.speed -= BRAKE_DECEL * dt;
-            if (car.speed < 0.0)
-                car.speed = 0.0;
-        }
-    }
-    else if (car.fuel > 0.0 && car.throttle > 0.0)
-    {
-        // Accelerating
-        double acceleration = car.throttle * 10.0;
-        car.speed += acceleration * dt;
-
-        // Apply resistance
-        double resistance_decel = (ROLLING_RESISTANCE + DRAG_FORCE) * car.speed / 5000.0;
-        car.speed -= resistance_decel * dt;
-
-        // Cap speed
-        double max_speed = car.reverse ? MAX_REVERSE_SPEED : MAX_FORWARD_SPEED;
-        if (car.speed > max_speed)
-            car.speed = max_speed;
-    }
-    else
-    {
-        // Natural deceleration
-        if (car.speed > 0.0)
-        {
-            car.speed -= 2.0 * dt;
-            if (car.speed < 0.0)
-                car.speed = 0.0;
-        }
-    }
+    return v < lo ? lo : (v > hi ? hi : v);
 }
 
-void update_heading(double dt)
+void handle_input(double dt)
 {
-    if (fabs(car.speed) > 0.1)
-    {
-        if (car.steer != 0)
-        {
-            car.heading += car.steer * STEERING_RATE * dt;
+    double now = wall_time();
+    int ch;
 
-            if (car.heading > PI)
-                car.heading -= 2.0 * PI;
-            if (car.heading < -PI)
-                car.heading += 2.0 * PI;
-        }
-        else
-        {
-            if (fabs(car.heading) > HEADING_DEADZONE)
-            {
-                double center_dir = (car.heading > 0) ? -1.0 : 1.0;
-                car.heading += center_dir * CENTERING_RATE * dt;
-            }
-            else
-            {
-                car.heading = 0.0;
-            }
-        }
-    }
-}
-
-void update_position(double dt)
-{
-    double effective_speed = car.reverse ? -car.speed : car.speed;
-
-    car.y += effective_speed * cos(car.heading) * dt;
-    car.x += effective_speed * sin(car.heading) * dt;
-}
-
-void handle_input()
-{
-    int ch = getch();
-
-    if (ch != ERR)
+    // Drain everything the terminal queued since the last tick
+    while ((ch = getch()) != ERR)
     {
         last_key_pressed = ch;
 
@@ -267,7 +93,7 @@ void handle_input()
             if (!car.engine_on)
             {
                 car.throttle = 0.0;
-                key_w_held = false;
+                key_w_time = -1.0;
             }
             break;
 
@@ -282,25 +108,25 @@ void handle_input()
         case KEY_UP:
         case 'w':
         case 'W':
-            key_w_held = true;
+            key_w_time = now;
             break;
 
         case KEY_DOWN:
         case 's':
         case 'S':
-            key_s_held = true;
+            key_s_time = now;
             break;
 
         case KEY_LEFT:
         case 'a':
         case 'A':
-            key_a_held = true;
+            key_a_time = now;
             break;
 
         case KEY_RIGHT:
         case 'd':
         case 'D':
-            key_d_held = true;
+            key_d_time = now;
             break;
 
         case 'q':
@@ -310,18 +136,19 @@ void handle_input()
         }
     }
 
+    bool key_w_held = now - key_w_time < KEY_HOLD_TIME;
+    bool key_s_held = now - key_s_time < KEY_HOLD_TIME;
+    bool key_a_held = now - key_a_time < KEY_HOLD_TIME;
+    bool key_d_held = now - key_d_time < KEY_HOLD_TIME;
+
     if (key_w_held && car.engine_on && car.fuel > 0.0)
     {
-        car.throttle += THROTTLE_INCREMENT;
-        if (car.throttle > 1.0)
-            car.throttle = 1.0;
+        car.throttle = clamp(car.throttle + THROTTLE_RATE * dt, 0.0, 1.0);
         car.brake = 0.0;
     }
     else if (car.throttle > 0.0)
     {
-        car.throttle -= THROTTLE_INCREMENT * 2.0;
-        if (car.throttle < 0.0)
-            car.throttle = 0.0;
+        car.throttle = clamp(car.throttle - THROTTLE_RATE * 2.0 * dt, 0.0, 1.0);
     }
 
     if (key_s_held)
@@ -336,44 +163,25 @@ void handle_input()
 
     if (key_a_held && car.speed > 0.1)
     {
-        car.steer -= STEER_INCREMENT;
-        if (car.steer < -1.0)
-            car.steer = -1.0;
+        car.steer = clamp(car.steer - STEER_RATE_INPUT * dt, -1.0, 1.0);
     }
 
     if (key_d_held && car.speed > 0.1)
     {
-        car.steer += STEER_INCREMENT;
-        if (car.steer > 1.0)
-            car.steer = 1.0;
+        car.steer = clamp(car.steer + STEER_RATE_INPUT * dt, -1.0, 1.0);
     }
 
     if (!key_a_held && !key_d_held)
     {
         if (car.steer > 0.01)
         {
-            car.steer -= STEER_INCREMENT * 0.5;
-            if (car.steer < 0.0)
-                car.steer = 0.0;
+            car.steer = clamp(car.steer - STEER_RATE_INPUT * 0.5 * dt, 0.0, 1.0);
         }
         else if (car.steer < -0.01)
         {
-            car.steer += STEER_INCREMENT * 0.5;
-            if (car.steer > 0.0)
-                car.steer = 0.0;
+            car.steer = clamp(car.steer + STEER_RATE_INPUT * 0.5 * dt, -1.0, 0.0);
         }
     }
-
-    static int frame_count = 0;
-    frame_count++;
-    if (frame_count > 3)
-    {
-        key_w_held = false;
-        key_s_held = false;
-        key_a_held = false;
-        key_d_held = false;
-        frame_count = 0;
-    }
 }
 
 void update_display()
@@ -403,7 +211,7 @@ void update_display()
     mvprintw(17, 2, "X: %.2f m", car.x);
     mvprintw(18, 2, "Y: %.2f m", car.y);
 
-    if (car.rpm >= MAX_RPM)
+    if (car.rpm >= engine.model->max_rpm)
     {
         attron(A_BOLD | A_BLINK);
         mvprintw(23, 2, "RPM:      %.0f *** REDLINE ***", car.rpm);
@@ -423,56 +231,135 @@ void update_display()
     refresh();
 }
 
-int main()
+int main(int argc, char **argv)
 {
+    int vehicle_id = 0;
+    int transport = TRANSPORT_TCP;
+    const char *host = "127.0.0.1";
+    const char *script_path = NULL;
+    const char *model_path = NULL;
+    const char *integrator = NULL;
+
+    static const struct option opts[] = {
+        {"vehicle", required_argument, NULL, 'v'},
+        {"transport", required_argument, NULL, 't'},
+        {"host", required_argument, NULL, 'H'},
+        {"script", required_argument, NULL, 's'},
+        {"model", required_argument, NULL, 'm'},
+        {"integrator", required_argument, NULL, 'I'},
+        {"session", required_argument, NULL, 'i'},
+        {"cpus", required_argument, NULL, 'C'},
+        {NULL, 0, NULL, 0}};
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "v:t:H:s:m:I:i:C:", opts, NULL)) != -1)
+    {
+        if (opt == 'v')
+        {
+            vehicle_id = atoi(optarg);
+        }
+        else if (opt == 't' && transport_parse(optarg) >= 0)
+        {
+            transport = transport_parse(optarg);
+        }
+        else if (opt == 'H')
+        {
+            host = optarg;
+        }
+        else if (opt == 's')
+        {
+            script_path = optarg;
+        }
+        else if (opt == 'm')
+        {
+            model_path = optarg;
+        }
+        else if (opt == 'I')
+        {
+            integrator = optarg;
+        }
+        else if (opt == 'i' && session_set(optarg))
+        {
+            continue;
+        }
+        else if (opt == 'C' && session_pin(optarg))
+        {
+            continue;
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [-v vehicle_id] [-t tcp|shm] [-H host] [-s script] [-m model] [-I euler|rk4|analytic[:substeps]] [-i session] [-C cpus]\n", argv[0]);
+            return 1;
+        }
+    }
 
-    int sock = socket(AF_INET, SOCK_STREAM, 0);
-    if (sock < 0)
+    // With a drive script the client runs headless: no terminal needed
+    DriveScript *script = NULL;
+    if (script_path)
     {
-        perror("socket");
-        return 1;
+        script = drive_script_load(script_path);
+        if (!script)
+        {
+            return 1;
+        }
     }
+    bool headless = script != NULL;
 
-    struct sockaddr_in addr = {0};
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(SERVER_PORT);
-    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    engine_init(&engine);
+    VehicleModel *model = NULL;
+    if (model_path)
+    {
+        model = vehicle_model_load(model_path);
+        if (!model)
+        {
+            return 1;
+        }
+        engine.model = model;
+    }
+    if (integrator && !engine_integrator_parse(integrator, &engine))
+    {
+        fprintf(stderr, "[ENGINE] --integrator must be euler, rk4 or analytic, optionally :N substeps (1..%d)\n", MAX_SUBSTEPS);
+        return 1;
+    }
 
-    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    int id = HANDSHAKE(CLIENT_ENGINE, vehicle_id);
+    Transport *link = transport_connect(transport, host, id);
+    if (!link)
     {
-        perror("connect");
         return 1;
     }
 
     printf("[ENGINE] Connected to server\n");
+    printf("[ENGINE] Sent client ID = %d (vehicle %d)\n", CLIENT_ENGINE, vehicle_id);
 
-    int id = CLIENT_ID;
-    write(sock, &id, sizeof(id));
-    printf("[ENGINE] Sent client ID = %d\n", id);
-
-    initscr();
-    cbreak();
-    noecho();
-    nodelay(stdscr, TRUE);
-    keypad(stdscr, TRUE);
-    curs_set(0);
+    if (!headless)
+    {
+        initscr();
+        cbreak();
+        noecho();
+        nodelay(stdscr, TRUE);
+        keypad(stdscr, TRUE);
+        curs_set(0);
+    }
 
     car.engine_on = false;
     car.fuel = 100.0;
 
-    struct timespec last_time, current_time;
-    clock_gettime(CLOCK_MONOTONIC, &last_time);
+    long steps = 0;
+    double physics_time = 0.0;
 
     while (running)
     {
 
         EngineStateIn in;
-        ssize_t n = read(sock, &in, sizeof(in));
-        if (n <= 0)
+        if (!transport_recv(link, &in, sizeof(in)))
         {
-            mvprintw(30, 0, "Server disconnected");
-            refresh();
-            sleep(2);
+            if (!headless)
+            {
+                mvprintw(30, 0, "Server disconnected");
+                refresh();
+                sleep(2);
+            }
             break;
         }
 
@@ -484,49 +371,65 @@ int main()
         car.x = in.x;
         car.y = in.y;
 
-        // Calculate delta time
-        clock_gettime(CLOCK_MONOTONIC, &current_time);
-        double dt = (current_time.tv_sec - last_time.tv_sec) +
-                    (current_time.tv_nsec - last_time.tv_nsec) / 1e9;
-        last_time = current_time;
-
-        // Handle input
-        handle_input();
+        // Driver input: keyboard, or the script at this simulation time
+        if (headless)
+        {
+            drive_script_at(script, in.sim_time, &engine.driver);
+        }
+        else
+        {
+            // Step length comes from the server's simulation clock
+            handle_input(in.dt);
+            engine.driver.throttle = car.throttle;
+            engine.driver.brake = car.brake;
+            engine.driver.steer = car.steer;
+            engine.driver.engine_on = car.engine_on;
+            engine.driver.reverse = car.reverse;
+        }
 
         // Update physics
-        update_speed(dt);
-        calculate_physics(dt);
-        update_heading(dt);
-        update_position(dt);
-
-        // Send back to server
         EngineStateOut out;
-        out.throttle = car.throttle;
-        out.brake = car.brake;
-        out.steer = car.steer;
-        out.reverse = car.reverse ? 1 : 0;
-
-        out.speed = car.speed;
-        out.heading = car.heading;
-        out.x = car.x;
-        out.y = car.y;
+        double t0 = wall_time();
+        engine_step(&engine, &in, &out);
+        physics_time += wall_time() - t0;
+        steps++;
+
+        // Keep the display (and the keyboard ramps) in sync with the step
+        car.throttle = out.throttle;
+        car.brake = out.brake;
+        car.steer = out.steer;
+        car.reverse = out.reverse;
+        car.speed = out.speed;
+        car.heading = out.heading;
+        car.x = out.x;
+        car.y = out.y;
+        car.rpm = out.rpm;
+        car.power = out.power;
+        car.torque = out.torque;
 
-        out.rpm = car.rpm;
-        out.power = car.power;
-        out.torque = car.torque;
-
-        write(sock, &out, sizeof(out));
-
-        // Update display
-        update_display();
+        // Send back to server
+        transport_send(link, &out, sizeof(out));
 
-        usleep(16666); // ~60 FPS
+        // Update display (the server's tick paces this loop)
+        if (!headless)
+        {
+            update_display();
+        }
     }
 
     // Cleanup
-    endwin();
-    close(sock);
-
+    if (!headless)
+    {
+        endwin();
+    }
+    transport_close(link);
+    drive_script_free(script);
+    vehicle_model_free(model);
+
+    printf("[ENGINE] %ld steps, physics %.1f ns/step\n",
+           steps, steps ? physics_time * 1e9 / steps : 0.0);
+    printf("[ENGINE] Final: speed %.2f m/s, x %.2f, y %.2f, fuel %.2f L\n",
+           car.speed, car.x, car.y, car.fuel);
     printf("[ENGINE] Shut down\n");
     return 0;
 }
@@ -0,0 +1,19 @@
+#ifndef ENGINE_PARAMS_H
+#define ENGINE_PARAMS_H
+
+/*
+ * Engine step constants shared by engine_step.c and fleet_kernel.c.
+ * Drivetrain and torque curve come from the VehicleModel.
+ */
+
+#define PI 3.14159265359
+
+#define ENGINE_OFF_DECEL 3.0
+#define BRAKE_DECEL 30.0
+#define COAST_DECEL 2.0
+
+#define STEERING_RATE (20.0 * PI / 180.0)
+#define CENTERING_RATE (33.0 * PI / 180.0)
+#define HEADING_DEADZONE (0.5 * PI / 180.0)
+
+#endif
@@ -0,0 +1,448 @@
+#include <math.h>
+#include <stdbool.h>
+
+#include "sim_plugin.h"
+#include "engine_params.h"
+
+/* Working copy of one vehicle for the duration of a step. */
+typedef struct
+{
+    // Controls
+    double throttle;
+    double brake;
+    double steer;
+    bool reverse;
+    bool engine_on;
+
+    // State
+    double speed;
+    int gear;
+    double heading;
+    double x, y;
+    double fuel;
+
+    // Physics
+    double rpm;
+    double power;
+    double torque;
+} Car;
+
+static double clamp(double v, double lo, double hi)
+{
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+static void apply_driver(Car *car, const EngineState *st)
+{
+    const DriverInput *d = &st->driver;
+
+    car->engine_on = d->engine_on;
+
+    /* car->reverse holds the latch from the request */
+    if (d->reverse != car->reverse && car->speed < 0.1)
+    {
+        car->reverse = d->reverse;
+    }
+
+    car->brake = clamp(d->brake, 0.0, 1.0);
+    car->steer = clamp(d->steer, -1.0, 1.0);
+
+    if (car->engine_on && car->fuel > 0.0 && car->brake == 0.0)
+    {
+        car->throttle = clamp(d->throttle, 0.0, 1.0);
+    }
+    else
+    {
+        car->throttle = 0.0;
+    }
+}
+
+/* Engine speed and torque at the car's current speed. */
+static void calculate_physics(Car *car, const VehicleModel *m)
+{
+    if (!car->engine_on || car->gear == 0)
+    {
+        car->rpm = car->engine_on ? m->idle_rpm : 0.0;
+        car->torque = 0.0;
+        car->power = 0.0;
+        return;
+    }
+
+    /* RPM from speed through the gearbox */
+    int slot = vm_gear_slot(car->gear);
+
+    if (car->speed > 0.1)
+    {
+        car->rpm = car->speed * m->rpm_per_mps[slot];
+    }
+    else
+    {
+        car->rpm = m->idle_rpm;
+    }
+
+    /* clamp RPM */
+    if (car->rpm < m->idle_rpm)
+        car->rpm = m->idle_rpm;
+    if (car->rpm > m->max_rpm)
+        car->rpm = m->max_rpm;
+
+    car->torque = vm_torque(m, car->rpm) * car->throttle;
+
+    car->power = (car->torque * car->rpm * 2.0 * PI) / 60.0;
+
+    /* clamp engine power */
+    if (car->power > m->max_power)
+        car->power = m->max_power;
+}
+
+static void update_speed(Car *car, const VehicleModel *m, double dt)
+{
+    bool braking = (car->brake > 0.0);
+
+    if (!car->engine_on)
+    {
+        // engine off
+        if (car->speed > 0.0)
+        {
+            car->speed -= ENGINE_OFF_DECEL * dt;
+            if (car->speed < 0.0)
+                car->speed = 0.0;
+        }
+        car->throttle = 0.0;
+    }
+    else if (braking)
+    {
+        // Braking
+        if (car->speed > 0.0)
+        {
+            car->speed -= BRAKE_DECEL * dt;
+            if (car->speed < 0.0)
+                car->speed = 0.0;
+        }
+    }
+    else if (car->fuel > 0.0 && car->torque > 0.0)
+    {
+        // Accelerating: wheel torque through the gear, less resistance
+        double acceleration = car->torque * m->accel_per_nm[vm_gear_slot(car->gear)] -
+                              m->resistance * car->speed;
+        car->speed += acceleration * dt;
+        if (car->speed < 0.0)
+            car->speed = 0.0;
+
+        // Cap speed
+        double max_speed = car->reverse ? m->max_reverse_speed : m->max_speed;
+        if (car->speed > max_speed)
+            car->speed = max_speed;
+    }
+    else
+    {
+        // Natural deceleration
+        if (car->speed > 0.0)
+        {
+            car->speed -= COAST_DECEL * dt;
+            if (car->speed < 0.0)
+                car->speed = 0.0;
+        }
+    }
+}
+
+static void update_heading(Car *car, double dt)
+{
+    if (fabs(car->speed) > 0.1)
+    {
+        if (car->steer != 0)
+        {
+            car->heading += car->steer * STEERING_RATE * dt;
+
+            if (car->heading > PI)
+                car->heading -= 2.0 * PI;
+            if (car->heading < -PI)
+                car->heading += 2.0 * PI;
+        }
+        else
+        {
+            if (fabs(car->heading) > HEADING_DEADZONE)
+            {
+                double center_dir = (car->heading > 0) ? -1.0 : 1.0;
+                car->heading += center_dir * CENTERING_RATE * dt;
+            }
+            else
+            {
+                car->heading = 0.0;
+            }
+        }
+    }
+}
+
+static void update_position(Car *car, double dt)
+{
+    double effective_speed = car->reverse ? -car->speed : car->speed;
+
+    car->y += effective_speed * cos(car->heading) * dt;
+    car->x += effective_speed * sin(car->heading) * dt;
+}
+
+/* ---------------- HIGHER-ORDER INTEGRATORS ---------------- */
+
+/* Deceleration update_speed would apply, or 0 when the engine drives. */
+static double fixed_decel(const Car *car)
+{
+    if (!car->engine_on)
+        return ENGINE_OFF_DECEL;
+    if (car->brake > 0.0)
+        return BRAKE_DECEL;
+    if (car->fuel > 0.0 && car->torque > 0.0)
+        return 0.0;
+    return COAST_DECEL;
+}
+
+static double top_speed(const Car *car, const VehicleModel *m)
+{
+    return car->reverse ? m->max_reverse_speed : m->max_speed;
+}
+
+/* dv/dt at speed s, with the torque map read at the rpm s gives. */
+static double speed_rate(const Car *car, const VehicleModel *m, double decel, double s)
+{
+    if (decel > 0.0)
+        return s > 0.0 ? -decel : 0.0;
+
+    int slot = vm_gear_slot(car->gear);
+    double rpm = s > 0.1 ? s * m->rpm_per_mps[slot] : m->idle_rpm;
+    rpm = clamp(rpm, m->idle_rpm, m->max_rpm);
+
+    double a = vm_torque(m, rpm) * car->throttle * m->accel_per_nm[slot] - m->resistance * s;
+    return (a > 0.0 && s >= top_speed(car, m)) ? 0.0 : a;
+}
+
+/* Heading change tau into a substep, unwrapped: steering turns at a
+ * constant rate, centering runs back to the deadzone and snaps to 0. */
+static double heading_change(const Car *car, bool turning, double tau)
+{
+    if (!turning)
+        return 0.0;
+    if (car->steer != 0)
+        return car->steer * STEERING_RATE * tau;
+
+    double left = fabs(car->heading) - CENTERING_RATE * tau;
+    if (fabs(car->heading) <= HEADING_DEADZONE || left <= HEADING_DEADZONE)
+        return -car->heading;
+    return car->heading > 0 ? left - car->heading : car->heading + left;
+}
+
+static double wrap_heading(double h)
+{
+    if (h > PI)
+        h -= 2.0 * PI;
+    if (h < -PI)
+        h += 2.0 * PI;
+    return h;
+}
+
+static void integrate_rk4(Car *car, const VehicleModel *m, double h)
+{
+    double decel = fixed_decel(car);
+    double vmax = top_speed(car, m);
+    double s0 = car->speed;
+
+    /* Speed does not depend on position, so its stages come first */
+    double s[4], k[4];
+    s[0] = s0;
+    k[0] = speed_rate(car, m, decel, s[0]);
+    s[1] = s0 + 0.5 * h * k[0];
+    k[1] = speed_rate(car, m, decel, s[1]);
+    s[2] = s0 + 0.5 * h * k[1];
+    k[2] = speed_rate(car, m, decel, s[2]);
+    s[3] = s0 + h * k[2];
+    k[3] = speed_rate(car, m, decel, s[3]);
+
+    double s1 = s0 + h / 6.0 * (k[0] + 2.0 * k[1] + 2.0 * k[2] + k[3]);
+    s1 = clamp(s1, 0.0, decel > 0.0 ? s0 : vmax);
+
+    bool turning = s1 > 0.1;
+    double dir = car->reverse ? -1.0 : 1.0;
+    double th[4] = {
+        car->heading,
+        car->heading + heading_change(car, turning, 0.5 * h),
+        car->heading + heading_change(car, turning, 0.5 * h),
+        car->heading + heading_change(car, turning, h),
+    };
+    static const double weight[4] = { 1.0, 2.0, 2.0, 1.0 };
+
+    double dx = 0.0, dy = 0.0;
+    for (int i = 0; i < 4; i++)
+    {
+        double v = dir * clamp(s[i], 0.0, vmax) * weight[i];
+        dx += v * sin(th[i]);
+        dy += v * cos(th[i]);
+    }
+
+    car->speed = s1;
+    car->heading = wrap_heading(th[3]);
+    car->x += dx * h / 6.0;
+    car->y += dy * h / 6.0;
+}
+
+static void integrate_analytic(Car *car, const VehicleModel *m, double h)
+{
+    double decel = fixed_decel(car);
+    double s0 = car->speed;
+    double s1, dist;
+
+    if (decel > 0.0)
+    {
+        /* Constant deceleration until the car stops */
+        double t = s0 > 0.0 ? fmin(h, s0 / decel) : 0.0;
+        s1 = t < h ? 0.0 : s0 - decel * h;
+        dist = (s0 - 0.5 * decel * t) * t;
+    }
+    else
+    {
+        /*
+         * dv/dt = a - k v.  Within one torque table cell the torque is
+         * linear in rpm, and rpm in speed, so the map's slope moves into k;
+         * at idle or the rev limit the torque is flat.
+         */
+        int slot = vm_gear_slot(car->gear);
+        double per_nm = car->throttle * m->accel_per_nm[slot];
+        double a = car->torque * m->accel_per_nm[slot];
+        double k = m->resistance;
+        double rpm = s0 * m->rpm_per_mps[slot];
+        if (s0 > 0.1 && rpm > m->idle_rpm && rpm < m->max_rpm)
+        {
+            int cell = (int)(rpm * m->torque_cells_per_rpm);
+            a = m->torque_a[cell] * per_nm;
+            k -= m->torque_b[cell] * m->rpm_per_mps[slot] * per_nm;
+        }
+
+        double vmax = top_speed(car, m);
+        double t = h;   // time spent below the cap
+        if (fabs(k) < 1e-9)
+        {
+            s1 = s0 + a * h;
+            if (s1 > vmax)
+                t = s0 < vmax ? (vmax - s0) / a : 0.0;
+            dist = (s0 + 0.5 * a * t) * t;
+        }
+        else
+        {
+            double s_inf = a / k;
+            s1 = s_inf + (s0 - s_inf) * exp(-k * h);
+            if (s1 > vmax)
+                t = s0 < vmax ? -log((vmax - s_inf) / (s0 - s_inf)) / k : 0.0;
+            dist = s_inf * t + (s0 - s_inf) * (1.0 - exp(-k * t)) / k;
+        }
+        if (s1 > vmax)
+        {
+            s1 = vmax;
+            dist += vmax * (h - t);
+        }
+        if (s1 < 0.0)
+            s1 = 0.0;
+    }
+
+    /* Along the arc: the chord of a turn through dh is sinc(dh / 2) of
+     * its length, in the direction of the heading half way round */
+    double dh = heading_change(car, s1 > 0.1, h);
+    double chord = fabs(dh) > 1e-9 ? sin(0.5 * dh) / (0.5 * dh) : 1.0;
+    double mid = car->heading + 0.5 * dh;
+    double d = (car->reverse ? -dist : dist) * chord;
+
+    car->speed = s1;
+    car->heading = wrap_heading(car->heading + dh);
+    car->x += d * sin(mid);
+    car->y += d * cos(mid);
+}
+
+void engine_step(EngineState *st, const EngineStateIn *in, EngineStateOut *out)
+{
+    Car car = {0};
+
+    car.speed = in->speed;
+    car.fuel = in->fuel;
+    car.gear = in->gear;
+    car.heading = in->heading;
+    car.x = in->x;
+    car.y = in->y;
+    car.reverse = in->reverse != 0;
+
+    apply_driver(&car, st);
+
+    const VehicleModel *m = st->model ? st->model : vehicle_model_default();
+
+    int substeps = st->substeps > 1 ? st->substeps : 1;
+    double h = in->dt / substeps;
+
+    for (int i = 0; i < substeps; i++)
+    {
+        calculate_physics(&car, m);
+
+        switch (st->integrator)
+        {
+        case INTEGRATOR_RK4:
+            integrate_rk4(&car, m, h);
+            break;
+        case INTEGRATOR_ANALYTIC:
+            integrate_analytic(&car, m, h);
+            break;
+        default:
+            update_speed(&car, m, h);
+            update_heading(&car, h);
+            update_position(&car, h);
+            break;
+        }
+    }
+
+    /* The original step reports the engine as it was at the start; with
+     * substeps, or an integrator that solves to the end, the transmission
+     * gets the rpm the car ends the step at */
+    if (substeps > 1 || st->integrator != INTEGRATOR_EULER)
+        calculate_physics(&car, m);
+
+    out->throttle = car.throttle;
+    out->brake = car.brake;
+    out->steer = car.steer;
+    out->reverse = car.reverse ? 1 : 0;
+
+    out->speed = car.speed;
+    out->heading = car.heading;
+    out->x = car.x;
+    out->y = car.y;
+
+    out->rpm = car.rpm;
+    out->power = car.power;
+    out->torque = car.torque;
+    out->num_gears = m->num_gears;
+
+    out->driver = st->driver;
+}
+
+/* ---------------- PLUGIN DESCRIPTOR ---------------- */
+
+void engine_init(EngineState *st)
+{
+    st->model = vehicle_model_default();
+    st->integrator = INTEGRATOR_EULER;
+    st->substeps = 1;
+}
+
+static void init(void *state)
+{
+    engine_init(state);
+}
+
+static void step(void *state, const void *in, void *out)
+{
+    engine_step(state, in, out);
+}
+
+const SimPlugin engine_plugin = {
+    .abi = SIM_PLUGIN_ABI,
+    .type = CLIENT_ENGINE,
+    .name = "engine",
+    .state_size = sizeof(EngineState),
+    .in_size = sizeof(EngineStateIn),
+    .out_size = sizeof(EngineStateOut),
+    .init = init,
+    .step = step,
+};
@@ -0,0 +1,235 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "fleet_kernel.h"
+#include "engine_params.h"
+#include "sim_plugin.h"
+
+#define FLEET_ALIGN 64
+
+/* ---------------- ALLOCATION ---------------- */
+
+static void *fleet_array(int count, size_t elem) {
+    size_t bytes = ((size_t)count * elem + FLEET_ALIGN - 1) & ~(size_t)(FLEET_ALIGN - 1);
+    void *p = aligned_alloc(FLEET_ALIGN, bytes ? bytes : FLEET_ALIGN);
+    if (p)
+        memset(p, 0, bytes);
+    return p;
+}
+
+FleetState *fleet_alloc(int count) {
+    FleetState *f = calloc(1, sizeof(FleetState));
+    f->count = count;
+
+    f->throttle_in = fleet_array(count, sizeof(double));
+    f->brake_in    = fleet_array(count, sizeof(double));
+    f->steer_in    = fleet_array(count, sizeof(double));
+    f->engine_on   = fleet_array(count, sizeof(int));
+    f->reverse_in  = fleet_array(count, sizeof(int));
+
+    f->speed   = fleet_array(count, sizeof(double));
+    f->heading = fleet_array(count, sizeof(double));
+    f->x       = fleet_array(count, sizeof(double));
+    f->y       = fleet_array(count, sizeof(double));
+    f->fuel    = fleet_array(count, sizeof(double));
+    f->gear    = fleet_array(count, sizeof(int));
+    f->reverse = fleet_array(count, sizeof(int));
+
+    f->throttle = fleet_array(count, sizeof(double));
+    f->brake    = fleet_array(count, sizeof(double));
+    f->steer    = fleet_array(count, sizeof(double));
+    f->rpm      = fleet_array(count, sizeof(double));
+    f->torque   = fleet_array(count, sizeof(double));
+    f->power    = fleet_array(count, sizeof(double));
+
+    f->model = vehicle_model_default();
+    return f;
+}
+
+void fleet_free(FleetState *f) {
+    if (!f)
+        return;
+
+    free(f->throttle_in); free(f->brake_in); free(f->steer_in);
+    free(f->engine_on);   free(f->reverse_in);
+    free(f->speed); free(f->heading); free(f->x); free(f->y);
+    free(f->fuel);  free(f->gear);    free(f->reverse);
+    free(f->throttle); free(f->brake);  free(f->steer);
+    free(f->rpm);      free(f->torque); free(f->power);
+    free(f);
+}
+
+/* ---------------- REFERENCE ---------------- */
+
+void fleet_step_scalar(FleetState *f, double dt) {
+    for (int i = 0; i < f->count; i++) {
+        EngineState st;
+        st.driver.throttle  = f->throttle_in[i];
+        st.driver.brake     = f->brake_in[i];
+        st.driver.steer     = f->steer_in[i];
+        st.driver.engine_on = f->engine_on[i];
+        st.driver.reverse   = f->reverse_in[i];
+        st.model            = f->model;
+        st.integrator       = INTEGRATOR_EULER;
+        st.substeps         = 1;
+
+        EngineStateIn in;
+        in.speed    = f->speed[i];
+        in.fuel     = f->fuel[i];
+        in.gear     = f->gear[i];
+        in.heading  = f->heading[i];
+        in.x        = f->x[i];
+        in.y        = f->y[i];
+        in.reverse  = f->reverse[i];
+        in.sim_time = 0.0;
+        in.dt       = dt;
+
+        EngineStateOut out;
+        engine_step(&st, &in, &out);
+
+        f->reverse[i]  = out.reverse;
+        f->speed[i]    = out.speed;
+        f->heading[i]  = out.heading;
+        f->x[i]        = out.x;
+        f->y[i]        = out.y;
+        f->throttle[i] = out.throttle;
+        f->brake[i]    = out.brake;
+        f->steer[i]    = out.steer;
+        f->rpm[i]      = out.rpm;
+        f->torque[i]   = out.torque;
+        f->power[i]    = out.power;
+    }
+}
+
+/* ---------------- KERNEL ---------------- */
+
+static inline double clampd(double v, double lo, double hi) {
+    return fmin(fmax(v, lo), hi);
+}
+
+/* Speed after decelerating at `decel` without going below zero. */
+static inline double slow_down(double speed, double decel, double dt) {
+    return speed > 0.0 ? fmax(speed - decel * dt, 0.0) : speed;
+}
+
+/*
+ * engine_step() for every vehicle, with each branch turned into a select.
+ * Keep the two in step: fleet_bench checks they agree.
+ *
+ * Heading and position get passes of their own: GCC will not if-convert
+ * the heading selects inside the big loop, and sin and cos of the same
+ * angle in one loop get merged into sincos(), which has no vector version.
+ * The arrays for a few thousand vehicles stay in cache between passes.
+ */
+__attribute__((target_clones("avx2", "default")))
+void fleet_step(FleetState *restrict f, double dt) {
+    const int n = f->count;
+
+    const double *restrict throttle_in = f->throttle_in;
+    const double *restrict brake_in    = f->brake_in;
+    const double *restrict steer_in    = f->steer_in;
+    const int    *restrict engine_on   = f->engine_on;
+    const int    *restrict reverse_in  = f->reverse_in;
+    const double *restrict fuel        = f->fuel;
+    const int    *restrict gear        = f->gear;
+
+    double *restrict speed    = f->speed;
+    double *restrict heading  = f->heading;
+    double *restrict x        = f->x;
+    double *restrict y        = f->y;
+    int    *restrict reverse  = f->reverse;
+    double *restrict throttle = f->throttle;
+    double *restrict brake    = f->brake;
+    double *restrict steer    = f->steer;
+    double *restrict rpm      = f->rpm;
+    double *restrict torque   = f->torque;
+    double *restrict power    = f->power;
+
+    /* Local copies of the lookup tables: GCC does not trust restrict for
+     * gathers, and cannot prove a gather from the model misses the
+     * output arrays.  Copying is a few KB per step. */
+    const VehicleModel *m = f->model;
+    _Alignas(64) double rpm_per_mps[MODEL_GEAR_SLOTS];
+    _Alignas(64) double accel_per_nm[MODEL_GEAR_SLOTS];
+    _Alignas(64) double torque_a[TORQUE_TABLE_SIZE + 1];
+    _Alignas(64) double torque_b[TORQUE_TABLE_SIZE + 1];
+    memcpy(rpm_per_mps, m->rpm_per_mps, sizeof(rpm_per_mps));
+    memcpy(accel_per_nm, m->accel_per_nm, sizeof(accel_per_nm));
+    memcpy(torque_a, m->torque_a, sizeof(torque_a));
+    memcpy(torque_b, m->torque_b, sizeof(torque_b));
+    const double cells_per_rpm = m->torque_cells_per_rpm;
+    const double idle_rpm   = m->idle_rpm;
+    const double max_rpm    = m->max_rpm;
+    const double max_power  = m->max_power;
+    const double resistance = m->resistance;
+    const double max_speed  = m->max_speed;
+    const double max_reverse_speed = m->max_reverse_speed;
+
+    for (int i = 0; i < n; i++) {
+        double s = speed[i];
+
+        /* Flags widened to double so every select works on 64-bit lanes */
+        double on  = engine_on[i];
+        double g   = gear[i];
+        double rev = s < 0.1 ? (double)reverse_in[i] : (double)reverse[i];
+
+        /* Driver: reverse only latches while stopped */
+        double br = clampd(brake_in[i], 0.0, 1.0);
+        double st = clampd(steer_in[i], -1.0, 1.0);
+        double th = clampd(throttle_in[i], 0.0, 1.0);
+        th = (on != 0.0 && fuel[i] > 0.0 && br == 0.0) ? th : 0.0;
+
+        /* RPM, torque and power at the start of the step.  Table loads stay
+         * unconditional so the loop if-converts. */
+        int slot = vm_gear_slot(gear[i]);
+        double k = rpm_per_mps[slot];
+        double r = s > 0.1 ? s * k : idle_rpm;
+        r = clampd(r, idle_rpm, max_rpm);
+
+        int cell = (int)(r * cells_per_rpm);
+        double tq = (torque_a[cell] + torque_b[cell] * r) * th;
+        double pw = fmin(tq * r * 2.0 * PI / 60.0, max_power);
+
+        int loaded = on != 0.0 && g != 0.0;
+        tq = loaded ? tq : 0.0;
+        rpm[i]    = loaded ? r  : (on != 0.0 ? idle_rpm : 0.0);
+        torque[i] = tq;
+        power[i]  = loaded ? pw : 0.0;
+
+        /* Speed: engine off / braking / accelerating / coasting */
+        double s_acc = s + (tq * accel_per_nm[slot] - resistance * s) * dt;
+        s_acc = clampd(s_acc, 0.0, rev != 0.0 ? max_reverse_speed : max_speed);
+
+        double decel = on == 0.0 ? ENGINE_OFF_DECEL : (br > 0.0 ? BRAKE_DECEL : COAST_DECEL);
+        double s_dec = slow_down(s, decel, dt);
+        int accel = on != 0.0 && br <= 0.0 && fuel[i] > 0.0 && tq > 0.0;
+
+        speed[i]    = accel ? s_acc : s_dec;
+        reverse[i]  = (int)rev;
+        throttle[i] = th;
+        brake[i]    = br;
+        steer[i]    = st;
+    }
+
+    /* Heading: steer, or drift back to straight ahead */
+    for (int i = 0; i < n; i++) {
+        double h  = heading[i];
+        double st = steer[i];
+
+        double h_steer = h + st * STEERING_RATE * dt;
+        double wrap = h_steer > PI ? -2.0 * PI : (h_steer < -PI ? 2.0 * PI : 0.0);
+        h_steer += wrap;
+        double h_center = h - copysign(CENTERING_RATE * dt, h);
+        h_center = fabs(h) > HEADING_DEADZONE ? h_center : 0.0;
+        double h_turn = st != 0.0 ? h_steer : h_center;
+
+        heading[i] = fabs(speed[i]) > 0.1 ? h_turn : h;
+    }
+
+    /* Position, one axis per pass */
+    for (int i = 0; i < n; i++)
+        y[i] += (reverse[i] ? -speed[i] : speed[i]) * cos(heading[i]) * dt;
+    for (int i = 0; i < n; i++)
+        x[i] += (reverse[i] ? -speed[i] : speed[i]) * sin(heading[i]) * dt;
+}
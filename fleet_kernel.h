@@ -0,0 +1,56 @@
+#ifndef FLEET_KERNEL_H
+#define FLEET_KERNEL_H
+
+#include "vehicle_model.h"
+
+/*
+ * Engine physics for a whole fleet at once.
+ *
+ * Vehicles are stored as a structure of arrays, one 64-byte aligned array
+ * per field, so a step is a single pass of straight-line arithmetic over
+ * contiguous memory.  fleet_step() is the branch-free version of
+ * engine_step(): every if/else is computed both ways and selected, which
+ * lets the compiler vectorize the loop (the avx2 clone is picked at run
+ * time where the CPU has it).  fleet_step_scalar() runs engine_step() on
+ * each vehicle and is the reference the kernel must agree with.
+ *
+ * Flags (engine_on, reverse) are ints so every lane is 32 or 64 bits.
+ */
+
+typedef struct {
+    int count;
+    const VehicleModel *model;  // one model for the fleet; default after fleet_alloc
+
+    /* Driver inputs, set before each step */
+    double *throttle_in;
+    double *brake_in;
+    double *steer_in;
+    int    *engine_on;
+    int    *reverse_in;
+
+    /* Vehicle state, updated by the step (gear and fuel come from the
+     * transmission and fuel stages) */
+    double *speed;
+    double *heading;
+    double *x;
+    double *y;
+    double *fuel;
+    int    *gear;
+    int    *reverse;    // latched, as EngineStateIn.reverse
+
+    /* Step outputs */
+    double *throttle;
+    double *brake;
+    double *steer;
+    double *rpm;
+    double *torque;
+    double *power;
+} FleetState;
+
+FleetState *fleet_alloc(int count);     // all fields zero
+void fleet_free(FleetState *f);
+
+void fleet_step(FleetState *f, double dt);
+void fleet_step_scalar(FleetState *f, double dt);
+
+#endif
@@ -0,0 +1,363 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "fleet_lod.h"
+
+/* ---------------- ROWS ---------------- */
+
+#define LOD_FIELDS(X) \
+    X(throttle_in) X(brake_in) X(steer_in) X(engine_on) X(reverse_in) \
+    X(speed) X(heading) X(x) X(y) X(fuel) X(gear) X(reverse) \
+    X(throttle) X(brake) X(steer) X(rpm) X(torque) X(power)
+
+static void row_copy(FleetState *dst, int d, const FleetState *src, int s) {
+#define COPY(field) dst->field[d] = src->field[s];
+    LOD_FIELDS(COPY)
+#undef COPY
+}
+
+static void rows_copy(FleetState *dst, const FleetState *src, int n) {
+#define COPY(field) memcpy(dst->field, src->field, n * sizeof(*dst->field));
+    LOD_FIELDS(COPY)
+#undef COPY
+}
+
+/* Only what a step reads comes in, and only what it writes goes back */
+static void gather(FleetState *dst, const FleetState *src, const int *ids, int n) {
+    dst->count = n;
+    dst->model = src->model;
+#define GATHER(field) \
+    for (int k = 0; k < n; k++) dst->field[k] = src->field[ids[k]];
+    GATHER(throttle_in) GATHER(brake_in) GATHER(steer_in) GATHER(engine_on)
+    GATHER(reverse_in) GATHER(speed) GATHER(heading) GATHER(x) GATHER(y) GATHER(fuel)
+    GATHER(gear) GATHER(reverse)
+#undef GATHER
+}
+
+static void scatter(FleetState *dst, const FleetState *src, const int *ids, int n) {
+#define SCATTER(field) \
+    for (int k = 0; k < n; k++) dst->field[ids[k]] = src->field[k];
+    SCATTER(speed) SCATTER(heading) SCATTER(x) SCATTER(y) SCATTER(reverse)
+    SCATTER(throttle) SCATTER(brake) SCATTER(steer) SCATTER(rpm) SCATTER(torque)
+    SCATTER(power)
+#undef SCATTER
+}
+
+/* ---------------- SETUP ---------------- */
+
+FleetLod *fleet_lod_create(FleetState *f, int coarse_ticks) {
+    int n = f->count ? f->count : 1;
+
+    FleetLod *l = calloc(1, sizeof(FleetLod));
+    l->fleet = f;
+    l->coarse_ticks = coarse_ticks > 0 ? coarse_ticks : LOD_COARSE_TICKS;
+    l->words = (n + 63) / 64;
+
+    /* Asleep until the first step has looked at them */
+    l->level    = calloc(n, 1);
+    l->synced   = calloc(n, sizeof(unsigned));
+    l->slot     = calloc(n, sizeof(int));
+    l->promoted = malloc(n * sizeof(int));
+
+    l->full_capacity = LOD_BLOCK;
+    l->full    = fleet_alloc(l->full_capacity);
+    l->full_id = malloc(l->full_capacity * sizeof(int));
+    l->full_prev = malloc(l->full_capacity * sizeof(double));
+    l->full->count = 0;
+
+    l->coarse       = calloc(l->coarse_ticks, sizeof(unsigned long long *));
+    l->coarse_count = calloc(l->coarse_ticks, sizeof(int));
+    for (int b = 0; b < l->coarse_ticks; b++)
+        l->coarse[b] = calloc(l->words, sizeof(unsigned long long));
+
+    l->block = fleet_alloc(LOD_BLOCK);
+    return l;
+}
+
+void fleet_lod_free(FleetLod *l) {
+    if (!l)
+        return;
+    for (int b = 0; b < l->coarse_ticks; b++)
+        free(l->coarse[b]);
+    free(l->coarse);
+    free(l->coarse_count);
+    fleet_free(l->full);
+    free(l->full_id);
+    free(l->full_prev);
+    free(l->promoted);
+    free(l->level);
+    free(l->synced);
+    free(l->slot);
+    fleet_free(l->block);
+    free(l);
+}
+
+/* ---------------- LEVELS ---------------- */
+
+static int classify(const FleetState *f, int row, double prev_speed, double dt) {
+    if (f->speed[row] == 0.0 && f->torque[row] == 0.0)
+        return LOD_SLEEP;
+    if (f->steer[row] == 0.0 && f->heading[row] == 0.0 &&
+        fabs(f->speed[row] - prev_speed) < LOD_STEADY_ACCEL * dt)
+        return LOD_COARSE;
+    return LOD_FULL;
+}
+
+/* Coarse vehicles join bucket tick % coarse_ticks with synced = tick + 1 */
+static int bucket_of(const FleetLod *l, int i) {
+    return (l->synced[i] - 1) % l->coarse_ticks;
+}
+
+static void coarse_add(FleetLod *l, int i) {
+    int b = l->tick % l->coarse_ticks;
+    l->coarse[b][i >> 6] |= 1ULL << (i & 63);
+    l->coarse_count[b]++;
+    l->synced[i] = l->tick + 1;
+    l->level[i] = LOD_COARSE;
+}
+
+static void coarse_remove(FleetLod *l, int i) {
+    int b = bucket_of(l, i);
+    l->coarse[b][i >> 6] &= ~(1ULL << (i & 63));
+    l->coarse_count[b]--;
+}
+
+/* Move vehicle i's row from the fleet to the end of the full rows. */
+static void full_add(FleetLod *l, int i) {
+    FleetState *a = l->full;
+
+    if (a->count == l->full_capacity) {
+        FleetState *grown = fleet_alloc(l->full_capacity * 2);
+        rows_copy(grown, a, a->count);
+        grown->count = a->count;
+        fleet_free(a);
+        l->full = a = grown;
+        l->full_capacity *= 2;
+        l->full_id = realloc(l->full_id, l->full_capacity * sizeof(int));
+        l->full_prev = realloc(l->full_prev, l->full_capacity * sizeof(double));
+    }
+
+    int k = a->count++;
+    row_copy(a, k, l->fleet, i);
+    l->full_id[k] = i;
+    l->slot[i] = k;
+    l->level[i] = LOD_FULL;
+}
+
+/* Move full row k back into the fleet; the last row takes its place. */
+static void full_remove(FleetLod *l, int k) {
+    FleetState *a = l->full;
+    row_copy(l->fleet, l->full_id[k], a, k);
+
+    int last = --a->count;
+    if (k != last) {
+        row_copy(a, k, a, last);
+        l->full_id[k] = l->full_id[last];
+        l->slot[l->full_id[k]] = k;
+    }
+}
+
+/* Advance a coarse vehicle at its current speed to the start of the tick. */
+static void catch_up(FleetLod *l, int i) {
+    FleetState *f = l->fleet;
+    double t = (double)(l->tick - l->synced[i]) * l->dt;
+    double v = f->reverse[i] ? -f->speed[i] : f->speed[i];
+
+    f->y[i] += v * cos(f->heading[i]) * t;
+    f->x[i] += v * sin(f->heading[i]) * t;
+    l->synced[i] = l->tick;
+}
+
+/* ---------------- STEP ---------------- */
+
+/* A vehicle in the fleet that was just stepped goes where it now belongs */
+static void place(FleetLod *l, int i, int level) {
+    if (level == LOD_COARSE) {
+        coarse_add(l, i);
+    } else if (level == LOD_FULL) {
+        l->level[i] = LOD_FULL;
+        l->promoted[l->num_promoted++] = i;     // joins after the full rows' step
+    } else {
+        l->level[i] = LOD_SLEEP;
+    }
+}
+
+/* The first step: every vehicle not already woken, in place */
+static void step_all(FleetLod *l, double dt) {
+    FleetState *f = l->fleet;
+    double *prev = malloc((f->count ? f->count : 1) * sizeof(double));
+
+    memcpy(prev, f->speed, f->count * sizeof(double));
+    fleet_step(f, dt);
+
+    for (int i = 0; i < f->count; i++)
+        if (l->level[i] == LOD_SLEEP)
+            place(l, i, classify(f, i, prev[i], dt));
+
+    l->full_steps += f->count;
+    free(prev);
+}
+
+static void step_coarse_chunk(FleetLod *l, int n, double dt) {
+    FleetState *f = l->fleet;
+    FleetState *b = l->block;
+
+    gather(b, f, l->chunk, n);
+    memcpy(l->prev_speed, b->speed, n * sizeof(double));
+    fleet_step(b, dt);
+    scatter(f, b, l->chunk, n);
+
+    for (int k = 0; k < n; k++) {
+        int i = l->chunk[k];
+        int level = classify(b, k, l->prev_speed[k], dt);
+        if (level == LOD_COARSE) {
+            l->synced[i] = l->tick + 1;
+        } else {
+            coarse_remove(l, i);
+            place(l, i, level);
+        }
+    }
+    l->coarse_steps += n;
+}
+
+/*
+ * The due bucket, LOD_BLOCK vehicles at a time in id order.  Each word is
+ * copied before its bits are taken, so vehicles leaving the bucket on the
+ * way do not disturb the walk.
+ */
+static void step_coarse(FleetLod *l, double dt) {
+    int b = l->tick % l->coarse_ticks;
+    unsigned long long *bits = l->coarse[b];
+    int n = 0;
+
+    for (int w = 0; w < l->words && l->coarse_count[b]; w++) {
+        unsigned long long word = bits[w];
+        while (word) {
+            l->chunk[n++] = w * 64 + __builtin_ctzll(word);
+            word &= word - 1;
+            if (n == LOD_BLOCK) {
+                step_coarse_chunk(l, n, dt);
+                n = 0;
+            }
+        }
+    }
+    if (n)
+        step_coarse_chunk(l, n, dt);
+}
+
+/* Rows are checked from the end, so the row swapped into a removed one
+ * has already been checked */
+static void step_full(FleetLod *l, double dt) {
+    FleetState *a = l->full;
+    int n = a->count;
+    if (!n)
+        return;
+
+    a->model = l->fleet->model;
+    double *prev = l->full_prev;
+    memcpy(prev, a->speed, n * sizeof(double));
+    fleet_step(a, dt);
+
+    for (int k = n - 1; k >= 0; k--) {
+        int level = classify(a, k, prev[k], dt);
+        if (level == LOD_FULL)
+            continue;
+
+        int i = l->full_id[k];
+        full_remove(l, k);
+        if (level == LOD_COARSE)
+            coarse_add(l, i);
+        else
+            l->level[i] = LOD_SLEEP;
+    }
+
+    l->full_steps += n;
+}
+
+void fleet_lod_step(FleetLod *l, double dt) {
+    l->dt = dt;
+
+    /* The due bucket first, so full vehicles turning coarse join it after;
+     * vehicles it promotes are added once the full rows have been stepped */
+    if (l->tick == 0)
+        step_all(l, dt);
+    else
+        step_coarse(l, dt * l->coarse_ticks);
+    step_full(l, dt);
+
+    for (int k = 0; k < l->num_promoted; k++)
+        full_add(l, l->promoted[k]);
+    l->num_promoted = 0;
+
+    l->tick++;
+}
+
+/* ---------------- OUTSIDE CHANGES ---------------- */
+
+void fleet_lod_wake(FleetLod *l, int i) {
+    if (l->level[i] == LOD_FULL)
+        return;
+    if (l->level[i] == LOD_COARSE) {
+        coarse_remove(l, i);
+        catch_up(l, i);
+    }
+    full_add(l, i);
+}
+
+void fleet_lod_set_input(FleetLod *l, int i, const DriverInput *d) {
+    FleetState *f = l->level[i] == LOD_FULL ? l->full : l->fleet;
+    int r = l->level[i] == LOD_FULL ? l->slot[i] : i;
+
+    if (f->throttle_in[r] == d->throttle && f->brake_in[r] == d->brake &&
+        f->steer_in[r] == d->steer && f->engine_on[r] == d->engine_on &&
+        f->reverse_in[r] == d->reverse)
+        return;
+
+    fleet_lod_wake(l, i);
+    f = l->full;
+    r = l->slot[i];
+    f->throttle_in[r] = d->throttle;
+    f->brake_in[r]    = d->brake;
+    f->steer_in[r]    = d->steer;
+    f->engine_on[r]   = d->engine_on;
+    f->reverse_in[r]  = d->reverse;
+}
+
+void fleet_lod_sync(FleetLod *l) {
+    for (int k = 0; k < l->full->count; k++)
+        row_copy(l->fleet, l->full_id[k], l->full, k);
+}
+
+/* ---------------- QUERIES ---------------- */
+
+void fleet_lod_position(const FleetLod *l, int i, double *x, double *y) {
+    if (l->level[i] == LOD_FULL) {
+        *x = l->full->x[l->slot[i]];
+        *y = l->full->y[l->slot[i]];
+        return;
+    }
+
+    const FleetState *f = l->fleet;
+    *x = f->x[i];
+    *y = f->y[i];
+    if (l->level[i] != LOD_COARSE)
+        return;
+
+    double t = (double)(l->tick - l->synced[i]) * l->dt;
+    double v = f->reverse[i] ? -f->speed[i] : f->speed[i];
+    *y += v * cos(f->heading[i]) * t;
+    *x += v * sin(f->heading[i]) * t;
+}
+
+int fleet_lod_count(const FleetLod *l, int level) {
+    int coarse = 0;
+    for (int b = 0; b < l->coarse_ticks; b++)
+        coarse += l->coarse_count[b];
+
+    if (level == LOD_FULL)
+        return l->full->count;
+    if (level == LOD_COARSE)
+        return coarse;
+    return l->fleet->count - l->full->count - coarse;
+}
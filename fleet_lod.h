@@ -0,0 +1,109 @@
+#ifndef FLEET_LOD_H
+#define FLEET_LOD_H
+
+#include "fleet_kernel.h"
+#include "protocol.h"
+
+/*
+ * Level-of-detail scheduling for a FleetState.
+ *
+ * Most of a large fleet is parked or cruising, so only some vehicles are
+ * worth a full-rate step:
+ *
+ *   LOD_SLEEP    at rest with no torque (engine off, no throttle, out of
+ *                gear or out of fuel).  A step would change nothing, so
+ *                the vehicle costs nothing until fleet_lod_set_input() or
+ *                fleet_lod_wake() moves it.
+ *
+ *   LOD_COARSE   driving straight (no steer, heading 0) at a steady speed.
+ *                Coarse vehicles are spread over coarse_ticks buckets and
+ *                each bucket is stepped once every coarse_ticks ticks with
+ *                a dt that many times longer.  In between, a vehicle's
+ *                state is as of its last step; fleet_lod_position() and
+ *                promotion to LOD_FULL catch it up at its current speed.
+ *
+ *   LOD_FULL     everything else, stepped every tick.
+ *
+ * Full vehicles are moved out of the fleet into a dense FleetState of
+ * their own and stepped there in place: gathering a few vehicles from
+ * every field array of a big fleet costs a cache line per field, which
+ * is as much memory traffic as stepping them all.  Coarse buckets are
+ * gathered, but only once every coarse_ticks ticks.  A tick therefore
+ * costs the full vehicles, 1 / coarse_ticks of the coarse ones, copies
+ * for the vehicles changing level, and a walk of one bitmap.
+ *
+ * Vehicles are re-classified after every step they get.  A coarse vehicle
+ * accelerates by less than LOD_STEADY_ACCEL, so neither the longer step
+ * nor the catch-up is more than about
+ * LOD_STEADY_ACCEL * (coarse_ticks * dt)^2 / 2 out from full-rate steps.
+ *
+ * The fleet's entries for full vehicles are stale until fleet_lod_sync().
+ * Inputs must go through fleet_lod_set_input(), and anything else that
+ * changes a vehicle from outside (a collision, the transmission's gear, a
+ * refuel) must be done after fleet_lod_sync() and followed by
+ * fleet_lod_wake().
+ */
+
+#define LOD_SLEEP   0
+#define LOD_COARSE  1
+#define LOD_FULL    2
+
+#define LOD_COARSE_TICKS 8      // default
+#define LOD_STEADY_ACCEL 0.02   // m/s^2, most a cruiser may accelerate
+#define LOD_BLOCK        1024   // coarse vehicles gathered per fleet_step() call
+
+typedef struct {
+    FleetState *fleet;          // not owned
+    int         coarse_ticks;
+    int         words;          // per bucket bitmap
+    unsigned    tick;           // fleet_lod_step() calls so far
+    double      dt;             // of the last step
+
+    unsigned char *level;       // LOD_*, per vehicle
+    unsigned      *synced;      // coarse: state is as of the start of this tick
+    int           *slot;        // full: row in `full`
+
+    /* Full vehicles, rows 0 .. full->count - 1 */
+    FleetState *full;
+    int        *full_id;
+    double     *full_prev;      // speeds before the step
+    int         full_capacity;
+
+    /* Coarse vehicles by bucket, one bit per vehicle, stepped at
+     * tick % coarse_ticks */
+    unsigned long long **coarse;
+    int                 *coarse_count;
+
+    int        *promoted;       // coarse -> full during a step
+    int         num_promoted;
+
+    FleetState *block;          // gathered coarse vehicles
+    double      prev_speed[LOD_BLOCK];
+    int         chunk[LOD_BLOCK];
+
+    unsigned long full_steps;   // vehicle-steps taken, by level
+    unsigned long coarse_steps;
+} FleetLod;
+
+/* Every vehicle is stepped at full rate by the first step, which sorts
+ * them into levels. */
+FleetLod *fleet_lod_create(FleetState *f, int coarse_ticks);
+void fleet_lod_free(FleetLod *l);
+
+void fleet_lod_step(FleetLod *l, double dt);
+
+/* New driver input for vehicle i; wakes it if the input changed. */
+void fleet_lod_set_input(FleetLod *l, int i, const DriverInput *d);
+
+/* Step vehicle i at full rate again from the next tick. */
+void fleet_lod_wake(FleetLod *l, int i);
+
+/* Copy the full vehicles back into the fleet. */
+void fleet_lod_sync(FleetLod *l);
+
+/* Vehicle i's position now, caught up if it is coarse. */
+void fleet_lod_position(const FleetLod *l, int i, double *x, double *y);
+
+int fleet_lod_count(const FleetLod *l, int level);
+
+#endif
@@ -1,103 +1,88 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <stdbool.h>
-#include <sys/socket.h>
-#include <arpa/inet.h>
 #include <math.h>
+#include <getopt.h>
+
+#include "protocol.h"
+#include "transport.h"
+#include "sim_plugin.h"
+#include "simlog.h"
+#include "session.h"
+
+
+int main(int argc, char **argv) {
+    int vehicle_id = 0;
+    int transport = TRANSPORT_TCP;
+    const char *host = "127.0.0.1";
+
+    static const struct option opts[] = {
+        { "vehicle",   required_argument, NULL, 'v' },
+        { "transport", required_argument, NULL, 't' },
+        { "host",      required_argument, NULL, 'H' },
+        { "log",       required_argument, NULL, 'L' },
+        { "session",   required_argument, NULL, 'i' },
+        { "cpus",      required_argument, NULL, 'C' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    simlog_init();
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "v:t:H:L:i:C:", opts, NULL)) != -1) {
+        if (opt == 'v') {
+            vehicle_id = atoi(optarg);
+        } else if (opt == 't' && transport_parse(optarg) >= 0) {
+            transport = transport_parse(optarg);
+        } else if (opt == 'H') {
+            host = optarg;
+        } else if (opt == 'L' && simlog_configure(optarg)) {
+            continue;
+        } else if (opt == 'i' && session_set(optarg)) {
+            continue;
+        } else if (opt == 'C' && session_pin(optarg)) {
+            continue;
+        } else {
+            fprintf(stderr, "Usage: %s [-v vehicle_id] [-t tcp|shm] [-H host] [-L log-spec]\n"
+                    "       [-i session] [-C cpus]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
 
-
-
-#define SERVER_PORT 9734
-#define CLIENT_FUEL 3
-
-#define FUEL_ENERGY_J_PER_L 34000000.0
-#define ENGINE_EFFICIENCY 0.30
-#define DT 0.016
-
-#define TANK_CAPACITY 100.0
-#define LOW_FUEL_THRESHOLD 10.0
-
-
-
-typedef struct {
-    int    client_id;
-    double throttle;
-    double speed;
-    int    rpm;
-    double power;
-    double current_fuel;
-} FuelIn;
-
-typedef struct {
-    int    client_id;
-    double updated_fuel;
-    int    no_fuel;
-    int    low_fuel;
-    int    full_fuel;
-} FuelOut;
-
-
-
-int main() {
-    int sock = socket(AF_INET, SOCK_STREAM, 0);
-
-    struct sockaddr_in addr = {0};
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(SERVER_PORT);
-    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
-
-    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
-        perror("[FUEL] connect failed");
+    int client_id = HANDSHAKE(CLIENT_FUEL, vehicle_id);
+    Transport *link = transport_connect(transport, host, client_id);
+    if (!link) {
+        fprintf(stderr, "[FUEL] connect failed\n");
         return 1;
     }
 
-    
-    int client_id = CLIENT_FUEL;
-    write(sock, &client_id, sizeof(client_id));
+    simlog(SIMLOG_INFO, "[FUEL] Connected to server");
 
-    printf("[FUEL] Connected to server\n");
+    /* Per-tick lines are debug; with changes=1 once per litre burnt */
+    SimLogKey litre_key = { 0 };
 
     while (1) {
         FuelIn in;
         FuelOut out;
 
-        ssize_t n = read(sock, &in, sizeof(in));
-        if (n <= 0) {
-            printf("[FUEL] Server disconnected\n");
+        if (!transport_recv(link, &in, sizeof(in))) {
+            simlog(SIMLOG_INFO, "[FUEL] Server disconnected");
             break;
         }
 
-       
-        double fuel_burn = 0.0;
-
-        if (in.power > 0.0 &&
-            ENGINE_EFFICIENCY > 0.0 &&
-            in.current_fuel > 0.0) {
-
-            fuel_burn =
-                (in.power * DT) /
-                (ENGINE_EFFICIENCY * FUEL_ENERGY_J_PER_L);
-        }
-
-        double updated_fuel = in.current_fuel - fuel_burn;
-        if (updated_fuel < 0.0)
-            updated_fuel = 0.0;
-
-        out.client_id = CLIENT_FUEL;
-        out.updated_fuel = updated_fuel;
-        out.no_fuel = (updated_fuel <= 0.0);
-        out.low_fuel = (updated_fuel > 0.0 &&
-                        updated_fuel <= LOW_FUEL_THRESHOLD);
-        out.full_fuel = (updated_fuel >= TANK_CAPACITY);
+        fuel_step(&in, &out);
 
-        write(sock, &out, sizeof(out));
+        transport_send(link, &out, sizeof(out));
 
-        printf(
-            "[FUEL] power=%.1fW burn=%.6fL fuel=%.3fL\n",
-            in.power, fuel_burn, updated_fuel
+        simlog_change(&litre_key, (long)out.updated_fuel, SIMLOG_DEBUG,
+            "[FUEL] power=%.1fW burn=%.6fL fuel=%.3fL",
+            in.power, in.current_fuel - out.updated_fuel, out.updated_fuel
         );
     }
 
-    close(sock);
+    transport_close(link);
+    simlog_shutdown();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,58 @@
+#include "sim_plugin.h"
+
+#define FUEL_ENERGY_J_PER_L 34000000.0
+#define ENGINE_EFFICIENCY 0.30
+
+#define TANK_CAPACITY 100.0
+#define LOW_FUEL_THRESHOLD 10.0
+
+const FuelParams *fuel_default_params() {
+    static const FuelParams defaults = { .engine_efficiency = ENGINE_EFFICIENCY };
+    return &defaults;
+}
+
+void fuel_burn(const FuelParams *p, const FuelIn *in, FuelOut *out) {
+    double burned = 0.0;
+
+    if (in->power > 0.0 &&
+        p->engine_efficiency > 0.0 &&
+        in->current_fuel > 0.0) {
+
+        burned =
+            (in->power * in->dt) /
+            (p->engine_efficiency * FUEL_ENERGY_J_PER_L);
+    }
+
+    double updated_fuel = in->current_fuel - burned;
+    if (updated_fuel < 0.0)
+        updated_fuel = 0.0;
+
+    out->client_id = CLIENT_FUEL;
+    out->updated_fuel = updated_fuel;
+    out->no_fuel = (updated_fuel <= 0.0);
+    out->low_fuel = (updated_fuel > 0.0 &&
+                     updated_fuel <= LOW_FUEL_THRESHOLD);
+    out->full_fuel = (updated_fuel >= TANK_CAPACITY);
+}
+
+void fuel_step(const FuelIn *in, FuelOut *out) {
+    fuel_burn(fuel_default_params(), in, out);
+}
+
+/* ---------------- PLUGIN DESCRIPTOR ---------------- */
+
+static void step(void *state, const void *in, void *out) {
+    (void)state;
+    fuel_step(in, out);
+}
+
+const SimPlugin fuel_plugin = {
+    .abi        = SIM_PLUGIN_ABI,
+    .type       = CLIENT_FUEL,
+    .name       = "fuel",
+    .state_size = 0,
+    .in_size    = sizeof(FuelIn),
+    .out_size   = sizeof(FuelOut),
+    .init       = NULL,
+    .step       = step,
+};
@@ -0,0 +1,78 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdatomic.h>
+
+/*
+ * Log-bucketed latency histogram, safe to place in shared memory.
+ *
+ * Four buckets per power of two (~20% resolution) from 1 ns up to the
+ * full 64-bit range.  There is exactly one writer per histogram, so
+ * recording is plain relaxed loads and stores - no locked instructions -
+ * and readers may see a sample in count before it shows in a bucket.
+ */
+
+#define HIST_SUB_BITS 2
+#define HIST_SUB      (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS  256
+
+typedef struct {
+    atomic_ulong count;
+    atomic_ulong sum_ns;
+    atomic_ulong max_ns;
+    atomic_ulong buckets[HIST_BUCKETS];
+} LatencyHist;
+
+static inline unsigned hist_bucket(unsigned long ns) {
+    if (ns < HIST_SUB)
+        return (unsigned)ns;
+
+    unsigned msb = 63 - (unsigned)__builtin_clzl(ns);
+    unsigned sub = (unsigned)(ns >> (msb - HIST_SUB_BITS)) & (HIST_SUB - 1);
+    return HIST_SUB + (msb - HIST_SUB_BITS) * HIST_SUB + sub;
+}
+
+/* Smallest value that lands in bucket i. */
+static inline unsigned long hist_bucket_floor(unsigned i) {
+    if (i < HIST_SUB)
+        return i;
+
+    unsigned msb = (i - HIST_SUB) / HIST_SUB + HIST_SUB_BITS;
+    unsigned sub = (i - HIST_SUB) % HIST_SUB;
+    return (unsigned long)(HIST_SUB + sub) << (msb - HIST_SUB_BITS);
+}
+
+static inline void hist_add(atomic_ulong *a, unsigned long v) {
+    atomic_store_explicit(a, atomic_load_explicit(a, memory_order_relaxed) + v,
+                          memory_order_relaxed);
+}
+
+static inline void hist_record(LatencyHist *h, unsigned long ns) {
+    hist_add(&h->buckets[hist_bucket(ns)], 1);
+    hist_add(&h->sum_ns, ns);
+    hist_add(&h->count, 1);
+
+    if (ns > atomic_load_explicit(&h->max_ns, memory_order_relaxed))
+        atomic_store_explicit(&h->max_ns, ns, memory_order_relaxed);
+}
+
+/* Value at quantile q (0..1): the floor of the bucket holding it. */
+static inline unsigned long hist_quantile(const LatencyHist *h, double q) {
+    unsigned long total = 0;
+    for (unsigned i = 0; i < HIST_BUCKETS; i++)
+        total += atomic_load_explicit(&h->buckets[i], memory_order_relaxed);
+    if (total == 0)
+        return 0;
+
+    unsigned long rank = (unsigned long)(q * (double)(total - 1)) + 1;
+    unsigned long seen = 0;
+
+    for (unsigned i = 0; i < HIST_BUCKETS; i++) {
+        seen += atomic_load_explicit(&h->buckets[i], memory_order_relaxed);
+        if (seen >= rank)
+            return hist_bucket_floor(i);
+    }
+    return atomic_load_explicit(&h->max_ns, memory_order_relaxed);
+}
+
+#endif
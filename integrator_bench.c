@@ -0,0 +1,191 @@
+/*
+ * Integrator accuracy report.
+ *
+ * Drives a script through the server's sequential tick (sim_tick) with
+ * each integrator at several tick rates and substep counts, and compares
+ * the trajectory with a reference run at 1 kHz with RK4.  Positions and
+ * speeds are compared every SAMPLE_S of sim time, which every tick period
+ * below divides.
+ *
+ *     ./integrator_bench [-S script] [-m model] [-t seconds]
+ *
+ * The last column is the position error relative to Euler at 62.5 Hz
+ * (the server's default rate): at or below 1 a configuration is as
+ * accurate as the default while ticking less often.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <getopt.h>
+
+#include "common.h"
+#include "sim_plugin.h"
+#include "sim_tick.h"
+#include "tick_sched.h"
+
+#define TANK_FULL 100.0
+#define SAMPLE_S  0.4
+#define REF_DT    0.001
+#define MAX_SAMPLES 100000
+
+typedef struct {
+    int    integrator;
+    double dt;
+    int    substeps;
+} Config;
+
+static const char *integrator_name[] = { "euler", "rk4", "analytic" };
+
+static const double rates_dt[] = { 0.016, 0.05, 0.1 };     // 62.5, 20, 10 Hz
+static const int    substep_counts[] = { 1, 2, 4, 8 };
+
+typedef struct {
+    double x[MAX_SAMPLES];
+    double y[MAX_SAMPLES];
+    double speed[MAX_SAMPLES];
+    int    count;
+    double ns;              // wall time of the run
+} Trajectory;
+
+static void run_drive(const DriveScript *s, const VehicleModel *m, const Config *cfg,
+                      double seconds, Trajectory *out) {
+    EngineState es;
+    engine_init(&es);
+    if (m)
+        es.model = m;
+    es.integrator = cfg->integrator;
+    es.substeps = cfg->substeps;
+
+    SimStages stages = {
+        .step  = { engine_plugin.step, transmission_plugin.step, fuel_plugin.step },
+        .state = { &es, NULL, NULL },
+    };
+
+    DriveScript script = *s;
+    script.cursor = 0;
+
+    CarSnapshot car;
+    memset(&car, 0, sizeof(car));
+    car.fuel = TANK_FULL;
+    double last_shift = NEVER_SHIFTED;
+
+    long ticks = lround(seconds / cfg->dt);
+    long per_sample = lround(SAMPLE_S / cfg->dt);
+    out->count = 0;
+
+    long long t0 = sched_now_ns();
+    for (long tick = 0; tick <= ticks; tick++) {
+        if (tick % per_sample == 0 && out->count < MAX_SAMPLES) {
+            out->x[out->count] = car.x;
+            out->y[out->count] = car.y;
+            out->speed[out->count] = car.speed;
+            out->count++;
+        }
+        if (tick == ticks)
+            break;
+
+        /* Tick times from the tick count, so every rate hits the samples */
+        double sim_time = tick * cfg->dt;
+        drive_script_at(&script, sim_time, &es.driver);
+
+        sim_tick(&stages, &car, &last_shift, sim_time, cfg->dt);
+    }
+    out->ns = (double)(sched_now_ns() - t0);
+}
+
+typedef struct {
+    double pos_max, pos_final, speed_max;
+} Error;
+
+static Error compare(const Trajectory *a, const Trajectory *ref) {
+    Error e = {0};
+    int n = a->count < ref->count ? a->count : ref->count;
+    for (int i = 0; i < n; i++) {
+        double d = hypot(a->x[i] - ref->x[i], a->y[i] - ref->y[i]);
+        e.pos_max = fmax(e.pos_max, d);
+        e.speed_max = fmax(e.speed_max, fabs(a->speed[i] - ref->speed[i]));
+        e.pos_final = d;
+    }
+    return e;
+}
+
+int main(int argc, char **argv) {
+    const char *script_path = "sample_drive.txt";
+    const char *model_path = NULL;
+    double seconds = 0.0;
+
+    static const struct option opts[] = {
+        { "script",  required_argument, NULL, 'S' },
+        { "model",   required_argument, NULL, 'm' },
+        { "seconds", required_argument, NULL, 't' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    int c;
+    while ((c = getopt_long(argc, argv, "S:m:t:", opts, NULL)) != -1) {
+        if (c == 'S') {
+            script_path = optarg;
+        } else if (c == 'm') {
+            model_path = optarg;
+        } else if (c == 't') {
+            seconds = atof(optarg);
+        } else {
+            fprintf(stderr, "Usage: %s [-S script] [-m model] [-t seconds]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    DriveScript *script = drive_script_load(script_path);
+    if (!script)
+        return 1;
+    VehicleModel *model = NULL;
+    if (model_path && !(model = vehicle_model_load(model_path)))
+        return 1;
+    if (seconds <= 0.0)
+        seconds = drive_script_end(script) + 2.0;
+    if (seconds / SAMPLE_S >= MAX_SAMPLES) {
+        fprintf(stderr, "--seconds must be under %.0f\n", MAX_SAMPLES * SAMPLE_S);
+        return 1;
+    }
+
+    Trajectory *ref = malloc(sizeof(*ref));
+    Trajectory *same = malloc(sizeof(*same));
+    Trajectory *run = malloc(sizeof(*run));
+    Config rc = { INTEGRATOR_RK4, REF_DT, 1 };
+    run_drive(script, model, &rc, seconds, ref);
+
+    Config base = { INTEGRATOR_EULER, 0.016, 1 };
+    run_drive(script, model, &base, seconds, run);
+    double base_err = compare(run, ref).pos_max;
+
+    printf("%s, %.1f s, against RK4 at %.0f Hz; errors sampled every %.1f s\n",
+           script_path, seconds, 1.0 / REF_DT, SAMPLE_S);
+    printf("%-9s %7s %5s %12s %12s %12s %12s %14s %8s\n", "integrator", "rate_hz", "sub",
+           "integ_pos_m", "max_pos_m", "final_pos_m", "max_speed", "us_per_sim_s", "vs_euler");
+
+    for (int i = 0; i < 3; i++) {
+        for (size_t r = 0; r < sizeof(rates_dt) / sizeof(rates_dt[0]); r++) {
+            Config sc = { INTEGRATOR_RK4, rates_dt[r], (int)lround(rates_dt[r] / REF_DT) };
+            run_drive(script, model, &sc, seconds, same);
+            for (size_t k = 0; k < sizeof(substep_counts) / sizeof(substep_counts[0]); k++) {
+                Config cfg = { i, rates_dt[r], substep_counts[k] };
+                run_drive(script, model, &cfg, seconds, run);
+                Error e = compare(run, ref);
+                Error ie = compare(run, same);
+                printf("%-10s %7.1f %5d %12.4g %12.4g %12.4g %12.4g %14.2f %8.2f\n",
+                       integrator_name[i], 1.0 / cfg.dt, cfg.substeps, ie.pos_max, e.pos_max,
+                       e.pos_final, e.speed_max, run->ns / 1e3 / seconds,
+                       base_err > 0.0 ? e.pos_max / base_err : 0.0);
+            }
+        }
+    }
+
+    free(ref);
+    free(same);
+    free(run);
+    vehicle_model_free(model);
+    drive_script_free(script);
+    return 0;
+}
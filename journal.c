@@ -0,0 +1,104 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "journal.h"
+
+#define JOURNAL_BUFFER (1 << 20)
+
+/* Same bits, so NaNs and signed zeros count too. */
+#define SAME(a, b) (memcmp(&(a), &(b), sizeof(a)) == 0)
+
+/* ---------------- FILES ---------------- */
+
+Journal *journal_create(const char *path, const JournalHeader *settings) {
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        perror(path);
+        return NULL;
+    }
+
+    Journal *j = calloc(1, sizeof(Journal));
+    j->f = f;
+    setvbuf(f, NULL, _IOFBF, JOURNAL_BUFFER);
+
+    j->header = *settings;
+    memcpy(j->header.magic, JOURNAL_MAGIC, sizeof(j->header.magic));
+    j->header.version     = JOURNAL_VERSION;
+    j->header.record_size = sizeof(JournalRecord);
+    fwrite(&j->header, sizeof(j->header), 1, f);
+    return j;
+}
+
+Journal *journal_open(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return NULL;
+    }
+
+    Journal *j = calloc(1, sizeof(Journal));
+    j->f = f;
+    setvbuf(f, NULL, _IOFBF, JOURNAL_BUFFER);
+
+    if (fread(&j->header, sizeof(j->header), 1, f) != 1 ||
+        memcmp(j->header.magic, JOURNAL_MAGIC, sizeof(j->header.magic)) != 0 ||
+        j->header.version != JOURNAL_VERSION ||
+        j->header.record_size != sizeof(JournalRecord)) {
+        fprintf(stderr, "%s: not a version %d journal from this build\n",
+                path, JOURNAL_VERSION);
+        journal_close(j);
+        return NULL;
+    }
+    return j;
+}
+
+void journal_close(Journal *j) {
+    if (!j)
+        return;
+    if (fclose(j->f) != 0)
+        perror("journal");
+    free(j);
+}
+
+void journal_write(Journal *j, const JournalRecord *r) {
+    fwrite(r, sizeof(*r), 1, j->f);
+    j->records++;
+}
+
+bool journal_read(Journal *j, JournalRecord *r) {
+    if (fread(r, sizeof(*r), 1, j->f) != 1)
+        return false;
+    j->records++;
+    return true;
+}
+
+/* ---------------- COMPARISON ---------------- */
+
+bool engine_out_same(const EngineStateOut *a, const EngineStateOut *b) {
+    return SAME(a->throttle, b->throttle) && SAME(a->brake, b->brake) &&
+           SAME(a->steer, b->steer) && SAME(a->reverse, b->reverse) &&
+           SAME(a->speed, b->speed) && SAME(a->heading, b->heading) &&
+           SAME(a->x, b->x) && SAME(a->y, b->y) &&
+           SAME(a->rpm, b->rpm) && SAME(a->power, b->power) &&
+           SAME(a->torque, b->torque) && SAME(a->num_gears, b->num_gears);
+}
+
+bool transmission_out_same(const TransmissionOut *a, const TransmissionOut *b) {
+    return SAME(a->client_id, b->client_id) && SAME(a->updated_gear, b->updated_gear) &&
+           SAME(a->last_shift_time, b->last_shift_time);
+}
+
+bool fuel_out_same(const FuelOut *a, const FuelOut *b) {
+    return SAME(a->client_id, b->client_id) && SAME(a->updated_fuel, b->updated_fuel) &&
+           SAME(a->no_fuel, b->no_fuel) && SAME(a->low_fuel, b->low_fuel) &&
+           SAME(a->full_fuel, b->full_fuel);
+}
+
+bool car_same(const CarSnapshot *a, const CarSnapshot *b) {
+    return SAME(a->throttle, b->throttle) && SAME(a->brake, b->brake) &&
+           SAME(a->steer, b->steer) && SAME(a->reverse, b->reverse) &&
+           SAME(a->speed, b->speed) && SAME(a->gear, b->gear) &&
+           SAME(a->heading, b->heading) && SAME(a->x, b->x) && SAME(a->y, b->y) &&
+           SAME(a->rpm, b->rpm) && SAME(a->power, b->power) &&
+           SAME(a->torque, b->torque) && SAME(a->fuel, b->fuel);
+}
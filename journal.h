@@ -0,0 +1,86 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "common.h"
+#include "protocol.h"
+
+/*
+ * Input journal: everything that went into each tick, enough to re-run it.
+ *
+ * The file is a JournalHeader followed by fixed-size JournalRecords in the
+ * order the server produced them.  A START record gives a vehicle's state
+ * and clock when it became active; each TICK record holds the requests
+ * the server sent (sim_time and dt included), the replies it applied -
+ * the engine reply carries the driver input it ran on - and the car state
+ * the tick ended in.  Only stages in `stages` ran that tick.
+ *
+ * server --replay runs the step plugins on the recorded requests and
+ * compares their replies and the resulting state field by field.  Struct
+ * padding is never compared: socket clients leave it undefined.  The
+ * header also records an in-process engine's integrator and a hash of its
+ * vehicle model, which replay applies and checks.
+ */
+
+#define JOURNAL_MAGIC   "CARJNL\r\n"
+#define JOURNAL_VERSION 3
+
+#define JOURNAL_START 0
+#define JOURNAL_TICK  1
+
+typedef struct {
+    char     magic[8];      // JOURNAL_MAGIC
+    uint32_t version;       // JOURNAL_VERSION
+    uint32_t record_size;   // sizeof(JournalRecord)
+    uint32_t tick_mode;     // server's TICK_*
+    uint32_t engine_known;  // 1 if the engine ran in-process: fields below set
+    double   dt;            // tick period
+
+    uint32_t integrator;    // engine's INTEGRATOR_*
+    uint32_t substeps;
+    uint64_t model_hash;    // vehicle_model_hash() of the engine's model
+    char     model_name[32];
+} JournalHeader;
+
+typedef struct {
+    uint32_t kind;          // JOURNAL_*
+    uint32_t vehicle;
+    uint64_t tick;          // vehicle's tick number
+    double   sim_time;      // START: vehicle clock; TICK: at tick start
+    uint32_t stages;        // bit (type - 1) per stage that ran
+
+    EngineStateIn   engine_in;
+    EngineStateOut  engine_out;
+    TransmissionIn  transmission_in;
+    TransmissionOut transmission_out;
+    FuelIn          fuel_in;
+    FuelOut         fuel_out;
+
+    CarSnapshot car;        // START: initial state; TICK: state after it
+} JournalRecord;
+
+typedef struct {
+    FILE         *f;
+    JournalHeader header;
+    uint64_t      records;
+} Journal;
+
+/* Writes `settings` (all but magic, version and record_size) as the
+ * header.  NULL (with a message) on failure. */
+Journal *journal_create(const char *path, const JournalHeader *settings);
+Journal *journal_open(const char *path);
+void journal_close(Journal *j);
+
+void journal_write(Journal *j, const JournalRecord *r);
+bool journal_read(Journal *j, JournalRecord *r);   // false at the end
+
+/* Field-by-field, bit-exact comparisons (padding ignored). */
+bool engine_out_same(const EngineStateOut *a, const EngineStateOut *b);
+bool transmission_out_same(const TransmissionOut *a, const TransmissionOut *b);
+bool fuel_out_same(const FuelOut *a, const FuelOut *b);
+bool car_same(const CarSnapshot *a, const CarSnapshot *b);
+
+#endif
@@ -0,0 +1,200 @@
+/*
+ * Level-of-detail benchmark.
+ *
+ * A fleet that is mostly parked, partly cruising at a steady speed and a
+ * little manoeuvring, with a few drivers changing their inputs every tick
+ * (parking, setting off, turning).  The same run is stepped with
+ * fleet_step() over every vehicle and with fleet_lod_step(), and the
+ * report compares time per tick and where the vehicles end up.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <getopt.h>
+
+#include "fleet_lod.h"
+#include "tick_sched.h"
+
+#define DT 0.016
+#define WORLD 10000.0           // m
+#define CRUISE_GEAR 2
+#define CRUISE_THROTTLE 0.6
+
+static unsigned long long rng_state = 0x9e3779b97f4a7c15ULL;
+
+static double rnd() {
+    rng_state = rng_state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (rng_state >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* Speed a cruiser settles at, found by driving one vehicle until it does */
+static double cruise_speed(const VehicleModel *m) {
+    FleetState *f = fleet_alloc(1);
+    f->model = m;
+    f->engine_on[0] = 1;
+    f->throttle_in[0] = CRUISE_THROTTLE;
+    f->gear[0] = CRUISE_GEAR;
+    f->fuel[0] = 50.0;
+    f->speed[0] = 10.0;
+
+    for (int k = 0; k < 1000000; k++) {
+        double prev = f->speed[0];
+        fleet_step(f, DT);
+        if (k > 100 && fabs(f->speed[0] - prev) < 1e-12)
+            break;
+    }
+    double v = f->speed[0];
+    fleet_free(f);
+    return v;
+}
+
+static void fill_fleet(FleetState *f, double parked, double cruising, double v_cruise) {
+    rng_state = 0x9e3779b97f4a7c15ULL;
+
+    for (int i = 0; i < f->count; i++) {
+        double kind = rnd();
+        f->x[i]    = rnd() * WORLD;
+        f->y[i]    = rnd() * WORLD;
+        f->fuel[i] = 50.0;
+        f->gear[i] = CRUISE_GEAR;
+
+        if (kind < parked) {
+            f->engine_on[i] = 0;
+        } else if (kind < parked + cruising) {
+            f->engine_on[i]   = 1;
+            f->throttle_in[i] = CRUISE_THROTTLE;
+            f->speed[i]       = v_cruise;
+        } else {
+            f->engine_on[i]   = 1;
+            f->gear[i]        = 3;
+            f->throttle_in[i] = rnd();
+            f->steer_in[i]    = rnd() * 2.0 - 1.0;
+            f->speed[i]       = rnd() * 20.0;
+            f->heading[i]     = (rnd() * 2.0 - 1.0) * 3.1;
+        }
+    }
+}
+
+/* A driver parks, sets off to cruise, changes speed, or turns */
+static void random_input(DriverInput *d) {
+    double kind = rnd();
+    *d = (DriverInput){ 0 };
+
+    if (kind < 0.3) {
+        d->brake = 1.0;
+    } else if (kind < 0.7) {
+        d->engine_on = true;
+        d->throttle = CRUISE_THROTTLE;
+    } else if (kind < 0.9) {
+        d->engine_on = true;
+        d->throttle = rnd();
+    } else {
+        d->engine_on = true;
+        d->throttle = rnd();
+        d->steer = rnd() * 2.0 - 1.0;
+    }
+}
+
+int main(int argc, char **argv) {
+    int count = 200000;
+    int steps = 1875;
+    int coarse_ticks = LOD_COARSE_TICKS;
+    int events = -1;
+    double parked = 0.7, cruising = 0.25;
+
+    static const struct option opts[] = {
+        { "vehicles", required_argument, NULL, 'n' },
+        { "steps",    required_argument, NULL, 's' },
+        { "coarse",   required_argument, NULL, 'k' },
+        { "events",   required_argument, NULL, 'e' },
+        { "parked",   required_argument, NULL, 'p' },
+        { "cruising", required_argument, NULL, 'c' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    int c;
+    while ((c = getopt_long(argc, argv, "n:s:k:e:p:c:", opts, NULL)) != -1) {
+        if (c == 'n') {
+            count = atoi(optarg);
+        } else if (c == 's') {
+            steps = atoi(optarg);
+        } else if (c == 'k') {
+            coarse_ticks = atoi(optarg);
+        } else if (c == 'e') {
+            events = atoi(optarg);
+        } else if (c == 'p') {
+            parked = atof(optarg);
+        } else if (c == 'c') {
+            cruising = atof(optarg);
+        } else {
+            fprintf(stderr, "Usage: %s [-n vehicles] [-s steps] [-k coarse_ticks] "
+                            "[-e events_per_tick] [-p parked] [-c cruising]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (events < 0)
+        events = count / 20000;     // each driver changes something every ~5 minutes
+
+    FleetState *ref = fleet_alloc(count);
+    FleetState *fleet = fleet_alloc(count);
+    double v_cruise = cruise_speed(ref->model);
+    fill_fleet(ref, parked, cruising, v_cruise);
+    fill_fleet(fleet, parked, cruising, v_cruise);
+
+    FleetLod *lod = fleet_lod_create(fleet, coarse_ticks);
+
+    long long t_ref = 0, t_lod = 0;
+    rng_state = 0x2545f4914f6cdd1dULL;
+
+    for (int s = 0; s < steps; s++) {
+        for (int e = 0; e < events; e++) {
+            int i = (int)(rnd() * count);
+            DriverInput d;
+            random_input(&d);
+            ref->throttle_in[i] = d.throttle;
+            ref->brake_in[i]    = d.brake;
+            ref->steer_in[i]    = d.steer;
+            ref->engine_on[i]   = d.engine_on;
+            ref->reverse_in[i]  = d.reverse;
+            fleet_lod_set_input(lod, i, &d);
+        }
+
+        long long t0 = sched_now_ns();
+        fleet_step(ref, DT);
+        long long t1 = sched_now_ns();
+        fleet_lod_step(lod, DT);
+        long long t2 = sched_now_ns();
+        t_ref += t1 - t0;
+        t_lod += t2 - t1;
+    }
+
+    fleet_lod_sync(lod);
+    double pos_max = 0.0, pos_sum = 0.0, speed_max = 0.0;
+    for (int i = 0; i < count; i++) {
+        double x, y;
+        fleet_lod_position(lod, i, &x, &y);
+        double d = hypot(x - ref->x[i], y - ref->y[i]);
+        pos_max = fmax(pos_max, d);
+        pos_sum += d;
+        speed_max = fmax(speed_max, fabs(fleet->speed[i] - ref->speed[i]));
+    }
+
+    printf("%d vehicles x %d steps (%.0f s), %d input changes per tick, cruise %.2f m/s\n",
+           count, steps, steps * DT, events, v_cruise);
+    printf("  at the end: %d full, %d coarse (1 step in %d), %d asleep\n",
+           fleet_lod_count(lod, LOD_FULL), fleet_lod_count(lod, LOD_COARSE), coarse_ticks,
+           fleet_lod_count(lod, LOD_SLEEP));
+    printf("  vehicle-steps per tick: %.0f full + %.0f coarse\n",
+           (double)lod->full_steps / steps, (double)lod->coarse_steps / steps);
+    printf("  every vehicle: %8.1f us per tick\n", t_ref / 1e3 / steps);
+    printf("  LOD          : %8.1f us per tick  (%.1fx)\n", t_lod / 1e3 / steps,
+           (double)t_ref / t_lod);
+    printf("  difference from stepping every vehicle: position max %.3g m (mean %.3g), "
+           "speed max %.3g m/s\n", pos_max, pos_sum / count, speed_max);
+
+    fleet_lod_free(lod);
+    fleet_free(ref);
+    fleet_free(fleet);
+    return 0;
+}
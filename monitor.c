@@ -1,12 +1,16 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <math.h>
 #include <fcntl.h>
 #include <sys/mman.h>
 #include <ncurses.h>
 #include <time.h>
+#include <getopt.h>
 
 #include "common.h"
+#include "session.h"
+#include "view.h"
 
 
 
@@ -21,25 +25,163 @@ double now_seconds() {
     return ts.tv_sec + ts.tv_nsec * 1e-9;
 }
 
+/* One histogram row of the tick breakdown, in microseconds. */
+void show_hist(int row, const char *name, const LatencyHist *h) {
+    mvprintw(row, 2, "%-12s %10lu %9.1f %9.1f %9.1f %9.1f", name,
+             atomic_load(&h->count),
+             hist_quantile(h, 0.50) / 1e3,
+             hist_quantile(h, 0.99) / 1e3,
+             hist_quantile(h, 0.999) / 1e3,
+             atomic_load(&h->max_ns) / 1e3);
+}
+
+
+/*
+ * Fleet view: subscribe to the vehicles passing the filter and list them.
+ * Arrow keys pan a region by a quarter of its size, +/- zoom, q quits.
+ */
+int fleet_view(SimShared *sim, ViewFilter *f) {
+    int slot = view_subscribe(sim, f);
+    if (slot < 0)
+        return 1;
+
+    static ViewFrame frame;
+    unsigned last = sim->views[slot].frame;
+    frame.count = 0;
+
+    initscr();
+    cbreak();
+    noecho();
+    curs_set(0);
+    keypad(stdscr, TRUE);
+    nodelay(stdscr, TRUE);
+
+    bool quit = false;
+    while (!quit) {
+        CarSnapshot first;
+        car_read(&sim->cars[0], &first);
+        if (first.shutdown)
+            break;
+
+        if (view_read(sim, slot, last, &frame))
+            last = frame.frame;
+
+        erase();
+        mvprintw(1, 2, "CAR SIMULATION MONITOR - fleet view (slot %d, %s)", slot,
+                 f->rate > 0.0 ? "rate-limited" : "every tick");
+        if (f->flags & VIEW_REGION)
+            mvprintw(2, 2, "Area       : (%.1f, %.1f) .. (%.1f, %.1f)", f->x0, f->y0, f->x1, f->y1);
+        if (f->flags & VIEW_IDS)
+            mvprintw(3, 2, "Ids        : %d selected", f->num_ids);
+        mvprintw(4, 2, "Frame %u at t = %.2f s: %d vehicle(s)", frame.frame, frame.sim_time,
+                 frame.count);
+
+        mvprintw(6, 2, "%6s %10s %10s %8s %5s %7s %8s", "id", "x", "y", "km/h", "gear",
+                 "rpm", "fuel L");
+        int rows = LINES - 9;
+        for (int i = 0; i < frame.count && i < rows; i++) {
+            CarSnapshot c;
+            car_read(&sim->cars[frame.match[i]], &c);
+            mvprintw(7 + i, 2, "%6d %10.2f %10.2f %8.1f %5d %7.0f %8.2f", frame.match[i],
+                     c.x, c.y, c.speed * 3.6, c.gear, c.rpm, c.fuel);
+        }
+        if (frame.count > rows && rows > 0)
+            mvprintw(7 + rows, 2, "... and %d more", frame.count - rows);
+        mvprintw(LINES - 1, 2, "Keys: arrows pan, +/- zoom, Q quit");
+        refresh();
 
-int main() {
+        int ch;
+        while ((ch = getch()) != ERR) {
+            double w = f->x1 - f->x0, h = f->y1 - f->y0;
+            double dx = 0.0, dy = 0.0, zoom = 1.0;
+            if (ch == 'q' || ch == 'Q')
+                quit = true;
+            else if (ch == KEY_LEFT)  dx = -w / 4;
+            else if (ch == KEY_RIGHT) dx =  w / 4;
+            else if (ch == KEY_UP)    dy =  h / 4;
+            else if (ch == KEY_DOWN)  dy = -h / 4;
+            else if (ch == '+')       zoom = 0.5;
+            else if (ch == '-')       zoom = 2.0;
+
+            if (!(f->flags & VIEW_REGION) || (dx == 0.0 && dy == 0.0 && zoom == 1.0))
+                continue;
+            double cx = (f->x0 + f->x1) / 2 + dx, cy = (f->y0 + f->y1) / 2 + dy;
+            f->x0 = cx - w * zoom / 2;
+            f->x1 = cx + w * zoom / 2;
+            f->y0 = cy - h * zoom / 2;
+            f->y1 = cy + h * zoom / 2;
+            view_set_filter(sim, slot, f);
+        }
+        usleep(50000);
+    }
+
+    endwin();
+    view_unsubscribe(sim, slot);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    int vehicle_id = 0;
+    ViewFilter filter = { 0 };
+    bool fleet = false;
+
+    static const struct option opts[] = {
+        { "vehicle", required_argument, NULL, 'v' },
+        { "session", required_argument, NULL, 'i' },
+        { "area",    required_argument, NULL, 'a' },
+        { "ids",     required_argument, NULL, 'I' },
+        { "rate",    required_argument, NULL, 'f' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "v:i:a:I:f:", opts, NULL)) != -1) {
+        if (opt == 'v') {
+            vehicle_id = atoi(optarg);
+        } else if (opt == 'i' && session_set(optarg)) {
+            continue;
+        } else if (opt == 'a' && view_parse_area(&filter, optarg)) {
+            fleet = true;
+        } else if (opt == 'I' && view_parse_ids(&filter, optarg)) {
+            fleet = true;
+        } else if (opt == 'f' && atof(optarg) > 0.0) {
+            filter.rate = atof(optarg);
+            fleet = true;
+        } else {
+            fprintf(stderr, "Usage: %s [-v vehicle_id] [-i session]\n"
+                            "       %s [-a x0,y0,x1,y1] [-I id,id,...] [-f hz] [-i session]\n",
+                    argv[0], argv[0]);
+            return 1;
+        }
+    }
+
+    if (vehicle_id < 0 || vehicle_id >= MAX_VEHICLES) {
+        fprintf(stderr, "vehicle id must be 0..%d\n", MAX_VEHICLES - 1);
+        return 1;
+    }
    
-    int shm_fd = shm_open(SHM_NAME, O_RDONLY, 0666);
+    /* A fleet view writes its subscription into the segment */
+    int shm_fd = shm_open(session_shm_name(), fleet ? O_RDWR : O_RDONLY, 0666);
     if (shm_fd < 0) {
         perror("shm_open");
         return 1;
     }
 
-    CarShared *car = mmap(NULL, sizeof(CarShared),
-                          PROT_READ,
+    SimShared *sim = mmap(NULL, sizeof(SimShared),
+                          fleet ? PROT_READ | PROT_WRITE : PROT_READ,
                           MAP_SHARED,
                           shm_fd, 0);
 
-    if (car == MAP_FAILED) {
+    if (sim == MAP_FAILED) {
         perror("mmap");
         return 1;
     }
 
+    if (fleet)
+        return fleet_view(sim, &filter);
+
+    const CarShared *car = &sim->cars[vehicle_id];
+
     /* ---- ncurses init ---- */
     initscr();
     cbreak();
@@ -53,24 +195,27 @@ int main() {
     double last_time = start_time;
 
     while (1) {
-        /* ---- snapshot (NO MUTEX) ---- */
-        bool shutdown = car->shutdown;
+        /* ---- snapshot (seqlock, consistent tick) ---- */
+        CarSnapshot snap;
+        car_read(car, &snap);
 
-        double speed = car->speed;
-        int gear = car->gear;
-        double fuel = car->fuel;
-        double x = car->x;
-        double y = car->y;
-        double heading = car->heading;
+        bool shutdown = snap.shutdown;
 
-        double throttle = car->throttle;
-        double brake = car->brake;
-        double steer = car->steer;
-        bool reverse = car->reverse;
+        double speed = snap.speed;
+        int gear = snap.gear;
+        double fuel = snap.fuel;
+        double x = snap.x;
+        double y = snap.y;
+        double heading = snap.heading;
 
-        double rpm = car->rpm;
-        double power = car->power;
-        double torque = car->torque;
+        double throttle = snap.throttle;
+        double brake = snap.brake;
+        double steer = snap.steer;
+        bool reverse = snap.reverse;
+
+        double rpm = snap.rpm;
+        double power = snap.power;
+        double torque = snap.torque;
 
         if (shutdown)
             break;
@@ -97,7 +242,7 @@ int main() {
         /* ---- UI ---- */
         erase();
 
-        mvprintw(1, 2,  "CAR SIMULATION MONITOR");
+        mvprintw(1, 2,  "CAR SIMULATION MONITOR - vehicle %d", vehicle_id);
         mvprintw(2, 2,  "----------------------");
 
         mvprintw(4, 2,  "Speed      : %6.2f m/s  (%6.2f km/h)", speed, speed_kmph);
@@ -137,6 +282,28 @@ int main() {
             attroff(A_BOLD);
         }
 
+        /* ---- server tick scheduler ---- */
+        const SchedStats *st = &sim->sched;
+        mvprintw(26, 2, "Tick       : %.1f Hz  late p50 %.0f us  p99 %.0f us  max %.0f us",
+                 st->period_ns > 0 ? 1e9 / st->period_ns : 0.0,
+                 hist_quantile(&st->lateness, 0.50) / 1e3,
+                 hist_quantile(&st->lateness, 0.99) / 1e3,
+                 atomic_load(&st->lateness.max_ns) / 1e3);
+        mvprintw(27, 2, "             ticks %lu  skipped %lu",
+                 atomic_load(&st->ticks), atomic_load(&st->skipped));
+
+        /* ---- where tick time goes (all vehicles) ---- */
+        const TickStats *ts = &sim->stats;
+        mvprintw(29, 2, "%-12s %10s %9s %9s %9s %9s",
+                 "Latency us", "count", "p50", "p99", "p99.9", "max");
+        show_hist(30, "engine",       &ts->stage[0]);
+        show_hist(31, "transmission", &ts->stage[1]);
+        show_hist(32, "fuel",         &ts->stage[2]);
+        show_hist(33, "whole tick",   &ts->tick);
+        show_hist(34, "server wait",  &ts->wait);
+        mvprintw(35, 2, "             overruns %lu  stale replies %lu",
+                 atomic_load(&ts->overruns), atomic_load(&ts->stale));
+
         refresh();
         usleep(100000);
     }
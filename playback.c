@@ -0,0 +1,197 @@
+/*
+ * Play back a drive recording (see recording.h) into the shared memory
+ * segment, so monitor.c shows it exactly as it would a live run.  Do not
+ * run it alongside a server: both publish into the same CarShared slots.
+ *
+ *     ./playback [-t start] [-x speed] [-q] drive.rec
+ *
+ * Keys: SPACE pause, LEFT/RIGHT -/+ 5 s, [ / ] -/+ 60 s, HOME/END,
+ * UP/DOWN double/halve speed (0.1x .. 100x), Q quit.  With -q there is
+ * no terminal UI: it plays from start to end and exits.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <getopt.h>
+#include <ncurses.h>
+#include <sys/mman.h>
+
+#include "common.h"
+#include "recording.h"
+#include "session.h"
+
+#define MIN_SPEED 0.1
+#define MAX_SPEED 100.0
+#define FRAME_NS  16666667L         // publish at ~60 Hz
+#define SCRUB_SHORT 5.0
+#define SCRUB_LONG  60.0
+
+double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+SimShared *open_shared_memory() {
+    int fd = shm_open(session_shm_name(), O_CREAT | O_RDWR, 0666);
+    if (fd < 0) {
+        perror("shm_open");
+        return NULL;
+    }
+    if (ftruncate(fd, sizeof(SimShared)) < 0) {
+        perror("ftruncate");
+        close(fd);
+        return NULL;
+    }
+
+    SimShared *sim = mmap(NULL, sizeof(SimShared), PROT_READ | PROT_WRITE,
+                          MAP_SHARED, fd, 0);
+    close(fd);
+    if (sim == MAP_FAILED) {
+        perror("mmap");
+        return NULL;
+    }
+    return sim;
+}
+
+void publish(SimShared *sim, const RecordingReader *r) {
+    for (int v = 0; v < MAX_VEHICLES; v++)
+        if (r->seen[v])
+            car_publish(&sim->cars[v], &r->cars[v]);
+}
+
+double clampd(double v, double lo, double hi) {
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+int main(int argc, char **argv) {
+    double start = -1.0;
+    double speed = 1.0;
+    bool ui = true;
+
+    static const struct option opts[] = {
+        { "time",  required_argument, NULL, 't' },
+        { "speed", required_argument, NULL, 'x' },
+        { "quiet", no_argument,       NULL, 'q' },
+        { "session", required_argument, NULL, 'i' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "t:x:qi:", opts, NULL)) != -1) {
+        if (opt == 't') {
+            start = atof(optarg);
+        } else if (opt == 'x') {
+            speed = clampd(atof(optarg), MIN_SPEED, MAX_SPEED);
+        } else if (opt == 'q') {
+            ui = false;
+        } else if (opt == 'i' && session_set(optarg)) {
+            continue;
+        } else {
+            fprintf(stderr, "Usage: %s [-t start] [-x speed] [-q] [-i session] FILE\n", argv[0]);
+            return 1;
+        }
+    }
+    if (optind != argc - 1) {
+        fprintf(stderr, "Usage: %s [-t start] [-x speed] [-q] [-i session] FILE\n", argv[0]);
+        return 1;
+    }
+
+    RecordingReader *rec = recording_open(argv[optind]);
+    if (!rec)
+        return 1;
+    SimShared *sim = open_shared_memory();
+    if (!sim)
+        return 1;
+
+    double t = start < 0.0 ? rec->start_time : clampd(start, rec->start_time, rec->end_time);
+    recording_seek(rec, t);
+    publish(sim, rec);
+
+    if (ui) {
+        initscr();
+        cbreak();
+        noecho();
+        nodelay(stdscr, TRUE);
+        keypad(stdscr, TRUE);
+        curs_set(0);
+    }
+
+    bool paused = false;
+    bool running = true;
+    double last = now_seconds();
+    struct timespec frame = { 0, FRAME_NS };
+
+    while (running) {
+        double now = now_seconds();
+        double wall_dt = now - last;
+        last = now;
+
+        double target = t;
+        int ch = ui ? getch() : ERR;
+        switch (ch) {
+        case ' ':       paused = !paused; break;
+        case KEY_LEFT:  target -= SCRUB_SHORT; break;
+        case KEY_RIGHT: target += SCRUB_SHORT; break;
+        case '[':       target -= SCRUB_LONG; break;
+        case ']':       target += SCRUB_LONG; break;
+        case KEY_HOME:  target = rec->start_time; break;
+        case KEY_END:   target = rec->end_time; break;
+        case KEY_UP:    speed = clampd(speed * 2.0, MIN_SPEED, MAX_SPEED); break;
+        case KEY_DOWN:  speed = clampd(speed / 2.0, MIN_SPEED, MAX_SPEED); break;
+        case 'q':
+        case 'Q':       running = false; break;
+        }
+
+        if (!paused && target == t)
+            target = t + wall_dt * speed;
+        target = clampd(target, rec->start_time, rec->end_time);
+
+        /* Forward: keep applying deltas; backward: seek from a keyframe */
+        if (target >= t)
+            recording_advance(rec, target);
+        else
+            recording_seek(rec, target);
+        t = target;
+        publish(sim, rec);
+
+        if (ui) {
+            erase();
+            mvprintw(1, 2, "PLAYBACK - %s", argv[optind]);
+            mvprintw(3, 2, "Time     : %10.2f s of %.2f s", t, rec->end_time);
+            mvprintw(4, 2, "Speed    : %6.1fx %s", speed, paused ? "(paused)" : "");
+            mvprintw(5, 2, "Keyframes: %zu, every %.1f s",
+                     rec->index_count, rec->header->keyframe_interval);
+            mvprintw(7, 2, "SPACE pause | LEFT/RIGHT 5 s | [ ] 60 s | HOME/END");
+            mvprintw(8, 2, "UP/DOWN speed x2 / x0.5 | Q quit");
+            refresh();
+        } else if (t >= rec->end_time) {
+            running = false;
+        }
+
+        nanosleep(&frame, NULL);
+    }
+
+    if (ui)
+        endwin();
+
+    const CarSnapshot *c = &rec->cars[0];
+    printf("Stopped at %.3f s: vehicle 0 at (%.2f, %.2f), speed %.2f m/s, fuel %.2f L\n",
+           t, c->x, c->y, c->speed, c->fuel);
+
+    /* Tell monitors the drive is over, as the server does */
+    for (int v = 0; v < MAX_VEHICLES; v++) {
+        if (!rec->seen[v])
+            continue;
+        CarSnapshot snap = rec->cars[v];
+        snap.shutdown = true;
+        car_publish(&sim->cars[v], &snap);
+    }
+
+    recording_close_reader(rec);
+    return 0;
+}
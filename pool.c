@@ -0,0 +1,134 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "pool.h"
+
+#define MAX_POOL_THREADS 1024
+
+/* Jobs [next, end) still queued with one worker; own cache line each */
+typedef struct {
+    _Alignas(64) pthread_mutex_t lock;
+    int  next;
+    int  end;
+    long steals;
+} PoolQueue;
+
+typedef struct {
+    PoolQueue *queues;
+    int        threads;
+    PoolJob    fn;
+    void      *arg;
+} Pool;
+
+typedef struct {
+    Pool    *pool;
+    int      self;
+} Worker;
+
+int pool_default_threads() {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+/* ---------------- QUEUES ---------------- */
+
+/* Next job from the front of our own range, -1 if it is empty */
+static int take(PoolQueue *q) {
+    int job = -1;
+    pthread_mutex_lock(&q->lock);
+    if (q->next < q->end)
+        job = q->next++;
+    pthread_mutex_unlock(&q->lock);
+    return job;
+}
+
+/* Move the back half of some other worker's range into ours; false once
+ * every queue is empty.  Jobs are never added, so that is the end. */
+static bool steal(Pool *p, int self, unsigned *seed) {
+    int start = p->threads > 1 ? (int)(rand_r(seed) % (unsigned)p->threads) : 0;
+
+    for (int k = 0; k < p->threads; k++) {
+        int v = (start + k) % p->threads;
+        if (v == self)
+            continue;
+
+        PoolQueue *victim = &p->queues[v];
+        pthread_mutex_lock(&victim->lock);
+        int left = victim->end - victim->next;
+        int lo = victim->end - (left + 1) / 2;
+        int hi = victim->end;
+        if (left > 0)
+            victim->end = lo;
+        pthread_mutex_unlock(&victim->lock);
+
+        if (left > 0) {
+            PoolQueue *q = &p->queues[self];
+            pthread_mutex_lock(&q->lock);
+            q->next = lo;
+            q->end  = hi;
+            q->steals++;
+            pthread_mutex_unlock(&q->lock);
+            return true;
+        }
+    }
+    return false;
+}
+
+static void *worker_main(void *arg) {
+    Worker *w = arg;
+    Pool *p = w->pool;
+    unsigned seed = 0x9e3779b9u * (unsigned)(w->self + 1);
+
+    do {
+        int job;
+        while ((job = take(&p->queues[w->self])) >= 0)
+            p->fn(job, p->arg);
+    } while (steal(p, w->self, &seed));
+
+    return NULL;
+}
+
+/* ---------------- RUN ---------------- */
+
+long pool_run(int threads, int count, PoolJob fn, void *arg) {
+    if (threads < 1)
+        threads = 1;
+    if (threads > MAX_POOL_THREADS)
+        threads = MAX_POOL_THREADS;
+    if (threads > count)
+        threads = count > 0 ? count : 1;
+
+    Pool p = { .threads = threads, .fn = fn, .arg = arg };
+    p.queues = aligned_alloc(64, sizeof(PoolQueue) * threads);
+
+    /* Even contiguous shares to start with */
+    for (int i = 0; i < threads; i++) {
+        PoolQueue *q = &p.queues[i];
+        pthread_mutex_init(&q->lock, NULL);
+        q->next   = (int)((long long)count * i / threads);
+        q->end    = (int)((long long)count * (i + 1) / threads);
+        q->steals = 0;
+    }
+
+    pthread_t tids[MAX_POOL_THREADS];
+    Worker workers[MAX_POOL_THREADS];
+    for (int i = 1; i < threads; i++) {
+        workers[i] = (Worker){ &p, i };
+        pthread_create(&tids[i], NULL, worker_main, &workers[i]);
+    }
+    workers[0] = (Worker){ &p, 0 };
+    worker_main(&workers[0]);
+
+    long steals = p.queues[0].steals;
+    for (int i = 1; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+        steals += p.queues[i].steals;
+    }
+
+    for (int i = 0; i < threads; i++)
+        pthread_mutex_destroy(&p.queues[i].lock);
+    free(p.queues);
+    return steals;
+}
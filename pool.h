@@ -0,0 +1,26 @@
+#ifndef POOL_H
+#define POOL_H
+
+/*
+ * Work-stealing pool for batches of independent jobs.
+ *
+ * Jobs 0..count-1 are dealt out to the workers in contiguous ranges.  A
+ * worker runs its own range from the front; when that is empty it steals
+ * the back half of a random victim's range.  Jobs that take longer than
+ * others (a config that never shifts, a longer drive) therefore do not
+ * leave the other cores idle at the end of the batch.
+ *
+ * Each job must be independent: fn is called from several threads at
+ * once, exactly once per job index.
+ */
+
+typedef void (*PoolJob)(int job, void *arg);
+
+/* Worker threads to use when none are asked for: the online CPUs. */
+int pool_default_threads();
+
+/* Run every job and return when all have finished.  Returns the number of
+ * steals, for reporting. */
+long pool_run(int threads, int count, PoolJob fn, void *arg);
+
+#endif
@@ -0,0 +1,131 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stdbool.h>
+
+/* ---------------- CONNECTION ---------------- */
+
+#define SERVER_PORT 9734
+
+#define CLIENT_ENGINE        1
+#define CLIENT_TRANSMISSION  2
+#define CLIENT_FUEL          3
+
+/*
+ * Handshake: the first int a client sends.
+ *
+ * Low byte  = client type (CLIENT_*)
+ * High bits = vehicle id
+ *
+ * Vehicle 0 encodes as the bare client type, so a single-car client that
+ * only sends its type keeps working.
+ */
+#define HANDSHAKE_TYPE_BITS  8
+#define HANDSHAKE(type, vehicle) \
+    ((type) | ((vehicle) << HANDSHAKE_TYPE_BITS))
+#define HANDSHAKE_TYPE(h)    ((h) & ((1 << HANDSHAKE_TYPE_BITS) - 1))
+#define HANDSHAKE_VEHICLE(h) ((h) >> HANDSHAKE_TYPE_BITS)
+
+/* ---------------- SOCKET MESSAGE STRUCTS ---------------- */
+
+/*
+ * Every request carries the simulation clock: sim_time is the time at the
+ * start of the step and dt its length.  Clients must integrate with these
+ * rather than the wall clock, which is what makes lockstep runs
+ * reproducible.
+ *
+ * Clients keep no simulation state between requests.  Whatever a stage
+ * has to remember (the engine's reverse latch, the transmission's last
+ * shift) comes back in its reply and is sent again with the next request,
+ * so the server holds the whole state of a run: it can checkpoint it, and
+ * a client can restart mid-drive.
+ */
+
+/* What the driver asks for; the engine step clamps and latches it. */
+typedef struct {
+    double throttle;        // 0 .. 1
+    double brake;           // 0 .. 1
+    double steer;           // -1 .. 1
+    bool   engine_on;
+    bool   reverse;
+} DriverInput;
+
+/* ENGINE */
+typedef struct {
+    double speed;
+    double fuel;
+    int    gear;
+    double heading;
+    double x;
+    double y;
+    int    reverse;         // direction latched so far (last reply's reverse)
+
+    double sim_time;
+    double dt;
+} EngineStateIn;
+
+typedef struct {
+    double throttle;
+    double brake;
+    double steer;
+    int    reverse;
+    int    num_gears;       // the model's forward gears, for the transmission
+
+    double speed;
+    double heading;
+    double x;
+    double y;
+
+    double rpm;
+    double power;
+    double torque;
+
+    DriverInput driver;     // the input this step ran on, for the journal
+} EngineStateOut;
+
+/* TRANSMISSION */
+typedef struct {
+    int    client_id;
+    double speed_mps;
+    int    gear;
+    double rpm;
+    int    reverse;
+    double throttle;
+    double last_shift_time; // last reply's; NEVER_SHIFTED at first
+    int    num_gears;       // engine's latest; 0 before its first reply
+
+    double sim_time;
+    double dt;
+} TransmissionIn;
+
+typedef struct {
+    int    client_id;
+    int    updated_gear;
+    double last_shift_time; // sim time of the latest up/downshift
+} TransmissionOut;
+
+/* Far enough back that no shift cooldown applies */
+#define NEVER_SHIFTED (-1.0e9)
+
+/* FUEL */
+typedef struct {
+    int    client_id;
+    double throttle;
+    double speed;
+    int    rpm;
+    double power;
+    double current_fuel;
+
+    double sim_time;
+    double dt;
+} FuelIn;
+
+typedef struct {
+    int    client_id;
+    double updated_fuel;
+    int    no_fuel;
+    int    low_fuel;
+    int    full_fuel;
+} FuelOut;
+
+#endif
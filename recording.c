@@ -0,0 +1,342 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "recording.h"
+
+#define RECORDING_BUFFER (1 << 20)
+#define TIME_EPSILON 1e-9
+
+/* Delta field order; values are stored in 8-byte slots whatever their size. */
+static const struct { size_t offset, size; } fields[RECORDING_FIELDS] = {
+    { offsetof(CarSnapshot, throttle), sizeof(double) },
+    { offsetof(CarSnapshot, brake),    sizeof(double) },
+    { offsetof(CarSnapshot, steer),    sizeof(double) },
+    { offsetof(CarSnapshot, reverse),  sizeof(bool)   },
+    { offsetof(CarSnapshot, speed),    sizeof(double) },
+    { offsetof(CarSnapshot, gear),     sizeof(int)    },
+    { offsetof(CarSnapshot, heading),  sizeof(double) },
+    { offsetof(CarSnapshot, x),        sizeof(double) },
+    { offsetof(CarSnapshot, y),        sizeof(double) },
+    { offsetof(CarSnapshot, rpm),      sizeof(double) },
+    { offsetof(CarSnapshot, power),    sizeof(double) },
+    { offsetof(CarSnapshot, torque),   sizeof(double) },
+    { offsetof(CarSnapshot, fuel),     sizeof(double) },
+};
+
+#define KEYFRAME_ENTRY_SIZE (sizeof(uint32_t) + sizeof(double) + sizeof(CarSnapshot))
+#define DELTA_HEAD_SIZE     (1 + sizeof(uint32_t) + sizeof(double) + sizeof(uint16_t))
+
+/* ---------------- WRITING ---------------- */
+
+static void put(RecordingWriter *w, const void *p, size_t len) {
+    fwrite(p, 1, len, w->f);
+    w->offset += len;
+}
+
+static void write_keyframe(RecordingWriter *w, double time) {
+    if (w->index_count == w->index_cap) {
+        w->index_cap = w->index_cap ? w->index_cap * 2 : 256;
+        w->index = realloc(w->index, w->index_cap * sizeof(*w->index));
+    }
+    w->index[w->index_count++] = (RecordingIndexEntry){ time, w->offset };
+
+    uint32_t n = 0;
+    for (int v = 0; v < MAX_VEHICLES; v++)
+        n += w->seen[v];
+
+    uint8_t kind = FRAME_KEYFRAME;
+    put(w, &kind, 1);
+    put(w, &time, sizeof(time));
+    put(w, &n, sizeof(n));
+
+    for (uint32_t v = 0; v < MAX_VEHICLES; v++) {
+        if (!w->seen[v])
+            continue;
+        put(w, &v, sizeof(v));
+        put(w, &w->last_time[v], sizeof(double));
+        put(w, &w->last[v], sizeof(CarSnapshot));
+    }
+}
+
+RecordingWriter *recording_create(const char *path, double dt, double keyframe_interval) {
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        perror(path);
+        return NULL;
+    }
+    setvbuf(f, NULL, _IOFBF, RECORDING_BUFFER);
+
+    RecordingWriter *w = calloc(1, sizeof(RecordingWriter));
+    w->f = f;
+    w->keyframe_interval = keyframe_interval;
+    w->last      = calloc(MAX_VEHICLES, sizeof(CarSnapshot));
+    w->last_time = calloc(MAX_VEHICLES, sizeof(double));
+    w->seen      = calloc(MAX_VEHICLES, sizeof(bool));
+
+    RecordingHeader h = { .version = RECORDING_VERSION,
+                          .snapshot_size = sizeof(CarSnapshot),
+                          .dt = dt,
+                          .keyframe_interval = keyframe_interval };
+    memcpy(h.magic, RECORDING_MAGIC, sizeof(h.magic));
+    put(w, &h, sizeof(h));
+    return w;
+}
+
+void recording_write(RecordingWriter *w, uint32_t vehicle, double sim_time,
+                     const CarSnapshot *car) {
+    const uint8_t *now  = (const uint8_t *)car;
+    const uint8_t *prev = (const uint8_t *)&w->last[vehicle];
+
+    uint16_t mask = 0;
+    for (int i = 0; i < RECORDING_FIELDS; i++)
+        if (!w->seen[vehicle] ||
+            memcmp(now + fields[i].offset, prev + fields[i].offset, fields[i].size) != 0)
+            mask |= 1u << i;
+
+    uint8_t frame[DELTA_HEAD_SIZE + RECORDING_FIELDS * 8];
+    size_t len = 0;
+    frame[len++] = FRAME_DELTA;
+    memcpy(frame + len, &vehicle, sizeof(vehicle));   len += sizeof(vehicle);
+    memcpy(frame + len, &sim_time, sizeof(sim_time)); len += sizeof(sim_time);
+    memcpy(frame + len, &mask, sizeof(mask));         len += sizeof(mask);
+    for (int i = 0; i < RECORDING_FIELDS; i++) {
+        if (!(mask & (1u << i)))
+            continue;
+        memset(frame + len, 0, 8);
+        memcpy(frame + len, now + fields[i].offset, fields[i].size);
+        len += 8;
+    }
+    put(w, frame, len);
+    w->deltas++;
+
+    w->last[vehicle] = *car;
+    w->last[vehicle].shutdown = false;
+    w->last_time[vehicle] = sim_time;
+    w->seen[vehicle] = true;
+
+    if (sim_time >= w->next_keyframe - TIME_EPSILON) {
+        write_keyframe(w, sim_time);
+        w->next_keyframe = (floor(sim_time / w->keyframe_interval + TIME_EPSILON) + 1.0) *
+                           w->keyframe_interval;
+    }
+}
+
+void recording_close(RecordingWriter *w) {
+    if (!w)
+        return;
+
+    double end_time = 0.0;
+    for (int v = 0; v < MAX_VEHICLES; v++)
+        if (w->seen[v] && w->last_time[v] > end_time)
+            end_time = w->last_time[v];
+
+    RecordingFooter footer = { .index_offset = w->offset,
+                               .index_count  = w->index_count,
+                               .end_time     = end_time };
+    memcpy(footer.magic, INDEX_MAGIC, sizeof(footer.magic));
+    put(w, w->index, w->index_count * sizeof(*w->index));
+    put(w, &footer, sizeof(footer));
+
+    if (fclose(w->f) != 0)
+        perror("recording");
+    free(w->index);
+    free(w->last);
+    free(w->last_time);
+    free(w->seen);
+    free(w);
+}
+
+/* ---------------- READING ---------------- */
+
+typedef struct {
+    int            kind;        // FRAME_*, 0 if truncated or unknown
+    size_t         size;
+    double         time;
+    uint32_t       vehicle;     // DELTA
+    uint32_t       count;       // KEYFRAME entries
+    uint16_t       mask;        // DELTA
+    const uint8_t *body;        // after the fixed part
+} Frame;
+
+static Frame frame_at(const RecordingReader *r, uint64_t pos) {
+    Frame fr = { 0 };
+    const uint8_t *p = r->data + pos;
+    size_t left = r->end - pos;
+
+    if (left >= 1 + sizeof(double) + sizeof(uint32_t) && p[0] == FRAME_KEYFRAME) {
+        memcpy(&fr.time, p + 1, sizeof(double));
+        memcpy(&fr.count, p + 1 + sizeof(double), sizeof(uint32_t));
+        fr.body = p + 1 + sizeof(double) + sizeof(uint32_t);
+        fr.size = (size_t)(fr.body - p) + (size_t)fr.count * KEYFRAME_ENTRY_SIZE;
+        fr.kind = FRAME_KEYFRAME;
+    } else if (left >= DELTA_HEAD_SIZE && p[0] == FRAME_DELTA) {
+        memcpy(&fr.vehicle, p + 1, sizeof(uint32_t));
+        memcpy(&fr.time, p + 1 + sizeof(uint32_t), sizeof(double));
+        memcpy(&fr.mask, p + 1 + sizeof(uint32_t) + sizeof(double), sizeof(uint16_t));
+        fr.body = p + DELTA_HEAD_SIZE;
+        fr.size = DELTA_HEAD_SIZE + 8 * (size_t)__builtin_popcount(fr.mask);
+        fr.kind = fr.vehicle < MAX_VEHICLES ? FRAME_DELTA : 0;
+    }
+
+    if (fr.kind && fr.size > left)
+        fr.kind = 0;
+    return fr;
+}
+
+static void apply_frame(RecordingReader *r, const Frame *fr) {
+    if (fr->kind == FRAME_KEYFRAME) {
+        const uint8_t *p = fr->body;
+        for (uint32_t i = 0; i < fr->count; i++, p += KEYFRAME_ENTRY_SIZE) {
+            uint32_t v;
+            memcpy(&v, p, sizeof(v));
+            if (v >= MAX_VEHICLES)
+                continue;
+            memcpy(&r->cars[v], p + sizeof(uint32_t) + sizeof(double), sizeof(CarSnapshot));
+            r->seen[v] = true;
+        }
+        return;
+    }
+
+    uint8_t *car = (uint8_t *)&r->cars[fr->vehicle];
+    const uint8_t *p = fr->body;
+    for (int i = 0; i < RECORDING_FIELDS; i++) {
+        if (!(fr->mask & (1u << i)))
+            continue;
+        memcpy(car + fields[i].offset, p, fields[i].size);
+        p += 8;
+    }
+    r->seen[fr->vehicle] = true;
+}
+
+/* No footer: find the keyframes (and where the last whole frame ends) by walking the file. */
+static void scan(RecordingReader *r) {
+    size_t cap = 0;
+    uint64_t pos = sizeof(RecordingHeader);
+
+    for (;;) {
+        Frame fr = frame_at(r, pos);
+        if (!fr.kind)
+            break;
+        if (fr.kind == FRAME_KEYFRAME) {
+            if (r->index_count == cap) {
+                cap = cap ? cap * 2 : 256;
+                r->index = realloc(r->index, cap * sizeof(*r->index));
+            }
+            r->index[r->index_count++] = (RecordingIndexEntry){ fr.time, pos };
+        }
+        if (fr.time > r->end_time)
+            r->end_time = fr.time;
+        pos += fr.size;
+    }
+    r->end = pos;
+}
+
+RecordingReader *recording_open(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return NULL;
+    }
+    struct stat st;
+    fstat(fd, &st);
+    size_t size = (size_t)st.st_size;
+
+    void *map = size ? mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+
+    const RecordingHeader *h = map;
+    if (map == MAP_FAILED || size < sizeof(*h) ||
+        memcmp(h->magic, RECORDING_MAGIC, sizeof(h->magic)) != 0 ||
+        h->version != RECORDING_VERSION || h->snapshot_size != sizeof(CarSnapshot)) {
+        fprintf(stderr, "%s: not a version %d recording from this build\n",
+                path, RECORDING_VERSION);
+        if (map != MAP_FAILED)
+            munmap(map, size);
+        return NULL;
+    }
+
+    RecordingReader *r = calloc(1, sizeof(RecordingReader));
+    r->data   = map;
+    r->size   = size;
+    r->header = h;
+    r->cars   = calloc(MAX_VEHICLES, sizeof(CarSnapshot));
+    r->seen   = calloc(MAX_VEHICLES, sizeof(bool));
+
+    RecordingFooter footer;
+    bool indexed = false;
+    if (size >= sizeof(*h) + sizeof(footer)) {
+        memcpy(&footer, r->data + size - sizeof(footer), sizeof(footer));
+        indexed = memcmp(footer.magic, INDEX_MAGIC, sizeof(footer.magic)) == 0 &&
+                  footer.index_offset + footer.index_count * sizeof(RecordingIndexEntry) +
+                      sizeof(footer) == size;
+    }
+
+    if (indexed) {
+        r->index_count = footer.index_count;
+        r->index = malloc((r->index_count ? r->index_count : 1) * sizeof(*r->index));
+        memcpy(r->index, r->data + footer.index_offset, r->index_count * sizeof(*r->index));
+        r->end = footer.index_offset;
+        r->end_time = footer.end_time;
+    } else {
+        fprintf(stderr, "%s: no index (recording cut short?), scanning\n", path);
+        r->end = size;
+        scan(r);
+    }
+
+    r->start_time = r->index_count ? r->index[0].time : 0.0;
+    recording_seek(r, r->start_time);
+    return r;
+}
+
+void recording_close_reader(RecordingReader *r) {
+    if (!r)
+        return;
+    munmap((void *)r->data, r->size);
+    free(r->index);
+    free(r->cars);
+    free(r->seen);
+    free(r);
+}
+
+void recording_seek(RecordingReader *r, double t) {
+    memset(r->cars, 0, MAX_VEHICLES * sizeof(CarSnapshot));
+    memset(r->seen, 0, MAX_VEHICLES * sizeof(bool));
+    r->pos = sizeof(RecordingHeader);
+
+    /* Last keyframe at or before t */
+    size_t lo = 0, hi = r->index_count;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (r->index[mid].time <= t + TIME_EPSILON)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo > 0)
+        r->pos = r->index[lo - 1].offset;
+
+    r->time = -INFINITY;
+    recording_advance(r, t);
+}
+
+bool recording_advance(RecordingReader *r, double t) {
+    while (r->pos < r->end) {
+        Frame fr = frame_at(r, r->pos);
+        if (!fr.kind) {
+            r->pos = r->end;
+            break;
+        }
+        if (fr.kind == FRAME_DELTA && fr.time > t + TIME_EPSILON)
+            break;
+        apply_frame(r, &fr);
+        r->pos += fr.size;
+    }
+    r->time = t;
+    return r->pos < r->end;
+}
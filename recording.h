@@ -0,0 +1,109 @@
+#ifndef RECORDING_H
+#define RECORDING_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "common.h"
+
+/*
+ * Drive recordings with random access by simulation time.
+ *
+ * After a RecordingHeader the file is a stream of frames, each starting
+ * with a one-byte kind:
+ *
+ *   KEYFRAME  double time, uint32 n, then n x (uint32 vehicle,
+ *             double sim_time, CarSnapshot) - every vehicle seen so far
+ *   DELTA     uint32 vehicle, double sim_time, uint16 mask, then one
+ *             8-byte value per set bit, in RECORDING_FIELDS order
+ *
+ * A delta holds only the fields that changed since that vehicle's
+ * previous frame.  A keyframe is written whenever a tick crosses the next
+ * multiple of the keyframe interval, and each goes into a sparse index
+ * (time -> file offset) that close() appends, followed by a
+ * RecordingFooter.  To seek, load the last keyframe at or before the
+ * target and apply deltas up to it.  A file without a footer (the writer
+ * died) is indexed by scanning it.
+ */
+
+#define RECORDING_MAGIC   "CARREC\r\n"
+#define INDEX_MAGIC       "CARIDX\r\n"
+#define RECORDING_VERSION 1
+
+#define FRAME_KEYFRAME 1
+#define FRAME_DELTA    2
+
+#define RECORDING_FIELDS 13     // CarSnapshot fields, shutdown excluded
+
+typedef struct {
+    char     magic[8];          // RECORDING_MAGIC
+    uint32_t version;
+    uint32_t snapshot_size;     // sizeof(CarSnapshot)
+    double   dt;
+    double   keyframe_interval;
+} RecordingHeader;
+
+typedef struct {
+    double   time;
+    uint64_t offset;            // of the keyframe's kind byte
+} RecordingIndexEntry;
+
+typedef struct {
+    char     magic[8];          // INDEX_MAGIC
+    uint64_t index_offset;
+    uint64_t index_count;
+    double   end_time;          // of the last frame
+} RecordingFooter;
+
+/* ---------------- WRITING ---------------- */
+
+typedef struct {
+    FILE        *f;
+    uint64_t     offset;
+    double       keyframe_interval;
+    double       next_keyframe;
+
+    CarSnapshot *last;          // [MAX_VEHICLES], previous frame per vehicle
+    double      *last_time;
+    bool        *seen;
+
+    RecordingIndexEntry *index;
+    size_t       index_count, index_cap;
+    uint64_t     deltas;
+} RecordingWriter;
+
+RecordingWriter *recording_create(const char *path, double dt, double keyframe_interval);
+void recording_write(RecordingWriter *w, uint32_t vehicle, double sim_time,
+                     const CarSnapshot *car);
+void recording_close(RecordingWriter *w);      // writes the index and footer
+
+/* ---------------- READING ---------------- */
+
+typedef struct {
+    const uint8_t  *data;
+    size_t          size;
+    const RecordingHeader *header;
+
+    RecordingIndexEntry *index;
+    size_t          index_count;
+    uint64_t        end;        // where frames stop (index or EOF)
+
+    /* Playback position: state of every vehicle as of `time` */
+    uint64_t        pos;        // next frame to apply
+    double          time;
+    CarSnapshot    *cars;       // [MAX_VEHICLES]
+    bool           *seen;
+    double          start_time, end_time;
+} RecordingReader;
+
+RecordingReader *recording_open(const char *path);
+void recording_close_reader(RecordingReader *r);
+
+/* Jump to time t: latest keyframe at or before it, then deltas up to t. */
+void recording_seek(RecordingReader *r, double t);
+
+/* Apply frames up to time t (>= the current time); false once at the end. */
+bool recording_advance(RecordingReader *r, double t);
+
+#endif
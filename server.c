@@ -1,3 +1,5 @@
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -8,90 +10,298 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/mman.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/resource.h>
+#include <sys/un.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <fcntl.h>
-#include <pthread.h>
+#include <getopt.h>
+#include <errno.h>
 
 #include "common.h"
+#include "protocol.h"
+#include "transport.h"
+#include "tick_sched.h"
+#include "sim_plugin.h"
+#include "sim_tick.h"
+#include "drive_script.h"
+#include "telemetry.h"
+#include "recording.h"
+#include "archive.h"
+#include "journal.h"
+#include "checkpoint.h"
+#include "session.h"
+#include "spatial.h"
+#include "view.h"
 
 /* ---------------- CONSTANTS ---------------- */
 
-#define SERVER_PORT 9734
-#define BACKLOG 5
 #define DT 0.016
 
-#define CLIENT_ENGINE        1
-#define CLIENT_TRANSMISSION  2
-#define CLIENT_FUEL          3
-
-/* ---------------- SOCKET MESSAGE STRUCTS ---------------- */
-
-/* ENGINE */
-typedef struct {
-    double speed;
-    double fuel;
-    int    gear;
-    double heading;
-    double x;
-    double y;
-} EngineStateIn;
-
-typedef struct {
-    double throttle;
-    double brake;
-    double steer;
-    int    reverse;
-
-    double speed;
-    double heading;
-    double x;
-    double y;
-
-    double rpm;
-    double power;
-    double torque;
-} EngineStateOut;
-
-/* TRANSMISSION */
-typedef struct {
-    int    client_id;
-    double speed_mps;
-    int    gear;
-    double rpm;
-    int    reverse;
-    double throttle;
-} TransmissionIn;
-
-typedef struct {
-    int client_id;
-    int updated_gear;
-} TransmissionOut;
-
-/* FUEL */
-typedef struct {
-    int    client_id;
-    double throttle;
-    double speed;
-    int    rpm;
-    double power;
-    double current_fuel;
-} FuelIn;
+#define MAX_EVENTS 256
+
+/* In-process ticks take ~100 ns, so timing every one would dominate them;
+ * time one tick in this many per vehicle instead. */
+#define IN_PROCESS_SAMPLE 64
+#define NUM_CLIENT_TYPES 3
+
+/*
+ * Tick modes.
+ *
+ * SEQUENTIAL: engine, then transmission, then fuel, each a full round trip.
+ *             Transmission and fuel see this tick's engine output.
+ *
+ * PIPELINED:  all three requests go out at once and replies are collected
+ *             in arrival order, so a tick costs the slowest client instead
+ *             of the sum.  Transmission and fuel are fed the state published
+ *             at the end of the previous tick, i.e. they lag the engine by
+ *             one tick (DT seconds).
+ */
+#define TICK_SEQUENTIAL 0
+#define TICK_PIPELINED  1
+
+/*
+ * Clocks.
+ *
+ * Every tick advances a vehicle's simulation time by exactly the tick
+ * period, whatever the wall clock did, and both go out with each request.
+ *
+ * REALTIME: ticks are paced by the deadline scheduler.
+ * LOCKSTEP: no pacing at all - a vehicle's next tick starts as soon as the
+ *           previous one completes, so runs go as fast as the clients can
+ *           answer and depend only on their inputs.
+ */
+
+/* Bit per outstanding reply */
+#define PENDING(type) (1u << ((type) - 1))
+#define PENDING_ALL   (PENDING(CLIENT_ENGINE) | PENDING(CLIENT_TRANSMISSION) | \
+                       PENDING(CLIENT_FUEL))
+
+/*
+ * Stage rates.
+ *
+ * The tick rate is the engine's.  Transmission and fuel may run slower
+ * (--stage-rate): each keeps a grid of deadlines in simulation time and
+ * runs on the first tick that reaches the next one.  A run covers all the
+ * simulated time since the previous run, so its request carries that
+ * interval as sim_time/dt.  The transmission is fed the latest state
+ * (decimated); fuel is fed the engine outputs averaged over the interval,
+ * so it burns what the engine made between runs.  Between runs the car
+ * keeps the stage's last output (gear, fuel).
+ */
+#define STAGE_TIME_EPSILON 1e-9
+
+/* Replay (--replay) prints the first this many mismatches */
+#define REPLAY_REPORT_MAX 10
+
+/* Telemetry (--telemetry): files rotate at this size unless --telemetry-mb */
+#define TELEMETRY_FILE_MB 64
+
+/* Drive recording (--record): a keyframe this often unless --keyframe */
+#define RECORDING_KEYFRAME_S 1.0
+
+/*
+ * In-process stages.
+ *
+ * A stage with a step plugin loaded (--plugin) is run by calling the
+ * plugin instead of messaging a client; its reply is handled on the spot.
+ * When all three stages are plugins the vehicles (--vehicles) exist only
+ * inside the server and engines are driven by --script.  In lockstep
+ * there is then nothing to wait for, so the main loop runs LOCKSTEP_BATCH
+ * round-robin ticks per vehicle between non-blocking polls.
+ */
+#define LOCKSTEP_BATCH 256
+
+/* Viewer subscriptions: grid cell for region lookups, and how often (in
+ * tick-round time) to look for viewers that died holding a slot */
+#define VIEW_GRID_CELL 50.0     // m
+#define VIEW_REAP_S    1.0
+
+/* ---------------- CONNECTIONS & VEHICLES ---------------- */
+
+typedef struct Vehicle Vehicle;
+typedef struct Conn Conn;
+
+/* What an epoll event refers to. */
+#define REF_TCP_LISTEN 0
+#define REF_SHM_LISTEN 1
+#define REF_TIMER      2
+#define REF_SOCKET     3
+#define REF_DOORBELL   4
 
 typedef struct {
-    int    client_id;
-    double updated_fuel;
-    int    no_fuel;
-    int    low_fuel;
-    int    full_fuel;
-} FuelOut;
+    int   kind;             // REF_*
+    Conn *conn;             // REF_SOCKET / REF_DOORBELL
+} EpollRef;
+
+/*
+ * One client.  Everything is non-blocking: replies are accumulated in rx
+ * until a whole struct is there, and a request that does not fit in the
+ * socket buffer waits in tx for EPOLLOUT.
+ *
+ * SHM clients arrive on the unix socket; after the handshake their
+ * messages go through the rings in `shm` and the socket only reports
+ * hangup.
+ *
+ * conn_close() can run on any connection from inside another one's
+ * handler, while events for it are still waiting in the current
+ * epoll_wait batch.  It releases the socket and the vehicle at once but
+ * only marks the Conn closed; conn_reap() frees it after the batch.
+ */
+struct Conn {
+    int      fd;
+    int      transport;     // TRANSPORT_*
+    int      type;          // CLIENT_*, 0 until the handshake arrives
+    Vehicle *veh;
+
+    EpollRef  sock_ref;
+    EpollRef  bell_ref;
+    Transport *shm;
+
+    size_t   rx_len;
+    unsigned char rx[128];
+
+    size_t   tx_len;
+    size_t   tx_off;
+    unsigned char tx[128];
+
+    bool     closed;
+    Conn    *next_closed;   // on closed_conns until reaped
+};
+
+/*
+ * Per-vehicle tick state machine.
+ *
+ *   idle --tick--> waiting on `pending` replies --last reply--> idle
+ *
+ * Sequential mode sends the next request from the previous reply's
+ * handler; pipelined mode sends all three at tick start.
+ */
+struct Vehicle {
+    int        id;
+    Conn      *conn[NUM_CLIENT_TYPES];
+    int        active_idx;  // index in active[], -1 if not all connected
+    unsigned   pending;
+
+    CarSnapshot car;        // server-private working copy
+    CarShared  *shared;     // published once per completed tick
+
+    void         *plugin_state[NUM_CLIENT_TYPES];
+    int           num_gears;        // engine's model's, passed on to the transmission
+
+    bool          timed;    // this tick feeds the TickStats histograms
+    long long     tick_start_ns;
+    long long     sent_ns[NUM_CLIENT_TYPES];    // per outstanding request
+
+    unsigned      stages;                       // PENDING bits running this tick
+    double        stage_due[NUM_CLIENT_TYPES];  // next deadline, slow stages only
+    double        stage_from[NUM_CLIENT_TYPES]; // sim time the last run reached
+
+    JournalRecord *journal_rec;     // this tick so far, with --journal
+
+    FuelAverage   fuel_avg;         // engine outputs since the last fuel run
+    double        last_shift_time;  // transmission's, sent back with its requests
+
+    bool          checkpointed;     // has a slot in checkpoint_slots
+    unsigned      checkpoint_gen;   // last periodic checkpoint it was captured for
+
+    double        sim_time;  // at the start of the next tick
+    unsigned long ticks;     // completed
+    double        start_time;       // sim_time and ticks when this run began
+    unsigned long start_ticks;      // (non-zero after --restore)
+    unsigned long overruns;  // timer fired while still waiting
+    bool          finished;  // reached --ticks
+    bool          round_done;       // socket lockstep: this round's tick is over
+};
 
 /* ---------------- GLOBALS ---------------- */
 
-static CarShared *car = NULL;
+static SimShared *shm = NULL;
 static int server_fd = -1;
-static int engine_fd = -1;
-static int trans_fd  = -1;
-static int fuel_fd   = -1;
+static int shm_listen_fd = -1;
+static int epoll_fd  = -1;
+static int timer_fd  = -1;
+
+static EpollRef tcp_listen_ref = { REF_TCP_LISTEN, NULL };
+static EpollRef shm_listen_ref = { REF_SHM_LISTEN, NULL };
+static EpollRef timer_ref      = { REF_TIMER,      NULL };
+static Conn    *closed_conns = NULL;
+
+static Vehicle  vehicles[MAX_VEHICLES];
+static Vehicle *active[MAX_VEHICLES];
+static int      num_active = 0;
+
+static int tick_mode = TICK_SEQUENTIAL;
+static double stage_rate[NUM_CLIENT_TYPES];     // Hz, 0 = every tick
+static double stage_period[NUM_CLIENT_TYPES];   // s,  0 = every tick
+
+static TickSched sched;
+static double tick_period = DT;
+static int    overrun_policy = OVERRUN_CATCHUP;
+
+static bool          lockstep = false;
+static unsigned long max_ticks = 0;     // per vehicle, 0 = unlimited
+static int           num_finished = 0;
+static int           round_done_count = 0;  // socket lockstep: vehicles with round_done
+static long long     run_start_ns;
+
+static const SimPlugin *plugins[NUM_CLIENT_TYPES];
+static bool         in_process = false;     // every stage is a plugin
+static int          num_local_vehicles = 0;
+static DriveScript *driver_script = NULL;
+static VehicleModel *engine_model = NULL;  // NULL: the plugin's default
+static EngineState  engine_integrator = { .integrator = INTEGRATOR_EULER, .substeps = 1 };
+static bool         engine_integrator_set = false;
+
+static const char *telemetry_prefix = NULL;
+static size_t      telemetry_mb = TELEMETRY_FILE_MB;
+static Telemetry  *telemetry = NULL;
+
+static const char *recording_path = NULL;
+static double      keyframe_interval = RECORDING_KEYFRAME_S;
+static RecordingWriter *recording = NULL;
+
+static const char *archive_path = NULL;
+static ArchiveWriter *archive = NULL;
+
+static const char *checkpoint_path = NULL;
+static double      checkpoint_every = 0.0;  // s of sim time, 0 = only at exit
+static const char *restore_path = NULL;
+static VehicleCheckpoint checkpoint_slots[MAX_VEHICLES];
+static unsigned    checkpoint_gen = 1;      // periodic checkpoint being collected
+static int         checkpoint_captured = 0;   // ticking vehicles captured for checkpoint_gen
+static unsigned    checkpoints_written = 0;
+static CheckpointWriter *checkpoint_writer = NULL;  // periodic checkpoints
+
+static double        contact_distance = 0.0;   // m, 0 = no contact checks
+static SpatialGrid  *contact_grid = NULL;
+static SpatialPairs  contact_pairs;
+static unsigned long contact_checks = 0;
+static unsigned long contact_total = 0;        // pairs summed over checks
+static size_t        contact_peak = 0;
+static long long     contact_ns = 0;
+
+static SpatialGrid  *view_grid = NULL;
+static unsigned      view_claims_seen = 0;
+static int           view_slots[MAX_VIEWERS];  // slots being served
+static int           num_view_slots = 0;
+static bool          view_on[MAX_VIEWERS];
+static int           view_owner[MAX_VIEWERS];
+static unsigned      view_filter_seq[MAX_VIEWERS];
+static ViewFilter    view_filter[MAX_VIEWERS];
+static double        view_due[MAX_VIEWERS];
+static double        view_clock = 0.0;         // s, one tick_period per round
+static double        view_reap_due = VIEW_REAP_S;
+static unsigned long view_frames = 0;
+static long long     view_ns = 0;
+
+static double round_x[MAX_VEHICLES], round_y[MAX_VEHICLES];    // active[i]'s position
+
+static const char *journal_path = NULL;
+static const char *replay_path = NULL;
+static Journal    *journal = NULL;
 
 static volatile sig_atomic_t sigint_received = 0;
 
@@ -104,31 +314,34 @@ void handle_sigint(int sig) {
 
 /* ---------------- SHARED MEMORY INIT ---------------- */
 
-CarShared *init_shared_memory() {
-    int shm_fd = shm_open(SHM_NAME, O_CREAT | O_RDWR, 0666);
+SimShared *init_shared_memory() {
+    int shm_fd = shm_open(session_shm_name(), O_CREAT | O_RDWR, 0666);
     if (shm_fd < 0) {
         perror("shm_open");
         exit(1);
     }
 
-    ftruncate(shm_fd, sizeof(CarShared));
+    ftruncate(shm_fd, sizeof(SimShared));
 
-    CarShared *ptr = mmap(NULL, sizeof(CarShared),
+    SimShared *ptr = mmap(NULL, sizeof(SimShared),
                           PROT_READ | PROT_WRITE,
                           MAP_SHARED, shm_fd, 0);
+    if (ptr == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+    close(shm_fd);
 
-    pthread_mutexattr_t attr;
-    pthread_mutexattr_init(&attr);
-    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    memset(ptr, 0, sizeof(SimShared));
 
-    pthread_mutex_init(&ptr->lock, &attr);
+    CarSnapshot init;
+    memset(&init, 0, sizeof(init));
+    init.fuel = 100.0;
+    init.gear = 0;
+    init.shutdown = false;
 
-    pthread_mutex_lock(&ptr->lock);
-    memset(ptr, 0, sizeof(CarShared));
-    ptr->fuel = 100.0;
-    ptr->gear = 0;
-    ptr->shutdown = false;
-    pthread_mutex_unlock(&ptr->lock);
+    for (int i = 0; i < MAX_VEHICLES; i++)
+        car_publish(&ptr->cars[i], &init);
 
     return ptr;
 }
@@ -136,190 +349,1680 @@ CarShared *init_shared_memory() {
 /* ---------------- SOCKET SETUP ---------------- */
 
 int setup_server_socket() {
-    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
     if (fd < 0) {
         perror("socket");
         exit(1);
     }
 
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
     struct sockaddr_in addr;
     memset(&addr, 0, sizeof(addr));
 
     addr.sin_family = AF_INET;
     addr.sin_addr.s_addr = INADDR_ANY;
-    addr.sin_port = htons(SERVER_PORT);
+    addr.sin_port = htons(session_port());
 
-    bind(fd, (struct sockaddr *)&addr, sizeof(addr));
-    listen(fd, BACKLOG);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        fprintf(stderr, "port %d: %s (is session %d already running? see --session)\n",
+                session_port(), strerror(errno), session_id());
+        exit(1);
+    }
+    listen(fd, SOMAXCONN);
 
     return fd;
 }
 
-/* ---------------- CLIENT ACCEPT ---------------- */
+/* Same-host clients that want the shared-memory ring transport. */
+int setup_shm_socket() {
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        perror("socket");
+        exit(1);
+    }
 
-void accept_clients() {
-    while (!sigint_received &&
-           (engine_fd < 0 || trans_fd < 0 || fuel_fd < 0)) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", session_socket_path()) >=
+        (int)sizeof(addr.sun_path)) {
+        fprintf(stderr, "%s: socket path too long\n", session_socket_path());
+        exit(1);
+    }
 
-        int client_fd = accept(server_fd, NULL, NULL);
+    unlink(session_socket_path());
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("bind");
+        exit(1);
+    }
+    listen(fd, SOMAXCONN);
 
-        if (client_fd < 0) {
-            if (sigint_received)
+    return fd;
+}
+
+/* Three sockets per vehicle: make sure a fleet fits in the fd limit. */
+void raise_fd_limit() {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+}
+
+/* ---------------- REACTOR PLUMBING ---------------- */
+
+void epoll_add(int fd, uint32_t events, void *ptr) {
+    struct epoll_event ev = { .events = events, .data.ptr = ptr };
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        perror("epoll_ctl");
+        exit(1);
+    }
+}
+
+void epoll_mod(Conn *c, uint32_t events) {
+    struct epoll_event ev = { .events = events, .data.ptr = &c->sock_ref };
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, c->fd, &ev);
+}
+
+void vehicle_start_tick(Vehicle *v);
+void checkpoint_ticking(Vehicle *v, bool ticking);
+void lockstep_round_check();
+
+/* Every stage has either a client or a plugin. */
+bool vehicle_complete(Vehicle *v) {
+    for (int t = 0; t < NUM_CLIENT_TYPES; t++)
+        if (!v->conn[t] && !plugins[t])
+            return false;
+    return true;
+}
+
+/* State for the vehicle's in-process stages, created on first use and then kept. */
+void vehicle_init_plugins(Vehicle *v) {
+    for (int t = 0; t < NUM_CLIENT_TYPES; t++) {
+        const SimPlugin *p = plugins[t];
+        if (!p || v->plugin_state[t])
+            continue;
+        v->plugin_state[t] = calloc(1, p->state_size ? p->state_size : 1);
+        if (p->init)
+            p->init(v->plugin_state[t]);
+        if (t == CLIENT_ENGINE - 1 && engine_model)
+            ((EngineState *)v->plugin_state[t])->model = engine_model;
+        if (t == CLIENT_ENGINE - 1)
+            v->num_gears = (engine_model ? engine_model : vehicle_model_default())->num_gears;
+        if (t == CLIENT_ENGINE - 1 && engine_integrator_set) {
+            ((EngineState *)v->plugin_state[t])->integrator = engine_integrator.integrator;
+            ((EngineState *)v->plugin_state[t])->substeps = engine_integrator.substeps;
+        }
+    }
+}
+
+void vehicle_activate(Vehicle *v) {
+    v->active_idx = num_active;
+    active[num_active++] = v;
+    v->pending = 0;
+    checkpoint_ticking(v, true);
+
+    vehicle_init_plugins(v);
+
+    if (journal) {
+        if (!v->journal_rec)
+            v->journal_rec = malloc(sizeof(JournalRecord));
+        JournalRecord *r = v->journal_rec;
+        memset(r, 0, sizeof(*r));
+        r->kind     = JOURNAL_START;
+        r->vehicle  = (uint32_t)v->id;
+        r->tick     = v->ticks;
+        r->sim_time = v->sim_time;
+        r->car      = v->car;
+        journal_write(journal, r);
+    }
+
+    if (!in_process)
+        printf("Vehicle %d ready\n", v->id);
+
+    /* In-process lockstep is driven from the main loop instead. */
+    if (lockstep && !in_process)
+        vehicle_start_tick(v);
+}
+
+void vehicle_deactivate(Vehicle *v) {
+    if (v->active_idx < 0)
+        return;
+
+    Vehicle *last = active[--num_active];
+    active[v->active_idx] = last;
+    last->active_idx = v->active_idx;
+    v->active_idx = -1;
+    v->pending = 0;
+
+    if (v->finished) {
+        v->finished = false;
+        num_finished--;
+    } else {
+        checkpoint_ticking(v, false);
+    }
+    if (v->round_done) {
+        v->round_done = false;
+        round_done_count--;
+    }
+    if (lockstep && !in_process)
+        lockstep_round_check();     // the round may have been waiting for v
+}
+
+void conn_close(Conn *c) {
+    if (c->closed)
+        return;
+
+    Vehicle *v = c->veh;
+    if (v) {
+        vehicle_deactivate(v);
+        v->conn[c->type - 1] = NULL;
+        printf("Vehicle %d: client %d disconnected\n", v->id, c->type);
+    }
+
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+    if (c->shm) {
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, c->shm->rx_efd, NULL);
+        transport_close(c->shm);    // owns c->fd
+    } else {
+        close(c->fd);
+    }
+    c->closed = true;
+    c->next_closed = closed_conns;
+    closed_conns = c;
+}
+
+/* Free the connections closed since the last call. */
+void conn_reap() {
+    while (closed_conns) {
+        Conn *c = closed_conns;
+        closed_conns = c->next_closed;
+        free(c);
+    }
+}
+
+/* Queue a request; whatever the socket does not take now goes out on EPOLLOUT. */
+bool conn_send(Conn *c, const void *buf, size_t len) {
+    if (c->shm)
+        return transport_send(c->shm, buf, len);
+
+    if (c->tx_len > 0 || len > sizeof(c->tx))
+        return false;   // previous request still in flight: protocol error
+
+    ssize_t n = write(c->fd, buf, len);
+    if (n < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+            return false;
+        n = 0;
+    }
+
+    if ((size_t)n < len) {
+        memcpy(c->tx, (const char *)buf + n, len - (size_t)n);
+        c->tx_len = len - (size_t)n;
+        c->tx_off = 0;
+        epoll_mod(c, EPOLLIN | EPOLLOUT);
+    }
+    return true;
+}
+
+bool conn_flush(Conn *c) {
+    while (c->tx_off < c->tx_len) {
+        ssize_t n = write(c->fd, c->tx + c->tx_off, c->tx_len - c->tx_off);
+        if (n < 0)
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        c->tx_off += (size_t)n;
+    }
+
+    c->tx_len = c->tx_off = 0;
+    epoll_mod(c, EPOLLIN);
+    return true;
+}
+
+/* ---------------- CHECKPOINTS ---------------- */
+
+void vehicle_capture(const Vehicle *v) {
+    VehicleCheckpoint *c = &checkpoint_slots[v->id];
+
+    memset(c, 0, sizeof(*c));
+    c->vehicle         = (uint32_t)v->id;
+    c->ticks           = v->ticks;
+    c->sim_time        = v->sim_time;
+    c->last_shift_time = v->last_shift_time;
+    memcpy(c->stage_due,  v->stage_due,  sizeof(c->stage_due));
+    memcpy(c->stage_from, v->stage_from, sizeof(c->stage_from));
+    c->fuel_avg        = v->fuel_avg;
+    c->car             = v->car;
+}
+
+/* Every vehicle captured so far, each at its latest capture: written
+ * here, or handed to the background writer if `background`. */
+bool write_checkpoint(bool background) {
+    static VehicleCheckpoint out[MAX_VEHICLES];
+    uint32_t n = 0;
+
+    for (int i = 0; i < MAX_VEHICLES; i++)
+        if (vehicles[i].checkpointed)
+            out[n++] = checkpoint_slots[i];
+
+    CheckpointHeader h = { .tick_mode = (uint32_t)tick_mode, .dt = tick_period };
+    memcpy(h.stage_period, stage_period, sizeof(h.stage_period));
+    if (background) {
+        checkpoint_writer_submit(checkpoint_writer, &h, out, n);
+        return true;
+    }
+    if (!checkpoint_write(checkpoint_path, &h, out, n))
+        return false;
+    checkpoints_written++;
+    return true;
+}
+
+/*
+ * Periodic checkpoint: each vehicle is captured at the end of the first
+ * tick that reaches the checkpoint time, and the file is written once
+ * every vehicle still ticking has been.  Vehicles that reached --ticks or
+ * lost a client do not hold it up.  The write itself (two fsyncs and a
+ * rename) runs on the checkpoint writer's thread.
+ */
+void checkpoint_try_complete() {
+    if (checkpoint_captured == 0 || checkpoint_captured < num_active - num_finished)
+        return;
+    write_checkpoint(true);
+    checkpoint_gen++;
+    checkpoint_captured = 0;
+}
+
+void checkpoint_vehicle(Vehicle *v) {
+    vehicle_capture(v);
+    v->checkpointed = true;
+    v->checkpoint_gen = checkpoint_gen;
+
+    checkpoint_captured++;
+    checkpoint_try_complete();
+}
+
+/* v starts or stops ticking: it counts towards the periodic checkpoint
+ * only while it does. */
+void checkpoint_ticking(Vehicle *v, bool ticking) {
+    if (checkpoint_every <= 0.0)
+        return;
+    if (v->checkpoint_gen == checkpoint_gen)
+        checkpoint_captured += ticking ? 1 : -1;
+    if (!ticking)
+        checkpoint_try_complete();
+}
+
+/* Final checkpoint; a vehicle stopped mid-tick keeps its last periodic capture. */
+void checkpoint_at_exit() {
+    int mid_tick = 0;
+
+    /* Let a periodic write finish first, so it cannot land after this one */
+    if (checkpoint_writer)
+        checkpoints_written += checkpoint_writer_stop(checkpoint_writer);
+
+    for (int i = 0; i < MAX_VEHICLES; i++) {
+        Vehicle *v = &vehicles[i];
+        if (v->ticks == 0)
+            continue;
+        if (v->pending) {
+            mid_tick++;
+            continue;
+        }
+        vehicle_capture(v);
+        v->checkpointed = true;
+    }
+
+    if (write_checkpoint(false))
+        printf("Checkpoint: %u written to %s\n", checkpoints_written, checkpoint_path);
+    if (mid_tick)
+        printf("Checkpoint: %d vehicle(s) stopped mid-tick, saved as of their last "
+               "periodic checkpoint\n", mid_tick);
+}
+
+/*
+ * Put every vehicle in the checkpoint back where it was.  Stage state is
+ * kept only for stages still running at the same rate; a stage whose rate
+ * changed starts afresh, so a sweep can vary --stage-rate from one
+ * warm-up.  The tick period has to match.
+ */
+void restore_checkpoint(const char *path) {
+    CheckpointHeader h;
+    VehicleCheckpoint *cp = checkpoint_read(path, &h);
+    if (!cp)
+        exit(1);
+
+    if (h.dt != tick_period) {
+        fprintf(stderr, "%s was taken at dt %.6f s, not %.6f s: use the same --rate\n",
+                path, h.dt, tick_period);
+        exit(1);
+    }
+    if ((int)h.tick_mode != tick_mode)
+        printf("Note: %s was taken in %s mode\n", path,
+               h.tick_mode == TICK_PIPELINED ? "pipelined" : "sequential");
+
+    double earliest = -1.0;
+    for (uint32_t i = 0; i < h.count; i++) {
+        const VehicleCheckpoint *c = &cp[i];
+        if (c->vehicle >= MAX_VEHICLES)
+            continue;
+        Vehicle *v = &vehicles[c->vehicle];
+
+        v->ticks           = v->start_ticks = c->ticks;
+        v->sim_time        = v->start_time  = c->sim_time;
+        v->last_shift_time = c->last_shift_time;
+        v->car             = c->car;
+        v->car.shutdown    = false;
+        memcpy(v->stage_due,  c->stage_due,  sizeof(v->stage_due));
+        memcpy(v->stage_from, c->stage_from, sizeof(v->stage_from));
+        v->fuel_avg        = c->fuel_avg;
+
+        for (int t = 0; t < NUM_CLIENT_TYPES; t++) {
+            if (h.stage_period[t] == stage_period[t])
+                continue;
+            v->stage_due[t] = v->stage_from[t] = v->sim_time;
+            if (t == CLIENT_FUEL - 1)
+                memset(&v->fuel_avg, 0, sizeof(v->fuel_avg));
+        }
+
+        car_publish(v->shared, &v->car);
+        vehicle_capture(v);
+        v->checkpointed = true;
+        if (earliest < 0.0 || v->sim_time < earliest)
+            earliest = v->sim_time;
+    }
+
+    /* Carry on with the next checkpoint time after the restored one */
+    if (checkpoint_every > 0.0 && earliest > 0.0)
+        checkpoint_gen = (unsigned)(earliest / checkpoint_every + STAGE_TIME_EPSILON) + 1;
+
+    printf("Restored %u vehicle(s) from %s, resuming at t = %.3f s\n",
+           h.count, path, earliest < 0.0 ? 0.0 : earliest);
+    free(cp);
+}
+
+/* ---------------- TICK ---------------- */
+
+typedef union {
+    EngineStateIn  engine;
+    TransmissionIn transmission;
+    FuelIn         fuel;
+} Request;
+
+typedef union {
+    EngineStateOut  engine;
+    TransmissionOut transmission;
+    FuelOut         fuel;
+} Reply;
+
+_Static_assert(sizeof(Reply) <= RING_MSG_MAX, "replies must fit a shm ring slot");
+
+/* Fuel input from the engine outputs averaged since its last run. */
+void fill_fuel_in_averaged(Vehicle *v, FuelIn *fin) {
+    fill_fuel_in(&v->car, fin);
+
+    double t = v->fuel_avg.time;
+    if (t > 0.0) {
+        fin->throttle = v->fuel_avg.throttle / t;
+        fin->speed    = v->fuel_avg.speed / t;
+        fin->rpm      = (int)(v->fuel_avg.rpm / t);
+        fin->power    = v->fuel_avg.power / t;
+    }
+    memset(&v->fuel_avg, 0, sizeof(v->fuel_avg));
+}
+
+size_t build_request(Vehicle *v, int type, Request *req) {
+    /* The step this request covers: one tick, or for a slow stage
+     * everything since its last run up to the end of this tick. */
+    double sim_time = v->sim_time;
+    double dt = tick_period;
+    if (stage_period[type - 1] > 0.0) {
+        sim_time = v->stage_from[type - 1];
+        dt = v->sim_time + tick_period - sim_time;
+        v->stage_from[type - 1] = v->sim_time + tick_period;
+    }
+
+    if (type == CLIENT_ENGINE) {
+        fill_engine_in(&v->car, &req->engine);
+        req->engine.sim_time = sim_time;
+        req->engine.dt       = dt;
+        return sizeof(req->engine);
+    } else if (type == CLIENT_TRANSMISSION) {
+        fill_transmission_in(&v->car, &req->transmission);
+        req->transmission.last_shift_time = v->last_shift_time;
+        req->transmission.num_gears = v->num_gears;
+        req->transmission.sim_time = sim_time;
+        req->transmission.dt       = dt;
+        return sizeof(req->transmission);
+    } else {
+        if (stage_period[CLIENT_FUEL - 1] > 0.0)
+            fill_fuel_in_averaged(v, &req->fuel);
+        else
+            fill_fuel_in(&v->car, &req->fuel);
+        req->fuel.sim_time = sim_time;
+        req->fuel.dt       = dt;
+        return sizeof(req->fuel);
+    }
+}
+
+void vehicle_reply(Vehicle *v, int type, const void *reply);
+
+/*
+ * Hand a request to its client, or run the stage's plugin and handle the
+ * reply right away.  The caller has already marked it pending.  Returns
+ * false (with the connection closed) if the client is gone.
+ */
+bool dispatch(Vehicle *v, int type, const Request *req, size_t len) {
+    const SimPlugin *p = plugins[type - 1];
+
+    if (v->timed)
+        v->sent_ns[type - 1] = sched_now_ns();
+    if (journal)
+        memcpy(type == CLIENT_ENGINE       ? (void *)&v->journal_rec->engine_in :
+               type == CLIENT_TRANSMISSION ? (void *)&v->journal_rec->transmission_in :
+                                             (void *)&v->journal_rec->fuel_in, req, len);
+
+    if (p) {
+        void *state = v->plugin_state[type - 1];
+        if (type == CLIENT_ENGINE)
+            drive_script_at(driver_script, v->sim_time, &((EngineState *)state)->driver);
+
+        Reply reply;
+        p->step(state, req, &reply);
+        vehicle_reply(v, type, &reply);
+        return true;
+    }
+
+    Conn *c = v->conn[type - 1];
+    if (!conn_send(c, req, len)) {
+        conn_close(c);
+        return false;
+    }
+    return true;
+}
+
+bool send_request(Vehicle *v, int type) {
+    Request req;
+    size_t len = build_request(v, type, &req);
+
+    v->pending |= PENDING(type);
+    return dispatch(v, type, &req, len);
+}
+
+/* PENDING bits of the stages that run this tick; advances slow stages' deadlines. */
+unsigned stages_due(Vehicle *v) {
+    double tick_end = v->sim_time + tick_period + STAGE_TIME_EPSILON;
+    unsigned due = 0;
+
+    for (int t = 0; t < NUM_CLIENT_TYPES; t++) {
+        if (stage_period[t] == 0.0) {
+            due |= PENDING(t + 1);
+        } else if (v->stage_due[t] <= tick_end) {
+            due |= PENDING(t + 1);
+            while (v->stage_due[t] <= tick_end)
+                v->stage_due[t] += stage_period[t];
+        }
+    }
+    return due;
+}
+
+/* Next stage after `type` that runs this tick, 0 if none. */
+int next_stage(Vehicle *v, int type) {
+    for (int t = type + 1; t <= NUM_CLIENT_TYPES; t++)
+        if (v->stages & PENDING(t))
+            return t;
+    return 0;
+}
+
+/*
+ * In pipelined mode all inputs are built from the same (previous tick)
+ * state before anything is sent.  The replies touch disjoint fields
+ * (engine: motion/controls, transmission: gear, fuel: fuel), so applying
+ * them in arrival order gives the same result as any fixed order.
+ */
+void vehicle_start_tick(Vehicle *v) {
+    if (v->finished)
+        return;
+
+    if (v->pending) {
+        v->overruns++;
+        hist_add(&shm->stats.overruns, 1);
+        return;
+    }
+
+    v->timed = !in_process || v->ticks % IN_PROCESS_SAMPLE == 0;
+    if (v->timed)
+        v->tick_start_ns = sched_now_ns();
+
+    v->stages = stages_due(v);
+
+    if (journal) {
+        JournalRecord *r = v->journal_rec;
+        memset(r, 0, sizeof(*r));
+        r->kind     = JOURNAL_TICK;
+        r->vehicle  = (uint32_t)v->id;
+        r->tick     = v->ticks;
+        r->sim_time = v->sim_time;
+        r->stages   = v->stages;
+    }
+
+    if (tick_mode == TICK_PIPELINED) {
+        /* Build everything first: in-process stages complete immediately. */
+        Request req[NUM_CLIENT_TYPES];
+        size_t  len[NUM_CLIENT_TYPES];
+        for (int t = 0; t < NUM_CLIENT_TYPES; t++)
+            if (v->stages & PENDING(t + 1))
+                len[t] = build_request(v, t + 1, &req[t]);
+
+        v->pending = v->stages;
+        for (int t = 0; t < NUM_CLIENT_TYPES; t++)
+            if ((v->stages & PENDING(t + 1)) && !dispatch(v, t + 1, &req[t], len[t]))
                 break;
+    } else {
+        send_request(v, CLIENT_ENGINE);
+    }
+}
+
+void vehicle_end_tick(Vehicle *v, long long now) {
+    if (v->timed)
+        hist_record(&shm->stats.tick, now - v->tick_start_ns);
+
+    v->ticks++;
+    v->sim_time += tick_period;
+    car_publish(v->shared, &v->car);
+    if (telemetry)
+        telemetry_write(telemetry, v->id, v->ticks - 1, v->sim_time, &v->car);
+    if (recording)
+        recording_write(recording, v->id, v->sim_time, &v->car);
+    if (archive) {
+        TelemetryRecord row = { v->ticks - 1, v->sim_time, v->id, 0, v->car };
+        archive_append(archive, &row);
+    }
+    if (journal) {
+        v->journal_rec->car = v->car;
+        journal_write(journal, v->journal_rec);
+    }
+    if (checkpoint_every > 0.0 && v->checkpoint_gen < checkpoint_gen &&
+        v->sim_time >= checkpoint_gen * checkpoint_every - STAGE_TIME_EPSILON)
+        checkpoint_vehicle(v);
+
+    if (max_ticks && v->ticks >= max_ticks) {
+        v->finished = true;
+        if (++num_finished == num_active)
+            sigint_received = 1;    // batch run complete
+        checkpoint_ticking(v, false);
+        if (lockstep && !in_process)
+            lockstep_round_check();
+        return;
+    }
+
+    if (lockstep && !in_process) {
+        v->round_done = true;
+        round_done_count++;
+        lockstep_round_check();
+    }
+}
+
+void vehicle_reply(Vehicle *v, int type, const void *reply) {
+    /* Left over from before a sibling client reconnected: drop it. */
+    if (!(v->pending & PENDING(type))) {
+        hist_add(&shm->stats.stale, 1);
+        return;
+    }
+    v->pending &= ~PENDING(type);
+
+    long long now = 0;
+    if (v->timed) {
+        now = sched_now_ns();
+        hist_record(&shm->stats.stage[type - 1], now - v->sent_ns[type - 1]);
+    }
+
+    if (journal) {
+        JournalRecord *r = v->journal_rec;
+        if (type == CLIENT_ENGINE)
+            r->engine_out = *(const EngineStateOut *)reply;
+        else if (type == CLIENT_TRANSMISSION)
+            r->transmission_out = *(const TransmissionOut *)reply;
+        else
+            r->fuel_out = *(const FuelOut *)reply;
+    }
+
+    if (type == CLIENT_ENGINE) {
+        apply_engine_out(&v->car, reply);
+        v->num_gears = ((const EngineStateOut *)reply)->num_gears;
+
+        if (stage_period[CLIENT_FUEL - 1] > 0.0) {
+            v->fuel_avg.time     += tick_period;
+            v->fuel_avg.throttle += v->car.throttle * tick_period;
+            v->fuel_avg.speed    += v->car.speed * tick_period;
+            v->fuel_avg.rpm      += v->car.rpm * tick_period;
+            v->fuel_avg.power    += v->car.power * tick_period;
+        }
+    } else if (type == CLIENT_TRANSMISSION) {
+        apply_transmission_out(&v->car, reply);
+        v->last_shift_time = ((const TransmissionOut *)reply)->last_shift_time;
+    } else {
+        apply_fuel_out(&v->car, reply);
+    }
+
+    int next = next_stage(v, type);
+
+    /* The tick now ends in the next stage's reply (which may already have
+     * run, if that stage is in-process). */
+    if (tick_mode == TICK_SEQUENTIAL && next) {
+        send_request(v, next);
+        return;
+    }
+
+    if (!v->pending)
+        vehicle_end_tick(v, now);
+}
+
+/* A complete reply is in c->rx. */
+void handle_reply(Conn *c) {
+    vehicle_reply(c->veh, c->type, c->rx);
+}
+
+size_t reply_size(int type) {
+    switch (type) {
+    case CLIENT_ENGINE:       return sizeof(EngineStateOut);
+    case CLIENT_TRANSMISSION: return sizeof(TransmissionOut);
+    default:                  return sizeof(FuelOut);
+    }
+}
+
+/* ---------------- CONTACTS ---------------- */
+
+/*
+ * Every pair of active vehicles closer than --contact, once per tick
+ * round.  The hash grid is rebuilt from the current positions each time,
+ * which is linear in the vehicles; all-pairs would not be.
+ */
+void detect_contacts() {
+    long long start = sched_now_ns();
+    spatial_grid_build(contact_grid, round_x, round_y, num_active);
+    spatial_grid_pairs(contact_grid, contact_distance, &contact_pairs);
+    contact_ns += sched_now_ns() - start;
+
+    contact_checks++;
+    contact_total += contact_pairs.count;
+    if (contact_pairs.count > contact_peak)
+        contact_peak = contact_pairs.count;
+}
+
+/* ---------------- VIEWERS ---------------- */
+
+/* Pick up new subscriptions; a slot that changed hands starts afresh. */
+void scan_viewers() {
+    num_view_slots = 0;
+    for (int s = 0; s < MAX_VIEWERS; s++) {
+        ViewSlot *slot = &shm->views[s];
+        if (atomic_load_explicit(&slot->state, memory_order_acquire) != VIEW_ACTIVE) {
+            view_on[s] = false;
             continue;
         }
+        if (!view_on[s] || view_owner[s] != slot->owner) {
+            view_on[s] = true;
+            view_owner[s] = slot->owner;
+            view_filter_seq[s] = ~0u;
+            view_due[s] = view_clock;
+        }
+        view_slots[num_view_slots++] = s;
+    }
+}
 
-        int client_id;
-        if (read(client_fd, &client_id, sizeof(client_id)) <= 0) {
-            close(client_fd);
+static int by_id(const void *a, const void *b) {
+    return *(const int *)a - *(const int *)b;
+}
+
+static bool in_ids(const ViewFilter *f, int id) {
+    for (int k = 0; k < f->num_ids; k++)
+        if (f->ids[k] == id)
+            return true;
+    return false;
+}
+
+/* Ids of the active vehicles passing filter f, ascending, each once. */
+int view_matches(const ViewFilter *f, bool *grid_built, int *match) {
+    static int found[MAX_VEHICLES];
+    int n = 0;
+
+    if (f->flags & VIEW_REGION) {
+        if (!*grid_built) {
+            spatial_grid_build(view_grid, round_x, round_y, num_active);
+            *grid_built = true;
+        }
+        int k = spatial_grid_box(view_grid, f->x0, f->y0, f->x1, f->y1, found, MAX_VEHICLES);
+        for (int i = 0; i < k; i++) {
+            int id = active[found[i]]->id;
+            if (!(f->flags & VIEW_IDS) || in_ids(f, id))
+                match[n++] = id;
+        }
+    } else if (f->flags & VIEW_IDS) {
+        for (int k = 0; k < f->num_ids; k++) {
+            int id = f->ids[k];
+            if (id >= 0 && id < MAX_VEHICLES && vehicles[id].active_idx >= 0)
+                match[n++] = id;
+        }
+    } else {
+        for (int i = 0; i < num_active; i++)
+            match[n++] = active[i]->id;
+    }
+
+    qsort(match, n, sizeof(int), by_id);
+
+    /* A viewer may list an id twice */
+    int unique = 0;
+    for (int i = 0; i < n; i++)
+        if (unique == 0 || match[i] != match[unique - 1])
+            match[unique++] = match[i];
+    return unique;
+}
+
+/*
+ * Publish a frame to every subscription that is due.  Regions are looked
+ * up in a grid built at most once per round, so each viewer costs about
+ * the cells it covers and the vehicles it gets, not the whole fleet.
+ */
+void serve_viewers() {
+    static int match[MAX_VEHICLES];
+
+    unsigned claims = atomic_load_explicit(&shm->view_claims, memory_order_acquire);
+    if (claims != view_claims_seen) {
+        view_claims_seen = claims;
+        scan_viewers();
+    }
+
+    bool reap = view_clock >= view_reap_due;
+    if (reap)
+        view_reap_due = view_clock + VIEW_REAP_S;
+
+    long long start = sched_now_ns();
+    bool grid_built = false;
+    double now = num_active ? active[0]->sim_time : view_clock;
+
+    for (int k = 0; k < num_view_slots; k++) {
+        int s = view_slots[k];
+        ViewSlot *slot = &shm->views[s];
+
+        bool gone = atomic_load_explicit(&slot->state, memory_order_acquire) != VIEW_ACTIVE ||
+                    slot->owner != view_owner[s];
+        if (!gone && reap && kill(slot->owner, 0) < 0 && errno == ESRCH) {
+            atomic_store_explicit(&slot->state, VIEW_FREE, memory_order_release);
+            gone = true;
+        }
+        if (gone) {
+            view_on[s] = false;
+            view_slots[k--] = view_slots[--num_view_slots];
             continue;
         }
 
-        if (client_id == CLIENT_ENGINE) {
-            engine_fd = client_fd;
-            printf("Engine client connected\n");
-        } else if (client_id == CLIENT_TRANSMISSION) {
-            trans_fd = client_fd;
-            printf("Transmission client connected\n");
-        } else if (client_id == CLIENT_FUEL) {
-            fuel_fd = client_fd;
-            printf("Fuel client connected\n");
-        } else {
-            close(client_fd);
+        /* A filter caught mid-change is tried again next round; one left
+         * half-written by a dead viewer until the reaping above frees it.
+         * An invalid one is served nothing until the viewer replaces it */
+        unsigned seq = atomic_load_explicit(&slot->filter_seq, memory_order_acquire);
+        if (seq != view_filter_seq[s]) {
+            if (!view_copy_filter(slot, &view_filter[s])) {
+                view_filter_seq[s] = ~0u;
+                continue;
+            }
+            view_filter_seq[s] = seq;
+        }
+
+        const ViewFilter *f = &view_filter[s];
+        if (view_clock + STAGE_TIME_EPSILON < view_due[s])
+            continue;
+        if (f->rate > 0.0) {
+            view_due[s] += 1.0 / f->rate;
+            if (view_due[s] <= view_clock)
+                view_due[s] = view_clock + 1.0 / f->rate;
         }
+
+        int n = view_matches(f, &grid_built, match);
+        view_publish(slot, now, match, n);
+        view_frames++;
     }
+
+    view_ns += sched_now_ns() - start;
 }
 
+/* ---------------- TICK ROUNDS ---------------- */
 
-/* ---------------- MAIN ---------------- */
+/* Once per round of ticks, on the positions the vehicles have reached. */
+void tick_round_done() {
+    bool viewers = num_view_slots > 0 ||
+                   atomic_load_explicit(&shm->view_claims, memory_order_relaxed) != view_claims_seen;
 
-int main() {
-    struct sigaction sa;
-    memset(&sa, 0, sizeof(sa));
-    sa.sa_handler = handle_sigint;
-    sigemptyset(&sa.sa_mask);
-    sa.sa_flags = 0;
+    if (contact_grid || viewers) {
+        for (int i = 0; i < num_active; i++) {
+            round_x[i] = active[i]->car.x;
+            round_y[i] = active[i]->car.y;
+        }
+    }
+    if (contact_grid)
+        detect_contacts();
+    if (viewers)
+        serve_viewers();
+    view_clock += tick_period;
+}
 
-    sigaction(SIGINT, &sa, NULL);
+void tick_all() {
+    uint64_t expirations;
+    if (read(timer_fd, &expirations, sizeof(expirations)) < 0)
+        return;
 
+    sched_expired(&sched);
 
-    car = init_shared_memory();
-    server_fd = setup_server_socket();
+    /* Positions as of the replies so far, i.e. the end of the last tick */
+    tick_round_done();
 
-    printf("Server listening on port %d...\n", SERVER_PORT);
-    printf("All clients connecting started. Simulation started.\n");
+    for (int i = 0; i < num_active; i++)
+        vehicle_start_tick(active[i]);
 
-    accept_clients();
+    sched_arm_timerfd(&sched, timer_fd);
+}
 
-    // printf("All clients connected. Simulation started.\n");
+/*
+ * Lockstep with socket clients: each vehicle's next tick waits until every
+ * vehicle still ticking has finished the current one, so rounds work as
+ * with the timer.  A vehicle that joins mid-round starts its tick at once
+ * and the round waits for it too.  Ticks that complete without a client
+ * (a slow socket stage that is not due) can end the round from inside
+ * the loop; `starting` makes that the loop's job.
+ */
+void lockstep_round_check() {
+    static bool starting = false;
+    if (starting)
+        return;
+
+    starting = true;
+    while (round_done_count > 0 && round_done_count >= num_active - num_finished &&
+           !sigint_received) {
+        tick_round_done();
+        round_done_count = 0;
+        for (int i = 0; i < num_active; i++) {
+            Vehicle *v = active[i];
+            if (v->finished)
+                continue;
+            v->round_done = false;
+            vehicle_start_tick(v);
+            if (i < num_active && active[i] != v)
+                i--;    // v lost a client and was swapped out: revisit the slot
+        }
+    }
+    starting = false;
+}
 
-    while (!sigint_received) {
-        pthread_mutex_lock(&car->lock);
-        bool shutdown = car->shutdown;
-        pthread_mutex_unlock(&car->lock);
+/* Lockstep with every stage in-process: tick round-robin, keeping vehicles in step. */
+void run_lockstep_batch() {
+    for (int k = 0; k < LOCKSTEP_BATCH && !sigint_received; k++) {
+        for (int i = 0; i < num_active; i++)
+            vehicle_start_tick(active[i]);
+        tick_round_done();
+    }
+}
+
+/* ---------------- REPLAY ---------------- */
+
+/*
+ * Feed a journal's recorded requests (and the engine's recorded driver
+ * input) to the step plugins, as fast as they run, and check each reply
+ * and the resulting state against the recording bit for bit.  After a
+ * mismatch the vehicle continues from the recorded state, so every
+ * divergent tick is counted, not just the first.  Returns the exit status.
+ */
+int replay_journal(const char *path) {
+    Journal *j = journal_open(path);
+    if (!j)
+        return 1;
+
+    tick_period = j->header.dt;
+    printf("Replaying %s: %s ticks, dt %.4f s\n", path,
+           j->header.tick_mode == TICK_PIPELINED ? "pipelined" : "sequential", tick_period);
+
+    /* An in-process engine's settings come from the journal; the model
+     * can only be checked, so it must be given again. */
+    const JournalHeader *h = &j->header;
+    if (h->engine_known) {
+        static const char *const names[] = { "euler", "rk4", "analytic" };
+        const char *name = h->integrator <= INTEGRATOR_ANALYTIC ? names[h->integrator] : "?";
+        if (engine_integrator_set && (engine_integrator.integrator != (int)h->integrator ||
+                                      engine_integrator.substeps != (int)h->substeps)) {
+            fprintf(stderr, "%s: recorded with --integrator %s:%u\n", path, name, h->substeps);
+            journal_close(j);
+            return 1;
+        }
+        const VehicleModel *m = engine_model ? engine_model : vehicle_model_default();
+        if (vehicle_model_hash(m) != h->model_hash) {
+            fprintf(stderr, "%s: recorded with vehicle model \"%.*s\"; give the same --model\n",
+                    path, (int)sizeof(h->model_name), h->model_name);
+            journal_close(j);
+            return 1;
+        }
+        engine_integrator.integrator = (int)h->integrator;
+        engine_integrator.substeps   = (int)h->substeps;
+        engine_integrator_set = true;
+        printf("Engine: %s:%u, model \"%.*s\"\n", name, h->substeps,
+               (int)sizeof(h->model_name), h->model_name);
+    }
+
+    JournalRecord rec;
+    unsigned long ticks = 0, mismatches = 0;
+    long long start = sched_now_ns();
 
-        if (shutdown)
+    while (journal_read(j, &rec)) {
+        if (rec.vehicle >= MAX_VEHICLES) {
+            fprintf(stderr, "journal record %llu: bad vehicle %u\n",
+                    (unsigned long long)j->records, rec.vehicle);
+            mismatches++;
             break;
+        }
+        Vehicle *v = &vehicles[rec.vehicle];
+
+        if (rec.kind == JOURNAL_START) {
+            vehicle_init_plugins(v);
+            v->car      = rec.car;
+            v->sim_time = rec.sim_time;
+            continue;
+        }
+        ticks++;
+
+        const char *diff = NULL;
+        Reply reply;
+
+        if (rec.stages & PENDING(CLIENT_ENGINE)) {
+            EngineState *es = v->plugin_state[CLIENT_ENGINE - 1];
+            es->driver = rec.engine_out.driver;
+            plugins[CLIENT_ENGINE - 1]->step(es, &rec.engine_in, &reply);
+            if (!engine_out_same(&reply.engine, &rec.engine_out))
+                diff = "engine reply";
+            apply_engine_out(&v->car, &reply.engine);
+        }
+        if (rec.stages & PENDING(CLIENT_TRANSMISSION)) {
+            plugins[CLIENT_TRANSMISSION - 1]->step(v->plugin_state[CLIENT_TRANSMISSION - 1],
+                                                   &rec.transmission_in, &reply);
+            if (!diff && !transmission_out_same(&reply.transmission, &rec.transmission_out))
+                diff = "transmission reply";
+            apply_transmission_out(&v->car, &reply.transmission);
+        }
+        if (rec.stages & PENDING(CLIENT_FUEL)) {
+            plugins[CLIENT_FUEL - 1]->step(v->plugin_state[CLIENT_FUEL - 1],
+                                           &rec.fuel_in, &reply);
+            if (!diff && !fuel_out_same(&reply.fuel, &rec.fuel_out))
+                diff = "fuel reply";
+            apply_fuel_out(&v->car, &reply.fuel);
+        }
+        if (!diff && !car_same(&v->car, &rec.car))
+            diff = "state";
+
+        if (diff) {
+            if (mismatches < REPLAY_REPORT_MAX)
+                printf("Vehicle %u tick %llu (t = %.3f s): %s differs "
+                       "(speed %.17g, recorded %.17g)\n",
+                       rec.vehicle, (unsigned long long)rec.tick, rec.sim_time, diff,
+                       v->car.speed, rec.car.speed);
+            mismatches++;
+            v->car = rec.car;
+        }
+    }
 
-        /* ---------- ENGINE ---------- */
-        EngineStateIn ein;
+    double wall = (sched_now_ns() - start) / 1e9;
+    printf("Replayed %lu ticks in %.3f s (%.0f ticks/s): %s (%lu mismatched)\n",
+           ticks, wall, ticks / wall, mismatches ? "DIVERGED" : "bit-exact", mismatches);
 
-        pthread_mutex_lock(&car->lock);
-        ein.speed   = car->speed;
-        ein.fuel    = car->fuel;
-        ein.gear    = car->gear;
-        ein.heading = car->heading;
-        ein.x       = car->x;
-        ein.y       = car->y;
-        pthread_mutex_unlock(&car->lock);
+    journal_close(j);
+    return mismatches ? 1 : 0;
+}
 
-        write(engine_fd, &ein, sizeof(ein));
+/* ---------------- CLIENT ACCEPT ---------------- */
 
-        EngineStateOut eout;
-        read(engine_fd, &eout, sizeof(eout));
+void accept_clients(int listen_fd, int transport) {
+    for (;;) {
+        int client_fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK);
 
-        pthread_mutex_lock(&car->lock);
-        car->throttle = eout.throttle;
-        car->brake    = eout.brake;
-        car->steer    = eout.steer;
-        car->reverse  = eout.reverse;
+        if (client_fd < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                perror("accept");
+            return;
+        }
 
-        car->speed   = eout.speed;
-        car->heading = eout.heading;
-        car->x       = eout.x;
-        car->y       = eout.y;
+        if (transport == TRANSPORT_TCP) {
+            int one = 1;
+            setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        }
 
-        car->rpm     = eout.rpm;
-        car->power   = eout.power;
-        car->torque  = eout.torque;
+        Conn *c = calloc(1, sizeof(Conn));
+        c->fd = client_fd;
+        c->transport = transport;
+        c->sock_ref = (EpollRef){ REF_SOCKET, c };
+        c->bell_ref = (EpollRef){ REF_DOORBELL, c };
+        epoll_add(client_fd, EPOLLIN, &c->sock_ref);
+    }
+}
 
+/* First sizeof(int) bytes from a new connection. */
+void handle_handshake(Conn *c) {
+    int handshake;
+    memcpy(&handshake, c->rx, sizeof(handshake));
 
-        //checks  
-        if (car->speed < 0) car->speed = 0;
-        if (car->speed > 60.0) car->speed = 60.0;
+    int type = HANDSHAKE_TYPE(handshake);
+    int vid  = HANDSHAKE_VEHICLE(handshake);
 
-        if (car->rpm < 800) car->rpm = 800;
-        if (car->rpm > 6500) car->rpm = 6500;
-        pthread_mutex_unlock(&car->lock);
+    if (type < CLIENT_ENGINE || type > CLIENT_FUEL ||
+        vid < 0 || vid >= MAX_VEHICLES) {
+        conn_close(c);
+        return;
+    }
 
-        /* ---------- TRANSMISSION ---------- */
-        TransmissionIn tin;
+    Vehicle *v = &vehicles[vid];
+    if (plugins[type - 1]) {
+        fprintf(stderr, "Vehicle %d: client %d rejected, stage runs in-process\n", vid, type);
+        conn_close(c);
+        return;
+    }
+    if (v->conn[type - 1]) {
+        fprintf(stderr, "Vehicle %d: duplicate client %d rejected\n", vid, type);
+        conn_close(c);
+        return;
+    }
 
-        pthread_mutex_lock(&car->lock);
-        tin.client_id = CLIENT_TRANSMISSION;
-        tin.speed_mps = car->speed;
-        tin.gear      = car->gear;
-        tin.rpm       = car->rpm;
-        tin.reverse   = car->reverse;
-        tin.throttle  = car->throttle; 
-        pthread_mutex_unlock(&car->lock);
+    if (c->transport == TRANSPORT_SHM) {
+        c->shm = transport_shm_accept(c->fd);
+        if (!c->shm) {
+            conn_close(c);
+            return;
+        }
+        epoll_add(c->shm->rx_efd, EPOLLIN, &c->bell_ref);
+    }
 
-        write(trans_fd, &tin, sizeof(tin));
+    c->type = type;
+    c->veh  = v;
+    v->conn[type - 1] = c;
 
-        TransmissionOut tout;
-        read(trans_fd, &tout, sizeof(tout));
+    if (type == CLIENT_ENGINE)
+        printf("Vehicle %d: engine client connected\n", vid);
+    else if (type == CLIENT_TRANSMISSION)
+        printf("Vehicle %d: transmission client connected\n", vid);
+    else
+        printf("Vehicle %d: fuel client connected\n", vid);
 
-        pthread_mutex_lock(&car->lock);
-        car->gear = tout.updated_gear;
-        pthread_mutex_unlock(&car->lock);
+    if (vehicle_complete(v))
+        vehicle_activate(v);
+}
 
-        /* ---------- FUEL ---------- */
-        FuelIn fin;
+void handle_readable(Conn *c) {
+    if (c->shm) {
+        /* Nothing is sent on the socket after the handshake: this is EOF. */
+        char junk[64];
+        ssize_t n = read(c->fd, junk, sizeof(junk));
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR))
+            conn_close(c);
+        return;
+    }
 
-        pthread_mutex_lock(&car->lock);
-        fin.client_id   = CLIENT_FUEL;
-        fin.throttle    = car->throttle;
-        fin.speed       = car->speed;
-        fin.rpm         = (int)car->rpm;
-        fin.power       = car->power;
-        fin.current_fuel = car->fuel;
-        pthread_mutex_unlock(&car->lock);
+    for (;;) {
+        size_t want = c->type ? reply_size(c->type) : sizeof(int);
 
-        write(fuel_fd, &fin, sizeof(fin));
+        ssize_t n = read(c->fd, c->rx + c->rx_len, want - c->rx_len);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                conn_close(c);
+            return;
+        }
+        if (n == 0) {
+            conn_close(c);
+            return;
+        }
 
-        FuelOut fout;
-        read(fuel_fd, &fout, sizeof(fout));
+        c->rx_len += (size_t)n;
+        if (c->rx_len < want)
+            continue;
+        c->rx_len = 0;
 
-        pthread_mutex_lock(&car->lock);
-        car->fuel = fout.updated_fuel;
-        pthread_mutex_unlock(&car->lock);
+        if (!c->type) {
+            handle_handshake(c);
+            return;     // c may be closed; anything else waits for the next event
+        }
 
-        usleep((int)(DT * 1e6));
+        handle_reply(c);
+        if (c->closed)
+            return;     // the reply started a tick whose request failed
+    }
+}
+
+/* SHM clients ring this after pushing replies. */
+void handle_doorbell(Conn *c) {
+    transport_clear_doorbell(c->shm);
+
+    while (!c->closed && transport_try_recv(c->shm, c->rx, reply_size(c->type)))
+        handle_reply(c);
+}
+
+/* ---------------- OPTIONS ---------------- */
+
+void usage(const char *prog) {
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  -p, --pipelined   send to all clients at once; transmission and\n"
+        "                    fuel lag the engine by one tick\n"
+        "  -l, --lag N       0 = sequential (default), 1 = pipelined\n"
+        "  -r, --rate HZ     tick rate (default %.1f)\n"
+        "  -o, --overrun P   skip | catchup (default) | stretch\n"
+        "  -s, --lockstep    no pacing: tick as fast as the clients answer\n"
+        "  -n, --ticks N     stop once every vehicle has run N ticks\n"
+        "  -P, --plugin SO   run a stage in-process from a step library\n"
+        "                    (engine_step.so, transmission_step.so, fuel_step.so)\n"
+        "  -N, --vehicles N  with all three stages in-process: number of vehicles\n"
+        "  -S, --script F    drive script for in-process engines\n"
+        "  -m, --model F     vehicle model for in-process engines\n"
+        "  -I, --integrator NAME[:N]\n"
+        "                    euler (default), rk4 or analytic for in-process\n"
+        "                    engines, with N substeps per tick (default 1)\n"
+        "  -R, --stage-rate STAGE=HZ\n"
+        "                    run transmission or fuel at HZ (at most --rate)\n"
+        "  -T, --telemetry P record every tick to P.000.tlm, P.001.tlm, ...\n"
+        "  -M, --telemetry-mb N  rotate telemetry files at N MB (default %d)\n"
+        "  -A, --archive F   append every tick to compressed columnar archive F\n"
+        "  -D, --record F    record the drive to F for ./playback\n"
+        "  -K, --keyframe S  seconds between recording keyframes (default %.1f)\n"
+        "  -c, --checkpoint F  save the run's state to F at exit (and periodically\n"
+        "                    with -e); written atomically\n"
+        "  -e, --checkpoint-every S  also checkpoint every S s of sim time\n"
+        "  -w, --restore F   resume every vehicle in checkpoint F where it was\n"
+        "  -i, --session N   run as session N: own shm, port and socket\n"
+        "                    (default $SIM_SESSION, else 0)\n"
+        "  -C, --cpus LIST   pin the server to CPUs, e.g. 0-3,8\n"
+        "  -x, --contact M   count vehicle pairs closer than M metres every tick\n"
+        "  -j, --journal F   record every tick's requests and replies to F\n"
+        "  -J, --replay F    re-run journal F through the three --plugin stages\n"
+        "                    and check it reproduces bit for bit, then exit\n",
+        prog, 1.0 / DT, TELEMETRY_FILE_MB, RECORDING_KEYFRAME_S);
+}
+
+void parse_args(int argc, char **argv) {
+    static const struct option opts[] = {
+        { "pipelined", no_argument,       NULL, 'p' },
+        { "lag",       required_argument, NULL, 'l' },
+        { "rate",      required_argument, NULL, 'r' },
+        { "overrun",   required_argument, NULL, 'o' },
+        { "lockstep",  no_argument,       NULL, 's' },
+        { "ticks",     required_argument, NULL, 'n' },
+        { "plugin",    required_argument, NULL, 'P' },
+        { "vehicles",  required_argument, NULL, 'N' },
+        { "script",    required_argument, NULL, 'S' },
+        { "model",     required_argument, NULL, 'm' },
+        { "integrator", required_argument, NULL, 'I' },
+        { "stage-rate", required_argument, NULL, 'R' },
+        { "telemetry", required_argument, NULL, 'T' },
+        { "telemetry-mb", required_argument, NULL, 'M' },
+        { "archive",   required_argument, NULL, 'A' },
+        { "record",    required_argument, NULL, 'D' },
+        { "keyframe",  required_argument, NULL, 'K' },
+        { "checkpoint", required_argument, NULL, 'c' },
+        { "checkpoint-every", required_argument, NULL, 'e' },
+        { "restore",   required_argument, NULL, 'w' },
+        { "contact",   required_argument, NULL, 'x' },
+        { "journal",   required_argument, NULL, 'j' },
+        { "replay",    required_argument, NULL, 'J' },
+        { "session",   required_argument, NULL, 'i' },
+        { "cpus",      required_argument, NULL, 'C' },
+        { "help",      no_argument,       NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    int c;
+    while ((c = getopt_long(argc, argv, "pl:r:o:sn:P:N:S:m:I:R:T:M:A:D:K:c:e:w:x:j:J:i:C:h", opts, NULL)) != -1) {
+        switch (c) {
+        case 'p':
+            tick_mode = TICK_PIPELINED;
+            break;
+        case 'l':
+            if (atoi(optarg) == 0) {
+                tick_mode = TICK_SEQUENTIAL;
+            } else if (atoi(optarg) == 1) {
+                tick_mode = TICK_PIPELINED;
+            } else {
+                fprintf(stderr, "--lag must be 0 or 1\n");
+                exit(1);
+            }
+            break;
+        case 'r':
+            if (atof(optarg) <= 0.0) {
+                fprintf(stderr, "--rate must be positive\n");
+                exit(1);
+            }
+            tick_period = 1.0 / atof(optarg);
+            break;
+        case 'o':
+            overrun_policy = sched_parse_policy(optarg);
+            if (overrun_policy < 0) {
+                fprintf(stderr, "--overrun must be skip, catchup or stretch\n");
+                exit(1);
+            }
+            break;
+        case 's':
+            lockstep = true;
+            break;
+        case 'n':
+            max_ticks = strtoul(optarg, NULL, 10);
+            break;
+        case 'P': {
+            const SimPlugin *p = sim_plugin_load(optarg);
+            if (!p)
+                exit(1);
+            plugins[p->type - 1] = p;
+            break;
+        }
+        case 'N':
+            num_local_vehicles = atoi(optarg);
+            if (num_local_vehicles < 1 || num_local_vehicles > MAX_VEHICLES) {
+                fprintf(stderr, "--vehicles must be 1..%d\n", MAX_VEHICLES);
+                exit(1);
+            }
+            break;
+        case 'S':
+            driver_script = drive_script_load(optarg);
+            if (!driver_script)
+                exit(1);
+            break;
+        case 'm':
+            engine_model = vehicle_model_load(optarg);
+            if (!engine_model)
+                exit(1);
+            break;
+        case 'I':
+            if (!engine_integrator_parse(optarg, &engine_integrator)) {
+                fprintf(stderr, "--integrator must be euler, rk4 or analytic, "
+                                "optionally :N substeps (1..%d)\n", MAX_SUBSTEPS);
+                exit(1);
+            }
+            engine_integrator_set = true;
+            break;
+        case 'R': {
+            char *eq = strchr(optarg, '=');
+            int type = 0;
+            if (eq && strncmp(optarg, "transmission", eq - optarg) == 0)
+                type = CLIENT_TRANSMISSION;
+            else if (eq && strncmp(optarg, "fuel", eq - optarg) == 0)
+                type = CLIENT_FUEL;
+            if (!type || atof(eq + 1) <= 0.0) {
+                fprintf(stderr, "--stage-rate must be transmission=HZ or fuel=HZ "
+                                "(the engine runs at --rate)\n");
+                exit(1);
+            }
+            stage_rate[type - 1] = atof(eq + 1);
+            break;
+        }
+        case 'T':
+            telemetry_prefix = optarg;
+            break;
+        case 'A':
+            archive_path = optarg;
+            break;
+        case 'D':
+            recording_path = optarg;
+            break;
+        case 'K':
+            keyframe_interval = atof(optarg);
+            if (keyframe_interval <= 0.0) {
+                fprintf(stderr, "--keyframe must be positive\n");
+                exit(1);
+            }
+            break;
+        case 'c':
+            checkpoint_path = optarg;
+            break;
+        case 'e':
+            checkpoint_every = atof(optarg);
+            if (checkpoint_every <= 0.0) {
+                fprintf(stderr, "--checkpoint-every must be positive\n");
+                exit(1);
+            }
+            break;
+        case 'w':
+            restore_path = optarg;
+            break;
+        case 'i':
+            if (!session_set(optarg))
+                exit(1);
+            break;
+        case 'C':
+            if (!session_pin(optarg))
+                exit(1);
+            break;
+        case 'x':
+            contact_distance = atof(optarg);
+            if (contact_distance <= 0.0) {
+                fprintf(stderr, "--contact must be positive\n");
+                exit(1);
+            }
+            break;
+        case 'j':
+            journal_path = optarg;
+            break;
+        case 'J':
+            replay_path = optarg;
+            break;
+        case 'M':
+            if (atoi(optarg) < 1) {
+                fprintf(stderr, "--telemetry-mb must be at least 1\n");
+                exit(1);
+            }
+            telemetry_mb = (size_t)atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            exit(c == 'h' ? 0 : 1);
+        }
+    }
+
+    in_process = plugins[0] && plugins[1] && plugins[2];
+
+    if (replay_path) {
+        if (!in_process) {
+            fprintf(stderr, "--replay needs all three stages as --plugin\n");
+            exit(1);
+        }
+        return;
+    }
+
+    if (plugins[CLIENT_ENGINE - 1] && !driver_script) {
+        fprintf(stderr, "an in-process engine needs a --script\n");
+        exit(1);
+    }
+    for (int t = 0; t < NUM_CLIENT_TYPES; t++) {
+        if (!stage_rate[t])
+            continue;
+        if (1.0 / stage_rate[t] < tick_period - STAGE_TIME_EPSILON) {
+            fprintf(stderr, "--stage-rate cannot be faster than --rate (%.1f Hz)\n",
+                    1.0 / tick_period);
+            exit(1);
+        }
+        stage_period[t] = 1.0 / stage_rate[t];
+    }
+
+    if (engine_model && !plugins[CLIENT_ENGINE - 1]) {
+        fprintf(stderr, "--model needs the engine as --plugin\n");
+        exit(1);
+    }
+    if (checkpoint_every > 0.0 && !checkpoint_path) {
+        fprintf(stderr, "--checkpoint-every needs --checkpoint\n");
+        exit(1);
+    }
+    if (engine_integrator_set && !plugins[CLIENT_ENGINE - 1]) {
+        fprintf(stderr, "--integrator needs the engine as --plugin\n");
+        exit(1);
+    }
+    if (num_local_vehicles && !in_process) {
+        fprintf(stderr, "--vehicles needs all three stages as --plugin\n");
+        exit(1);
+    }
+    if (in_process && !num_local_vehicles)
+        num_local_vehicles = 1;
+}
+
+/* ---------------- MAIN ---------------- */
+
+int main(int argc, char **argv) {
+    parse_args(argc, argv);
+    if (replay_path)
+        return replay_journal(replay_path);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_sigint;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = 0;
+
+    sigaction(SIGINT, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    raise_fd_limit();
+
+    /* Claim the session's port before touching its shared memory, so a
+     * second server in a running session fails without clobbering it. */
+    server_fd = setup_server_socket();
+    shm_listen_fd = setup_shm_socket();
+
+    shm = init_shared_memory();
+    for (int i = 0; i < MAX_VEHICLES; i++) {
+        vehicles[i].id = i;
+        vehicles[i].active_idx = -1;
+        vehicles[i].shared = &shm->cars[i];
+        vehicles[i].last_shift_time = NEVER_SHIFTED;
+        car_read(vehicles[i].shared, &vehicles[i].car);
+    }
+    if (restore_path)
+        restore_checkpoint(restore_path);
+    if (checkpoint_every > 0.0) {
+        checkpoint_writer = checkpoint_writer_start(checkpoint_path);
+        if (!checkpoint_writer)
+            exit(1);
+    }
+
+    epoll_fd = epoll_create1(0);
+    epoll_add(server_fd, EPOLLIN, &tcp_listen_ref);
+    epoll_add(shm_listen_fd, EPOLLIN, &shm_listen_ref);
+
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    sched_init(&sched, tick_period, overrun_policy, &shm->sched);
+    if (!lockstep)
+        sched_arm_timerfd(&sched, timer_fd);
+    epoll_add(timer_fd, EPOLLIN, &timer_ref);
+
+    printf("Server listening on port %d and %s...\n", session_port(), session_socket_path());
+    printf("Tick mode: %s, dt %.4f s, %s\n",
+           tick_mode == TICK_PIPELINED ? "pipelined (1-tick lag)" : "sequential",
+           tick_period,
+           lockstep ? "lockstep" : sched_policy_name(overrun_policy));
+
+    static const char *stage_names[NUM_CLIENT_TYPES] = { "engine", "transmission", "fuel" };
+    for (int t = 0; t < NUM_CLIENT_TYPES; t++) {
+        if (plugins[t])
+            printf("Stage %s runs in-process\n", plugins[t]->name);
+        if (stage_rate[t])
+            printf("Stage %s runs at %.1f Hz\n", stage_names[t], stage_rate[t]);
+    }
+
+    if (telemetry_prefix) {
+        telemetry = telemetry_open(telemetry_prefix, telemetry_mb << 20, tick_period);
+        if (!telemetry)
+            exit(1);
+        printf("Recording telemetry to %s.*.tlm\n", telemetry_prefix);
+    }
+
+    if (archive_path) {
+        archive = archive_create(archive_path, tick_period);
+        if (!archive)
+            exit(1);
+        printf("Archiving telemetry to %s\n", archive_path);
+    }
+
+    if (recording_path) {
+        recording = recording_create(recording_path, tick_period, keyframe_interval);
+        if (!recording)
+            exit(1);
+        printf("Recording the drive to %s\n", recording_path);
+    }
+
+    if (contact_distance > 0.0) {
+        contact_grid = spatial_grid_create(contact_distance);
+        printf("Counting vehicles closer than %.1f m\n", contact_distance);
+    }
+
+    view_grid = spatial_grid_create(VIEW_GRID_CELL);
+
+    if (journal_path) {
+        JournalHeader settings = {
+            .tick_mode    = (uint32_t)tick_mode,
+            .engine_known = plugins[CLIENT_ENGINE - 1] != NULL,
+            .dt           = tick_period,
+            .integrator   = (uint32_t)engine_integrator.integrator,
+            .substeps     = (uint32_t)engine_integrator.substeps,
+        };
+        const VehicleModel *m = engine_model ? engine_model : vehicle_model_default();
+        settings.model_hash = vehicle_model_hash(m);
+        snprintf(settings.model_name, sizeof(settings.model_name), "%s", m->name);
+        journal = journal_create(journal_path, &settings);
+        if (!journal)
+            exit(1);
+        printf("Journaling to %s\n", journal_path);
+    }
+
+    run_start_ns = sched_now_ns();
+    printf("All clients connecting started. Simulation started.\n");
+
+    for (int i = 0; i < num_local_vehicles; i++)
+        vehicle_activate(&vehicles[i]);
+    if (in_process)
+        printf("%d in-process vehicles ready\n", num_local_vehicles);
+
+    bool batch = lockstep && in_process;
+    struct epoll_event events[MAX_EVENTS];
+
+    while (!sigint_received) {
+        if (batch)
+            run_lockstep_batch();
+
+        long long wait_start = sched_now_ns();
+        int n = epoll_wait(epoll_fd, events, MAX_EVENTS, batch ? 0 : -1);
+        if (!batch)
+            hist_record(&shm->stats.wait, sched_now_ns() - wait_start);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("epoll_wait");
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            EpollRef *ref = events[i].data.ptr;
+            Conn *c = ref->conn;
+            if (c && c->closed)
+                continue;       // closed earlier in this batch
+
+            switch (ref->kind) {
+            case REF_TCP_LISTEN:
+                accept_clients(server_fd, TRANSPORT_TCP);
+                break;
+            case REF_SHM_LISTEN:
+                accept_clients(shm_listen_fd, TRANSPORT_SHM);
+                break;
+            case REF_TIMER:
+                tick_all();
+                break;
+            case REF_DOORBELL:
+                handle_doorbell(c);
+                break;
+            case REF_SOCKET:
+                if ((events[i].events & EPOLLOUT) && !conn_flush(c)) {
+                    conn_close(c);
+                    break;
+                }
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                    handle_readable(c);
+                break;
+            }
+        }
+        conn_reap();
     }
     printf("\nServer shutting down cleanly...\n");
 
-    /* Notify monitor */
-    pthread_mutex_lock(&car->lock);
-    car->shutdown = true;
-    pthread_mutex_unlock(&car->lock);
+    double wall = (sched_now_ns() - run_start_ns) / 1e9;
+    unsigned long total_ticks = 0;
+    for (int i = 0; i < MAX_VEHICLES; i++) {
+        Vehicle *v = &vehicles[i];
+        if (v->ticks == v->start_ticks)
+            continue;
+        total_ticks += v->ticks - v->start_ticks;
+        printf("Vehicle %d: %lu ticks, %.2f s simulated (%.1fx real time), %lu overruns, "
+               "at (%.2f, %.2f) with %.2f L\n",
+               v->id, v->ticks, v->sim_time, (v->sim_time - v->start_time) / wall, v->overruns,
+               v->car.x, v->car.y, v->car.fuel);
+    }
+    printf("Total: %lu vehicle ticks in %.2f s (%.0f ticks/s)\n",
+           total_ticks, wall, total_ticks / wall);
+
+    for (int t = 0; t < NUM_STAGES; t++) {
+        const LatencyHist *h = &shm->stats.stage[t];
+        if (atomic_load(&h->count))
+            printf("  %-12s p50 %.1f us  p99 %.1f us  max %.1f us\n", stage_names[t],
+                   hist_quantile(h, 0.50) / 1e3, hist_quantile(h, 0.99) / 1e3,
+                   atomic_load(&h->max_ns) / 1e3);
+    }
 
-    
-    if (server_fd >= 0) close(server_fd);
-    if (engine_fd >= 0) close(engine_fd);
-    if (trans_fd  >= 0) close(trans_fd);
-    if (fuel_fd   >= 0) close(fuel_fd);
+    if (contact_checks)
+        printf("Contacts: %.1f pairs per tick on average, at most %zu, over %lu ticks "
+               "(%.2f us per check)\n",
+               (double)contact_total / contact_checks, contact_peak, contact_checks,
+               contact_ns / 1e3 / contact_checks);
+
+    if (view_frames)
+        printf("Viewers: %lu frames published, %.2f us per frame\n",
+               view_frames, view_ns / 1e3 / view_frames);
+
+    if (checkpoint_path)
+        checkpoint_at_exit();
 
-    shm_unlink(SHM_NAME);
+    if (journal) {
+        printf("Journal: %llu records\n", (unsigned long long)journal->records);
+        journal_close(journal);
+    }
+    if (archive) {
+        archive_flush(archive);
+        printf("Archive: %llu rows in %llu blocks, %.1f bytes per row\n",
+               (unsigned long long)archive->rows, (unsigned long long)archive->blocks,
+               archive->rows ? (double)archive->bytes / archive->rows : 0.0);
+        archive_close(archive);
+    }
+    if (recording) {
+        printf("Recording: %zu keyframes, %llu deltas\n",
+               recording->index_count, (unsigned long long)recording->deltas);
+        recording_close(recording);
+    }
+    if (telemetry) {
+        printf("Telemetry: %llu records in %u file(s)\n",
+               (unsigned long long)telemetry->total, telemetry->sequence + 1);
+        telemetry_close(telemetry);
+    }
+
+    /* Notify monitors */
+    for (int i = 0; i < MAX_VEHICLES; i++) {
+        vehicles[i].car.shutdown = true;
+        car_publish(vehicles[i].shared, &vehicles[i].car);
+    }
+
+
+    if (server_fd >= 0) close(server_fd);
+    if (shm_listen_fd >= 0) close(shm_listen_fd);
+    if (timer_fd  >= 0) close(timer_fd);
+    for (int i = 0; i < MAX_VEHICLES; i++) {
+        for (int t = 0; t < NUM_CLIENT_TYPES; t++) {
+            Conn *c = vehicles[i].conn[t];
+            if (c)
+                conn_close(c);
+        }
+    }
+    conn_reap();
+    if (epoll_fd  >= 0) close(epoll_fd);
+
+    for (int i = 0; i < MAX_VEHICLES; i++)
+        for (int t = 0; t < NUM_CLIENT_TYPES; t++)
+            free(vehicles[i].plugin_state[t]);
+    for (int i = 0; i < MAX_VEHICLES; i++)
+        free(vehicles[i].journal_rec);
+    drive_script_free(driver_script);
+    vehicle_model_free(engine_model);
+    spatial_grid_free(contact_grid);
+    spatial_grid_free(view_grid);
+    spatial_pairs_free(&contact_pairs);
+
+    shm_unlink(session_shm_name());
+    unlink(session_socket_path());
 
 
     return 0;
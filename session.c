@@ -0,0 +1,113 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+
+#include "session.h"
+#include "common.h"
+#include "protocol.h"
+#include "transport.h"
+
+static int  session = -1;       // -1 until set or read from the environment
+static char shm_name[64];
+static char socket_path[108];
+
+static bool parse_id(const char *s, int *id) {
+    char *end;
+    long v = strtol(s, &end, 10);
+    if (*s == '\0' || *end != '\0' || v < 0 || v > MAX_SESSION)
+        return false;
+    *id = (int)v;
+    return true;
+}
+
+static void name_session(int id) {
+    session = id;
+    if (id == 0) {
+        snprintf(shm_name, sizeof(shm_name), "%s", SHM_NAME);
+        snprintf(socket_path, sizeof(socket_path), "%s", SHM_SOCKET_PATH);
+    } else {
+        snprintf(shm_name, sizeof(shm_name), "%s.%d", SHM_NAME, id);
+        snprintf(socket_path, sizeof(socket_path), "/tmp/car_sim.%d.sock", id);
+    }
+}
+
+bool session_set(const char *arg) {
+    int id;
+    if (!parse_id(arg, &id)) {
+        fprintf(stderr, "session must be 0..%d\n", MAX_SESSION);
+        return false;
+    }
+    name_session(id);
+    return true;
+}
+
+int session_id() {
+    if (session < 0) {
+        const char *env = getenv(SESSION_ENV);
+        int id = 0;
+        if (env && !parse_id(env, &id))
+            fprintf(stderr, "%s: ignoring \"%s\", using session 0\n", SESSION_ENV, env);
+        name_session(id);
+    }
+    return session;
+}
+
+const char *session_shm_name() {
+    session_id();
+    return shm_name;
+}
+
+int session_port() {
+    return SERVER_PORT + session_id();
+}
+
+const char *session_socket_path() {
+    session_id();
+    return socket_path;
+}
+
+/* ---------------- CPU PINNING ---------------- */
+
+/* "0-3,8" -> set; false if malformed or empty */
+static bool parse_cpus(const char *p, cpu_set_t *set) {
+    CPU_ZERO(set);
+    while (*p) {
+        char *end;
+        long lo = strtol(p, &end, 10), hi = lo;
+        if (end == p)
+            return false;
+        if (*end == '-') {
+            p = end + 1;
+            hi = strtol(p, &end, 10);
+            if (end == p)
+                return false;
+        }
+        if (lo < 0 || hi < lo || hi >= CPU_SETSIZE)
+            return false;
+        for (long c = lo; c <= hi; c++)
+            CPU_SET(c, set);
+
+        p = end;
+        if (*p == ',')
+            p++;
+        else if (*p)
+            return false;
+    }
+    return CPU_COUNT(set) > 0;
+}
+
+bool session_pin(const char *cpus) {
+    cpu_set_t set;
+    if (!parse_cpus(cpus, &set)) {
+        fprintf(stderr, "bad CPU list \"%s\" (want e.g. 0-3,8)\n", cpus);
+        return false;
+    }
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+        perror("sched_setaffinity");
+        return false;
+    }
+    return true;
+}
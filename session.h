@@ -0,0 +1,39 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <stdbool.h>
+
+/*
+ * Simulation sessions: independent simulations side by side on one host.
+ *
+ * Everything a server and its clients meet on is named after the session
+ * number, set with -i/--session N or $SIM_SESSION:
+ *
+ *   shared memory    SHM_NAME           SHM_NAME.N
+ *   TCP port         SERVER_PORT        SERVER_PORT + N
+ *   unix socket      SHM_SOCKET_PATH    /tmp/car_sim.N.sock
+ *
+ * Session 0 (the default) keeps the original names.  The shared memory
+ * segment carries the session's metrics (SimShared.sched/stats) too, so
+ * a monitor started in the same session sees only its own run.
+ */
+
+#define SESSION_ENV "SIM_SESSION"
+#define MAX_SESSION 50000       // SERVER_PORT + N must stay a port number
+
+/* From a -i/--session argument; false (with a message) if not 0..MAX_SESSION. */
+bool session_set(const char *arg);
+
+int         session_id();       // -i if given, else $SIM_SESSION, else 0
+const char *session_shm_name();
+int         session_port();
+const char *session_socket_path();
+
+/*
+ * Pin the calling process to a CPU list such as "0-3,8" (-C/--cpus):
+ * threads it starts afterwards inherit it.  false (with a message) if the
+ * list is malformed or the kernel refuses it.
+ */
+bool session_pin(const char *cpus);
+
+#endif
@@ -0,0 +1,47 @@
+#include <stdio.h>
+#include <dlfcn.h>
+
+#include "sim_plugin.h"
+
+static const char *symbols[] = {
+    ENGINE_PLUGIN_SYMBOL,
+    TRANSMISSION_PLUGIN_SYMBOL,
+    FUEL_PLUGIN_SYMBOL,
+};
+
+static const size_t in_sizes[] = {
+    sizeof(EngineStateIn), sizeof(TransmissionIn), sizeof(FuelIn),
+};
+
+static const size_t out_sizes[] = {
+    sizeof(EngineStateOut), sizeof(TransmissionOut), sizeof(FuelOut),
+};
+
+const SimPlugin *sim_plugin_load(const char *path) {
+    void *lib = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (!lib) {
+        fprintf(stderr, "%s\n", dlerror());
+        return NULL;
+    }
+
+    const SimPlugin *p = NULL;
+    for (int i = 0; i < 3 && !p; i++)
+        p = dlsym(lib, symbols[i]);
+
+    if (!p) {
+        fprintf(stderr, "%s: no step plugin descriptor\n", path);
+    } else if (p->abi != SIM_PLUGIN_ABI) {
+        fprintf(stderr, "%s: plugin ABI %d, expected %d\n", path, p->abi, SIM_PLUGIN_ABI);
+        p = NULL;
+    } else if (p->type < CLIENT_ENGINE || p->type > CLIENT_FUEL ||
+               p->in_size != in_sizes[p->type - 1] ||
+               p->out_size != out_sizes[p->type - 1]) {
+        fprintf(stderr, "%s: message layout does not match this build\n", path);
+        p = NULL;
+    }
+
+    /* The library stays loaded for the life of the process. */
+    if (!p)
+        dlclose(lib);
+    return p;
+}
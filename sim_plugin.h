@@ -0,0 +1,143 @@
+#ifndef SIM_PLUGIN_H
+#define SIM_PLUGIN_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "protocol.h"
+#include "drive_script.h"
+#include "vehicle_model.h"
+
+/*
+ * Step ABI shared by the socket clients and the server's in-process mode.
+ *
+ * Each subsystem's logic is one step function: wire request in, wire reply
+ * out, plus an explicit per-vehicle state block owned by the caller.  No
+ * globals, no I/O, no clocks - the request carries sim_time and dt.
+ *
+ * engine_step.c, transmission_step.c and fuel_step.c are linked straight
+ * into their socket clients and also built as shared objects, each
+ * exporting one SimPlugin descriptor that the server finds with dlopen.
+ * Bump SIM_PLUGIN_ABI whenever a descriptor, state block or wire struct
+ * changes layout.
+ */
+
+#define SIM_PLUGIN_ABI 5
+
+typedef struct {
+    int         abi;            // SIM_PLUGIN_ABI
+    int         type;           // CLIENT_*
+    const char *name;
+
+    size_t      state_size;     // per-vehicle state, zeroed by the host
+    size_t      in_size;        // wire structs it was built against
+    size_t      out_size;
+
+    void (*init)(void *state);  // may be NULL
+    void (*step)(void *state, const void *in, void *out);
+} SimPlugin;
+
+/* Exported descriptor names, one per subsystem. */
+#define ENGINE_PLUGIN_SYMBOL       "engine_plugin"
+#define TRANSMISSION_PLUGIN_SYMBOL "transmission_plugin"
+#define FUEL_PLUGIN_SYMBOL         "fuel_plugin"
+
+/* The descriptors themselves, for programs that link the step files in. */
+extern const SimPlugin engine_plugin;
+extern const SimPlugin transmission_plugin;
+extern const SimPlugin fuel_plugin;
+
+/* ---------------- ENGINE ---------------- */
+
+/*
+ * Integrators for EngineState.integrator.  Each step is split into
+ * `substeps` equal parts, and the engine's torque is looked up again at the
+ * start of each.
+ *
+ *   INTEGRATOR_EULER     semi-implicit Euler: speed, then heading and
+ *                        position from the new speed.  With one substep
+ *                        this is the original step, bit for bit, and what
+ *                        fleet_step() mirrors.
+ *   INTEGRATOR_RK4       classic fourth-order Runge-Kutta on speed and
+ *                        position, the torque map read at every stage.
+ *   INTEGRATOR_ANALYTIC  closed form: constant decelerations exactly, and
+ *                        driving as dv/dt = a - k v with the torque map's
+ *                        local slope folded into k, which is exact until
+ *                        the rpm leaves its table cell.
+ *
+ * Steering and centering turn at constant rates, so RK4 and the analytic
+ * integrator take the heading in closed form and position along the arc.
+ *
+ * The original step reports rpm, torque and power as they were at its
+ * start.  Any other configuration reports them at the end, so the
+ * transmission shifts on the rpm the car has reached rather than the one
+ * it had a tick ago.  integrator_bench reports each configuration's error
+ * against a 1 kHz reference.
+ */
+#define INTEGRATOR_EULER    0
+#define INTEGRATOR_RK4      1
+#define INTEGRATOR_ANALYTIC 2
+#define MAX_SUBSTEPS        64
+
+/* Configuration, not simulation state: the reverse latch is in the messages */
+typedef struct {
+    DriverInput         driver;     // set by the host before every step
+    const VehicleModel *model;      // owned by the host; engine_init picks the default
+    int                 integrator; // INTEGRATOR_*
+    int                 substeps;   // per step, 1 .. MAX_SUBSTEPS; 0 counts as 1
+} EngineState;
+
+/* "euler", "rk4" or "analytic", optionally ":N" substeps, into st; false
+ * (st untouched) if malformed. */
+static inline bool engine_integrator_parse(const char *spec, EngineState *st) {
+    static const char *const names[] = { "euler", "rk4", "analytic" };
+    const char *colon = strchr(spec, ':');
+    size_t len = colon ? (size_t)(colon - spec) : strlen(spec);
+    int substeps = colon ? atoi(colon + 1) : 1;
+
+    if (substeps < 1 || substeps > MAX_SUBSTEPS)
+        return false;
+    for (int i = 0; i < 3; i++) {
+        if (strlen(names[i]) == len && strncmp(spec, names[i], len) == 0) {
+            st->integrator = i;
+            st->substeps = substeps;
+            return true;
+        }
+    }
+    return false;
+}
+
+void engine_init(EngineState *st);
+void engine_step(EngineState *st, const EngineStateIn *in, EngineStateOut *out);
+
+/* ---------------- TRANSMISSION ---------------- */
+
+/* Shift schedule; transmission_step runs the built-in one */
+typedef struct {
+    double upshift_rpm;
+    double downshift_rpm;
+    double cooldown;            // s after a shift before the next
+} ShiftParams;
+
+const ShiftParams *transmission_default_params();
+void transmission_shift(const ShiftParams *p, const TransmissionIn *in, TransmissionOut *out);
+void transmission_step(const TransmissionIn *in, TransmissionOut *out);
+
+/* ---------------- FUEL ---------------- */
+
+typedef struct {
+    double engine_efficiency;   // fuel energy to engine power
+} FuelParams;
+
+const FuelParams *fuel_default_params();
+void fuel_burn(const FuelParams *p, const FuelIn *in, FuelOut *out);
+void fuel_step(const FuelIn *in, FuelOut *out);
+
+/* ---------------- LOADING ---------------- */
+
+/* dlopen a step library; NULL (with a message) if it is not a compatible one. */
+const SimPlugin *sim_plugin_load(const char *path);
+
+#endif
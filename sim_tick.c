@@ -0,0 +1,90 @@
+#include "sim_tick.h"
+
+/* ---------------- STATE <-> MESSAGES ---------------- */
+
+void fill_engine_in(const CarSnapshot *car, EngineStateIn *ein) {
+    ein->speed   = car->speed;
+    ein->fuel    = car->fuel;
+    ein->gear    = car->gear;
+    ein->heading = car->heading;
+    ein->x       = car->x;
+    ein->y       = car->y;
+    ein->reverse = car->reverse;
+}
+
+void apply_engine_out(CarSnapshot *car, const EngineStateOut *eout) {
+    car->throttle = eout->throttle;
+    car->brake    = eout->brake;
+    car->steer    = eout->steer;
+    car->reverse  = eout->reverse;
+
+    car->speed   = eout->speed;
+    car->heading = eout->heading;
+    car->x       = eout->x;
+    car->y       = eout->y;
+
+    car->rpm     = eout->rpm;
+    car->power   = eout->power;
+    car->torque  = eout->torque;
+
+
+    //checks
+    if (car->speed < 0) car->speed = 0;
+    if (car->speed > 60.0) car->speed = 60.0;
+
+    if (car->rpm < 800) car->rpm = 800;
+    if (car->rpm > 6500) car->rpm = 6500;
+}
+
+void fill_transmission_in(const CarSnapshot *car, TransmissionIn *tin) {
+    tin->client_id = CLIENT_TRANSMISSION;
+    tin->speed_mps = car->speed;
+    tin->gear      = car->gear;
+    tin->rpm       = car->rpm;
+    tin->reverse   = car->reverse;
+    tin->throttle  = car->throttle;
+}
+
+void apply_transmission_out(CarSnapshot *car, const TransmissionOut *tout) {
+    car->gear = tout->updated_gear;
+}
+
+void fill_fuel_in(const CarSnapshot *car, FuelIn *fin) {
+    fin->client_id   = CLIENT_FUEL;
+    fin->throttle    = car->throttle;
+    fin->speed       = car->speed;
+    fin->rpm         = (int)car->rpm;
+    fin->power       = car->power;
+    fin->current_fuel = car->fuel;
+}
+
+void apply_fuel_out(CarSnapshot *car, const FuelOut *fout) {
+    car->fuel = fout->updated_fuel;
+}
+
+/* ---------------- SEQUENTIAL TICK ---------------- */
+
+void sim_tick(const SimStages *s, CarSnapshot *car, double *last_shift_time,
+              double sim_time, double dt) {
+    EngineStateIn ein = { .sim_time = sim_time, .dt = dt };
+    EngineStateOut eout;
+    fill_engine_in(car, &ein);
+    s->step[CLIENT_ENGINE - 1](s->state[CLIENT_ENGINE - 1], &ein, &eout);
+    apply_engine_out(car, &eout);
+
+    TransmissionIn tin = {
+        .last_shift_time = *last_shift_time, .num_gears = eout.num_gears,
+        .sim_time = sim_time, .dt = dt,
+    };
+    TransmissionOut tout;
+    fill_transmission_in(car, &tin);
+    s->step[CLIENT_TRANSMISSION - 1](s->state[CLIENT_TRANSMISSION - 1], &tin, &tout);
+    apply_transmission_out(car, &tout);
+    *last_shift_time = tout.last_shift_time;
+
+    FuelIn fin = { .sim_time = sim_time, .dt = dt };
+    FuelOut fout;
+    fill_fuel_in(car, &fin);
+    s->step[CLIENT_FUEL - 1](s->state[CLIENT_FUEL - 1], &fin, &fout);
+    apply_fuel_out(car, &fout);
+}
@@ -0,0 +1,32 @@
+#ifndef SIM_TICK_H
+#define SIM_TICK_H
+
+#include "common.h"
+#include "sim_plugin.h"
+
+/*
+ * The car's state to and from the step messages, and the sequential tick
+ * built on them: engine, then transmission on the engine's result, then
+ * fuel.  The server goes through the same fill and apply functions for
+ * each stage it dispatches, so the benches and the sweep tick exactly as
+ * the server does.
+ */
+
+void fill_engine_in(const CarSnapshot *car, EngineStateIn *ein);
+void apply_engine_out(CarSnapshot *car, const EngineStateOut *eout);   // clamps speed and rpm
+void fill_transmission_in(const CarSnapshot *car, TransmissionIn *tin);
+void apply_transmission_out(CarSnapshot *car, const TransmissionOut *tout);
+void fill_fuel_in(const CarSnapshot *car, FuelIn *fin);
+void apply_fuel_out(CarSnapshot *car, const FuelOut *fout);
+
+/* A step function and its state for each stage, indexed by CLIENT_* - 1. */
+typedef struct {
+    void (*step[3])(void *state, const void *in, void *out);
+    void  *state[3];
+} SimStages;
+
+/* One tick of dt from sim_time; last_shift_time is the transmission's. */
+void sim_tick(const SimStages *s, CarSnapshot *car, double *last_shift_time,
+              double sim_time, double dt);
+
+#endif
@@ -0,0 +1,339 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "simlog.h"
+
+#define SIMLOG_RING_SIZE 8192               // records, power of two
+#define SIMLOG_RING_MASK (SIMLOG_RING_SIZE - 1)
+#define SIMLOG_FLUSH_NS  50000000L          // writer wakes every 50 ms
+#define SIMLOG_STDOUT_BUF (1 << 16)
+
+/* Flags, width and precision of a conversion ('*' is not supported). */
+#define SPEC_FLAGS "-+ #0123456789."
+
+/* ---------------- RECORDS ---------------- */
+
+typedef union {
+    long long   i;
+    double      d;
+    const char *s;
+} SimLogArg;
+
+typedef struct {
+    const char *fmt;
+    long long   ts_ns;
+    int         level;
+    int         nargs;
+    SimLogArg   args[SIMLOG_MAX_ARGS];
+} SimLogRecord;
+
+/* Single producer, single consumer: head is the logging thread's, tail the writer's. */
+static SimLogRecord ring[SIMLOG_RING_SIZE];
+static _Alignas(64) atomic_ulong head;
+static _Alignas(64) atomic_ulong tail;
+
+static atomic_int  min_level = SIMLOG_INFO;
+static atomic_uint rate_limit = 0;
+static atomic_bool changes_only = false;
+static atomic_bool show_time = false;
+
+static atomic_ulong dropped_full;
+static atomic_ulong dropped_rate;
+
+/* Rate window, touched by the logging thread only */
+static long long window_start_ns;
+static unsigned  window_count;
+
+static long long start_ns;
+static pthread_t writer_thread;
+static bool      writer_running = false;
+static atomic_bool stopping = false;
+
+static const char *level_names[] = { "trace", "debug", "info", "warn", "error", "off" };
+
+static long long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* ---------------- CONFIGURATION ---------------- */
+
+void simlog_set_level(int level) {
+    atomic_store_explicit(&min_level, level, memory_order_relaxed);
+}
+
+void simlog_set_rate(unsigned per_second) {
+    atomic_store_explicit(&rate_limit, per_second, memory_order_relaxed);
+}
+
+void simlog_set_changes_only(bool on) {
+    atomic_store_explicit(&changes_only, on, memory_order_relaxed);
+}
+
+bool simlog_enabled(int level) {
+    return level >= atomic_load_explicit(&min_level, memory_order_relaxed);
+}
+
+bool simlog_configure(const char *spec) {
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%s", spec);
+
+    for (char *save, *item = strtok_r(buf, ",", &save); item;
+         item = strtok_r(NULL, ",", &save)) {
+        char *value = strchr(item, '=');
+        if (!value)
+            return false;
+        *value++ = '\0';
+
+        if (strcmp(item, "level") == 0) {
+            int level = -1;
+            for (int i = SIMLOG_TRACE; i <= SIMLOG_OFF; i++)
+                if (strcmp(value, level_names[i]) == 0)
+                    level = i;
+            if (level < 0)
+                return false;
+            simlog_set_level(level);
+        } else if (strcmp(item, "rate") == 0) {
+            simlog_set_rate((unsigned)strtoul(value, NULL, 10));
+        } else if (strcmp(item, "changes") == 0) {
+            simlog_set_changes_only(atoi(value) != 0);
+        } else if (strcmp(item, "time") == 0) {
+            atomic_store(&show_time, atoi(value) != 0);
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* ---------------- PRODUCER ---------------- */
+
+/* Copy the arguments `fmt` asks for into raw slots; returns how many. */
+static int collect_args(const char *fmt, va_list ap, SimLogArg *args) {
+    int n = 0;
+
+    for (const char *p = fmt; *p && n < SIMLOG_MAX_ARGS; p++) {
+        if (*p != '%')
+            continue;
+        if (*++p == '%')
+            continue;
+
+        p += strspn(p, SPEC_FLAGS);
+        bool wide = false;
+        while (*p == 'l' || *p == 'h' || *p == 'z')
+            wide |= *p++ != 'h';
+
+        switch (*p) {
+        case 'd': case 'i': case 'c':
+            args[n++].i = wide ? va_arg(ap, long long) : va_arg(ap, int);
+            break;
+        case 'u': case 'x': case 'X':
+            args[n++].i = wide ? (long long)va_arg(ap, unsigned long long)
+                                : (long long)va_arg(ap, unsigned);
+            break;
+        case 'f': case 'e': case 'g': case 'E': case 'G':
+            args[n++].d = va_arg(ap, double);
+            break;
+        case 's':
+            args[n++].s = va_arg(ap, const char *);
+            break;
+        default:
+            return n;
+        }
+    }
+    return n;
+}
+
+static bool rate_allows(long long now) {
+    unsigned limit = atomic_load_explicit(&rate_limit, memory_order_relaxed);
+    if (!limit)
+        return true;
+
+    if (now - window_start_ns >= 1000000000LL) {
+        window_start_ns = now;
+        window_count = 0;
+    }
+    if (window_count >= limit) {
+        atomic_fetch_add_explicit(&dropped_rate, 1, memory_order_relaxed);
+        return false;
+    }
+    window_count++;
+    return true;
+}
+
+static void vlog(int level, const char *fmt, va_list ap) {
+    long long now = now_ns();
+    if (!rate_allows(now))
+        return;
+
+    unsigned long h = atomic_load_explicit(&head, memory_order_relaxed);
+    unsigned long t = atomic_load_explicit(&tail, memory_order_acquire);
+    if (h - t == SIMLOG_RING_SIZE) {
+        atomic_fetch_add_explicit(&dropped_full, 1, memory_order_relaxed);
+        return;
+    }
+
+    SimLogRecord *r = &ring[h & SIMLOG_RING_MASK];
+    r->fmt   = fmt;
+    r->ts_ns = now;
+    r->level = level;
+    r->nargs = collect_args(fmt, ap, r->args);
+
+    atomic_store_explicit(&head, h + 1, memory_order_release);
+}
+
+void simlog(int level, const char *fmt, ...) {
+    if (!simlog_enabled(level))
+        return;
+
+    va_list ap;
+    va_start(ap, fmt);
+    vlog(level, fmt, ap);
+    va_end(ap);
+}
+
+void simlog_change(SimLogKey *key, long value, int level, const char *fmt, ...) {
+    bool changed = !key->seen || key->value != value;
+    key->seen  = true;
+    key->value = value;
+
+    if (!simlog_enabled(level))
+        return;
+    if (!changed && atomic_load_explicit(&changes_only, memory_order_relaxed))
+        return;
+
+    va_list ap;
+    va_start(ap, fmt);
+    vlog(level, fmt, ap);
+    va_end(ap);
+}
+
+/* ---------------- WRITER ---------------- */
+
+static void write_record(FILE *out, const SimLogRecord *r) {
+    if (atomic_load_explicit(&show_time, memory_order_relaxed))
+        fprintf(out, "%.6f ", (r->ts_ns - start_ns) / 1e9);
+
+    const char *p = r->fmt;
+    int n = 0;
+
+    for (;;) {
+        const char *pct = strchr(p, '%');
+        if (!pct) {
+            fputs(p, out);
+            break;
+        }
+        fwrite(p, 1, (size_t)(pct - p), out);
+
+        if (pct[1] == '%') {
+            fputc('%', out);
+            p = pct + 2;
+            continue;
+        }
+
+        /* Rebuild the conversion for the slot's type: integers as long long. */
+        const char *q = pct + 1;
+        size_t flags = strspn(q, SPEC_FLAGS);
+        q += flags;
+        while (*q == 'l' || *q == 'h' || *q == 'z')
+            q++;
+        if (!*q || n >= r->nargs)
+            break;
+
+        char spec[32];
+        if (flags > sizeof(spec) - 5)
+            flags = sizeof(spec) - 5;
+        const SimLogArg *a = &r->args[n++];
+
+        switch (*q) {
+        case 'd': case 'i': case 'u': case 'x': case 'X':
+            snprintf(spec, sizeof(spec), "%%%.*sll%c", (int)flags, pct + 1, *q);
+            fprintf(out, spec, a->i);
+            break;
+        case 'c':
+            snprintf(spec, sizeof(spec), "%%%.*sc", (int)flags, pct + 1);
+            fprintf(out, spec, (int)a->i);
+            break;
+        case 's':
+            snprintf(spec, sizeof(spec), "%%%.*ss", (int)flags, pct + 1);
+            fprintf(out, spec, a->s);
+            break;
+        default:
+            snprintf(spec, sizeof(spec), "%%%.*s%c", (int)flags, pct + 1, *q);
+            fprintf(out, spec, a->d);
+            break;
+        }
+        p = q + 1;
+    }
+    fputc('\n', out);
+}
+
+/* Write everything queued so far; one flush per batch. */
+static void drain() {
+    static unsigned long reported_full, reported_rate;
+
+    unsigned long t = atomic_load_explicit(&tail, memory_order_relaxed);
+    unsigned long h = atomic_load_explicit(&head, memory_order_acquire);
+    bool wrote = t != h;
+
+    for (; t != h; t++) {
+        write_record(stdout, &ring[t & SIMLOG_RING_MASK]);
+        atomic_store_explicit(&tail, t + 1, memory_order_release);
+    }
+
+    unsigned long full = atomic_load(&dropped_full);
+    unsigned long rate = atomic_load(&dropped_rate);
+    if (full != reported_full || rate != reported_rate) {
+        printf("[simlog] dropped %lu records (ring full), %lu (rate limit)\n",
+               full - reported_full, rate - reported_rate);
+        reported_full = full;
+        reported_rate = rate;
+        wrote = true;
+    }
+
+    if (wrote)
+        fflush(stdout);
+}
+
+static void *writer_main(void *arg) {
+    (void)arg;
+    struct timespec interval = { 0, SIMLOG_FLUSH_NS };
+
+    while (!atomic_load(&stopping)) {
+        drain();
+        nanosleep(&interval, NULL);
+    }
+    drain();
+    return NULL;
+}
+
+/* ---------------- LIFECYCLE ---------------- */
+
+void simlog_init() {
+    start_ns = now_ns();
+
+    const char *spec = getenv("SIMLOG");
+    if (spec && !simlog_configure(spec))
+        fprintf(stderr, "SIMLOG: ignoring bad setting in \"%s\"\n", spec);
+
+    /* The writer flushes once per batch, not per line */
+    setvbuf(stdout, NULL, _IOFBF, SIMLOG_STDOUT_BUF);
+
+    atomic_store(&stopping, false);
+    writer_running = pthread_create(&writer_thread, NULL, writer_main, NULL) == 0;
+}
+
+void simlog_shutdown() {
+    if (!writer_running)
+        return;
+
+    atomic_store(&stopping, true);
+    pthread_join(writer_thread, NULL);
+    writer_running = false;
+}
@@ -0,0 +1,63 @@
+#ifndef SIMLOG_H
+#define SIMLOG_H
+
+#include <stdbool.h>
+
+/*
+ * Asynchronous logger for the clients' hot paths.
+ *
+ * simlog() does no formatting and no I/O: it copies the format pointer and
+ * up to SIMLOG_MAX_ARGS raw arguments into a fixed-size record in a
+ * lock-free ring, and a background thread formats and writes records to
+ * stdout in batches.  When the ring is full the record is dropped and
+ * counted - the caller never waits.
+ *
+ * Formats must be string literals, and %s arguments must stay valid until
+ * written (literals again); numbers are copied.  Conversions: d i u x c
+ * (with l/ll), f e g, s, %%.  One thread per process may log.
+ *
+ * Configured from $SIMLOG or simlog_configure(), e.g.
+ *
+ *     SIMLOG=level=debug,rate=200,changes=1,time=1
+ *
+ *   level    trace | debug | info (default) | warn | error | off
+ *   rate     records per second before dropping, 0 = unlimited (default)
+ *   changes  1: simlog_change() only logs when its value changed
+ *   time     1: prefix lines with seconds since simlog_init()
+ *
+ * The setters may be called from any thread while logging runs.
+ */
+
+#define SIMLOG_TRACE 0
+#define SIMLOG_DEBUG 1
+#define SIMLOG_INFO  2
+#define SIMLOG_WARN  3
+#define SIMLOG_ERROR 4
+#define SIMLOG_OFF   5
+
+#define SIMLOG_MAX_ARGS 6
+
+/* Last value logged by simlog_change(), one per call site. */
+typedef struct {
+    bool seen;
+    long value;
+} SimLogKey;
+
+void simlog_init();
+void simlog_shutdown();         // writes what is left and stops the thread
+
+bool simlog_configure(const char *spec);    // false on a bad spec
+void simlog_set_level(int level);
+void simlog_set_rate(unsigned per_second);
+void simlog_set_changes_only(bool on);
+
+bool simlog_enabled(int level);
+
+void simlog(int level, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+/* simlog() unless changes-only mode is on and `value` equals the last one. */
+void simlog_change(SimLogKey *key, long value, int level, const char *fmt, ...)
+    __attribute__((format(printf, 4, 5)));
+
+#endif
@@ -0,0 +1,318 @@
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "spatial.h"
+
+#define MIN_BUCKETS 16
+
+/* ---------------- PAIRS ---------------- */
+
+static void add_pair(SpatialPairs *p, int a, int b) {
+    if (p->count == p->capacity) {
+        p->capacity = p->capacity ? p->capacity * 2 : 1024;
+        p->pairs = realloc(p->pairs, p->capacity * sizeof(SpatialPair));
+    }
+    p->pairs[p->count++] = a < b ? (SpatialPair){ a, b } : (SpatialPair){ b, a };
+}
+
+void spatial_pairs_free(SpatialPairs *p) {
+    free(p->pairs);
+    memset(p, 0, sizeof(*p));
+}
+
+/* ---------------- HASH GRID ---------------- */
+
+static inline unsigned cell_hash(const SpatialGrid *g, int cx, int cy) {
+    return ((unsigned)cx * 73856093u ^ (unsigned)cy * 19349663u) & g->mask;
+}
+
+/* Cells beyond +-CELL_LIMIT (about 5e10 m with 50 m cells) collapse onto
+ * the outermost one, so converting to int is always defined.  Lookups
+ * still compare exact positions, and spans are counted in double, so a
+ * box that reaches that far falls back to the linear scan. */
+#define CELL_LIMIT (1 << 30)
+
+static inline int cell_of(const SpatialGrid *g, double v) {
+    double c = floor(v * g->inv_cell);
+    if (!(c > -CELL_LIMIT))     // NaN too
+        return -CELL_LIMIT;
+    return c < CELL_LIMIT ? (int)c : CELL_LIMIT;
+}
+
+/* Cells in c0..c1 x r0..r1, without int overflow. */
+static inline double cell_span(int c0, int c1, int r0, int r1) {
+    return ((double)c1 - c0 + 1) * ((double)r1 - r0 + 1);
+}
+
+SpatialGrid *spatial_grid_create(double cell) {
+    if (!(cell > 0.0))
+        return NULL;
+    SpatialGrid *g = calloc(1, sizeof(SpatialGrid));
+    g->cell = cell;
+    g->inv_cell = 1.0 / cell;
+    return g;
+}
+
+void spatial_grid_free(SpatialGrid *g) {
+    if (!g)
+        return;
+    free(g->start);
+    free(g->bucket);
+    free(g->id);
+    free(g->sx);
+    free(g->sy);
+    free(g->cx);
+    free(g->cy);
+    free(g);
+}
+
+static void grid_reserve(SpatialGrid *g, int count) {
+    if (count <= g->capacity && g->start)
+        return;
+
+    g->capacity = count > g->capacity ? count : g->capacity;
+    unsigned buckets = MIN_BUCKETS;
+    while (buckets < 2u * (unsigned)g->capacity)
+        buckets *= 2;
+    g->mask = buckets - 1;
+
+    free(g->start);
+    g->start  = malloc((buckets + 1) * sizeof(int));
+    g->bucket = realloc(g->bucket, g->capacity * sizeof(int));
+    g->id     = realloc(g->id,     g->capacity * sizeof(int));
+    g->sx     = realloc(g->sx,     g->capacity * sizeof(double));
+    g->sy     = realloc(g->sy,     g->capacity * sizeof(double));
+    g->cx     = realloc(g->cx,     g->capacity * sizeof(int));
+    g->cy     = realloc(g->cy,     g->capacity * sizeof(int));
+}
+
+/* Counting sort of the items by bucket: one pass to count, one to place */
+void spatial_grid_build(SpatialGrid *g, const double *x, const double *y, int count) {
+    grid_reserve(g, count);
+    g->count = count;
+
+    unsigned buckets = g->mask + 1;
+    memset(g->start, 0, (buckets + 1) * sizeof(int));
+
+    for (int i = 0; i < count; i++) {
+        unsigned b = cell_hash(g, cell_of(g, x[i]), cell_of(g, y[i]));
+        g->bucket[i] = (int)b;
+        g->start[b + 1]++;
+    }
+    for (unsigned b = 0; b < buckets; b++)
+        g->start[b + 1] += g->start[b];
+
+    /* start[b] is used as the fill cursor, then shifted back */
+    for (int i = 0; i < count; i++) {
+        int s = g->start[g->bucket[i]]++;
+        g->id[s] = i;
+        g->sx[s] = x[i];
+        g->sy[s] = y[i];
+        g->cx[s] = cell_of(g, x[i]);
+        g->cy[s] = cell_of(g, y[i]);
+    }
+    memmove(g->start + 1, g->start, buckets * sizeof(int));
+    g->start[0] = 0;
+}
+
+/*
+ * Each slot checks the rest of its own cell and four of its eight
+ * neighbours (the other four check it), so every pair is tested once.
+ * Slots of other cells that share the bucket are skipped by cell.
+ */
+void spatial_grid_pairs(const SpatialGrid *g, double radius, SpatialPairs *out) {
+    static const int half[4][2] = { { 1, -1 }, { 1, 0 }, { 1, 1 }, { 0, 1 } };
+    double r2 = radius * radius;
+    out->count = 0;
+
+    for (int s = 0; s < g->count; s++) {
+        int cx = g->cx[s], cy = g->cy[s];
+        double x = g->sx[s], y = g->sy[s];
+
+        unsigned b = cell_hash(g, cx, cy);
+        for (int t = s + 1; t < g->start[b + 1]; t++) {
+            if (g->cx[t] != cx || g->cy[t] != cy)
+                continue;
+            double dx = g->sx[t] - x, dy = g->sy[t] - y;
+            if (dx * dx + dy * dy < r2)
+                add_pair(out, g->id[s], g->id[t]);
+        }
+
+        for (int k = 0; k < 4; k++) {
+            int nx = cx + half[k][0], ny = cy + half[k][1];
+            unsigned nb = cell_hash(g, nx, ny);
+            for (int t = g->start[nb]; t < g->start[nb + 1]; t++) {
+                if (g->cx[t] != nx || g->cy[t] != ny)
+                    continue;
+                double dx = g->sx[t] - x, dy = g->sy[t] - y;
+                if (dx * dx + dy * dy < r2)
+                    add_pair(out, g->id[s], g->id[t]);
+            }
+        }
+    }
+}
+
+int spatial_grid_within(const SpatialGrid *g, double x, double y, double radius,
+                        int *out, int max) {
+    int x0 = cell_of(g, x - radius), x1 = cell_of(g, x + radius);
+    int y0 = cell_of(g, y - radius), y1 = cell_of(g, y + radius);
+    double r2 = radius * radius;
+    int n = 0;
+
+    if (cell_span(x0, x1, y0, y1) > g->count) {
+        for (int t = 0; t < g->count && n < max; t++) {
+            double dx = g->sx[t] - x, dy = g->sy[t] - y;
+            if (dx * dx + dy * dy < r2)
+                out[n++] = g->id[t];
+        }
+        return n;
+    }
+
+    for (int cx = x0; cx <= x1; cx++) {
+        for (int cy = y0; cy <= y1; cy++) {
+            unsigned b = cell_hash(g, cx, cy);
+            for (int t = g->start[b]; t < g->start[b + 1] && n < max; t++) {
+                if (g->cx[t] != cx || g->cy[t] != cy)
+                    continue;
+                double dx = g->sx[t] - x, dy = g->sy[t] - y;
+                if (dx * dx + dy * dy < r2)
+                    out[n++] = g->id[t];
+            }
+        }
+    }
+    return n;
+}
+
+int spatial_grid_box(const SpatialGrid *g, double x0, double y0, double x1, double y1,
+                     int *out, int max) {
+    int c0 = cell_of(g, x0), c1 = cell_of(g, x1);
+    int r0 = cell_of(g, y0), r1 = cell_of(g, y1);
+    int n = 0;
+
+    if (cell_span(c0, c1, r0, r1) > g->count) {
+        for (int t = 0; t < g->count && n < max; t++)
+            if (g->sx[t] >= x0 && g->sx[t] < x1 && g->sy[t] >= y0 && g->sy[t] < y1)
+                out[n++] = g->id[t];
+        return n;
+    }
+
+    for (int cx = c0; cx <= c1; cx++) {
+        for (int cy = r0; cy <= r1; cy++) {
+            unsigned b = cell_hash(g, cx, cy);
+            for (int t = g->start[b]; t < g->start[b + 1] && n < max; t++) {
+                if (g->cx[t] != cx || g->cy[t] != cy)
+                    continue;
+                if (g->sx[t] >= x0 && g->sx[t] < x1 && g->sy[t] >= y0 && g->sy[t] < y1)
+                    out[n++] = g->id[t];
+            }
+        }
+    }
+    return n;
+}
+
+int spatial_grid_nearest_ahead(const SpatialGrid *g, int self, double x, double y,
+                               double heading, double range, double half_width) {
+    double fx = sin(heading), fy = cos(heading);     // forward
+    double lx = fy, ly = -fx;                        // to the right
+
+    /* Cells under the box ahead: its corners' extent */
+    double ex = fabs(lx) * half_width, ey = fabs(ly) * half_width;
+    double ax = x + fx * range, ay = y + fy * range;
+    int x0 = cell_of(g, fmin(x, ax) - ex), x1 = cell_of(g, fmax(x, ax) + ex);
+    int y0 = cell_of(g, fmin(y, ay) - ey), y1 = cell_of(g, fmax(y, ay) + ey);
+
+    int best = -1;
+    double best_d = range;
+
+    for (int cx = x0; cx <= x1; cx++) {
+        for (int cy = y0; cy <= y1; cy++) {
+            unsigned b = cell_hash(g, cx, cy);
+            for (int t = g->start[b]; t < g->start[b + 1]; t++) {
+                if (g->cx[t] != cx || g->cy[t] != cy || g->id[t] == self)
+                    continue;
+                double dx = g->sx[t] - x, dy = g->sy[t] - y;
+                double ahead = dx * fx + dy * fy;
+                double side  = dx * lx + dy * ly;
+                if (ahead > 0.0 && ahead <= best_d && fabs(side) <= half_width) {
+                    best = g->id[t];
+                    best_d = ahead;
+                }
+            }
+        }
+    }
+    return best;
+}
+
+/* ---------------- SWEEP AND PRUNE ---------------- */
+
+SweepPrune *spatial_sap_create() {
+    return calloc(1, sizeof(SweepPrune));
+}
+
+void spatial_sap_free(SweepPrune *s) {
+    if (!s)
+        return;
+    free(s->order);
+    free(s->key);
+    free(s);
+}
+
+static int by_key(const void *a, const void *b, void *arg) {
+    const double *x = arg;
+    double xa = x[*(const int *)a], xb = x[*(const int *)b];
+    return (xa > xb) - (xa < xb);
+}
+
+void spatial_sap_update(SweepPrune *s, const double *x, int count) {
+    s->moves = 0;
+
+    if (count != s->count) {
+        if (count > s->capacity) {
+            s->capacity = count;
+            s->order = realloc(s->order, count * sizeof(int));
+            s->key   = realloc(s->key,   count * sizeof(double));
+        }
+        s->count = count;
+        for (int i = 0; i < count; i++)
+            s->order[i] = i;
+        qsort_r(s->order, count, sizeof(int), by_key, (void *)x);
+        for (int k = 0; k < count; k++)
+            s->key[k] = x[s->order[k]];
+        return;
+    }
+
+    /* Last tick's order is nearly right: insertion sort fixes it up */
+    for (int k = 0; k < count; k++) {
+        int id = s->order[k];
+        double v = x[id];
+        int j = k;
+        while (j > 0 && s->key[j - 1] > v) {
+            s->key[j]   = s->key[j - 1];
+            s->order[j] = s->order[j - 1];
+            j--;
+        }
+        s->key[j]   = v;
+        s->order[j] = id;
+        s->moves += k - j;
+    }
+}
+
+void spatial_sap_pairs(const SweepPrune *s, const double *y, double radius, SpatialPairs *out) {
+    double r2 = radius * radius;
+    out->count = 0;
+
+    for (int k = 0; k < s->count; k++) {
+        int a = s->order[k];
+        double xa = s->key[k], ya = y[a];
+
+        for (int m = k + 1; m < s->count && s->key[m] - xa < radius; m++) {
+            int b = s->order[m];
+            double dx = s->key[m] - xa, dy = y[b] - ya;
+            if (dy < radius && dy > -radius && dx * dx + dy * dy < r2)
+                add_pair(out, a, b);
+        }
+    }
+}
@@ -0,0 +1,104 @@
+#ifndef SPATIAL_H
+#define SPATIAL_H
+
+#include <stddef.h>
+
+/*
+ * Spatial index over vehicle positions, for proximity queries and the
+ * collision broadphase.  Items are the indices into the x[] / y[] arrays
+ * the index was built from.
+ *
+ * Two broadphases with the same output (every pair closer than a radius,
+ * lower index first):
+ *
+ *   SpatialGrid   uniform hash grid, rebuilt each tick by a counting sort
+ *                 of items into cells.  O(N) to build and, with the cell at
+ *                 least the query radius, O(N) to find pairs at any spread.
+ *
+ *   SweepPrune    items kept sorted on x across ticks.  Vehicles move a
+ *                 little per tick, so an insertion sort restores the order
+ *                 in near O(N); pairs come from scanning the x-overlaps.
+ *                 Cheapest when the world is long in x (a road), but the
+ *                 scan grows as N * (radius / world width) otherwise.
+ *
+ * spatial_bench times both against all-pairs checks.
+ */
+
+typedef struct {
+    int a, b;               // a < b
+} SpatialPair;
+
+typedef struct {
+    SpatialPair *pairs;
+    size_t       count;
+    size_t       capacity;
+} SpatialPairs;
+
+void spatial_pairs_free(SpatialPairs *p);
+
+/* ---------------- HASH GRID ---------------- */
+
+typedef struct {
+    double   cell;          // side, m
+    double   inv_cell;
+    int      count;         // items in the last build
+    int      capacity;
+    unsigned mask;          // buckets - 1
+
+    int     *start;         // [buckets + 1] first slot of each bucket
+    int     *bucket;        // [capacity] bucket of each item, scratch
+
+    /* Per slot, sorted by bucket: the item and its position and cell */
+    int     *id;
+    double  *sx, *sy;
+    int     *cx, *cy;
+} SpatialGrid;
+
+/* NULL if cell is not positive. */
+SpatialGrid *spatial_grid_create(double cell);
+void spatial_grid_free(SpatialGrid *g);
+
+void spatial_grid_build(SpatialGrid *g, const double *x, const double *y, int count);
+
+/* Pairs closer than radius, which must be at most the cell size. */
+void spatial_grid_pairs(const SpatialGrid *g, double radius, SpatialPairs *out);
+
+/* Items within radius of (x, y), up to max of them; returns how many. */
+int spatial_grid_within(const SpatialGrid *g, double x, double y, double radius,
+                        int *out, int max);
+
+/*
+ * Items with x0 <= x < x1 and y0 <= y < y1, up to max of them; returns how
+ * many.  A box covering more cells than there are items is answered by a
+ * scan instead.
+ */
+int spatial_grid_box(const SpatialGrid *g, double x0, double y0, double x1, double y1,
+                     int *out, int max);
+
+/*
+ * Nearest item in front of item `self` (at x, y, facing heading, radians
+ * from +y towards +x, as the engine step moves): within range ahead and
+ * half_width to either side.  -1 if none.
+ */
+int spatial_grid_nearest_ahead(const SpatialGrid *g, int self, double x, double y,
+                               double heading, double range, double half_width);
+
+/* ---------------- SWEEP AND PRUNE ---------------- */
+
+typedef struct {
+    int    *order;          // item ids by ascending x
+    double *key;            // x of order[k]
+    int     count;
+    int     capacity;
+    long    moves;          // insertion-sort shifts in the last update
+} SweepPrune;
+
+SweepPrune *spatial_sap_create();
+void spatial_sap_free(SweepPrune *s);
+
+/* Re-sort on the new x; a change of count starts the order afresh. */
+void spatial_sap_update(SweepPrune *s, const double *x, int count);
+
+void spatial_sap_pairs(const SweepPrune *s, const double *y, double radius, SpatialPairs *out);
+
+#endif
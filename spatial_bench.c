@@ -0,0 +1,236 @@
+/*
+ * Collision broadphase benchmark.
+ *
+ * Moves a fleet around a square world (or a long road with -w) at a fixed
+ * density and finds every pair of vehicles closer than the contact
+ * distance each tick, with the hash grid and with sweep-and-prune.  The
+ * pair sets are checked against all-pairs on the last tick, and all-pairs
+ * is timed too while it is affordable.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include <getopt.h>
+
+#include "spatial.h"
+#include "tick_sched.h"
+
+#define PI 3.14159265359
+#define DT 0.016
+#define MAX_SPEED 30.0              // m/s
+#define ROAD_WIDTH 20.0             // m, with --road
+#define BRUTE_MAX 20000             // all-pairs is timed up to this many vehicles
+
+typedef struct {
+    int     count;
+    double  width, height;
+    double *x, *y;
+    double *vx, *vy;
+} World;
+
+static unsigned long long rng_state = 0x9e3779b97f4a7c15ULL;
+
+static double rnd() {
+    rng_state = rng_state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (rng_state >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static void world_init(World *w, int count, double area_per_vehicle, bool road) {
+    rng_state = 0x9e3779b97f4a7c15ULL;
+
+    w->count = count;
+    if (road) {
+        w->height = ROAD_WIDTH;
+        w->width  = count * area_per_vehicle / ROAD_WIDTH;
+    } else {
+        w->width = w->height = sqrt(count * area_per_vehicle);
+    }
+
+    w->x  = malloc(count * sizeof(double));
+    w->y  = malloc(count * sizeof(double));
+    w->vx = malloc(count * sizeof(double));
+    w->vy = malloc(count * sizeof(double));
+
+    for (int i = 0; i < count; i++) {
+        double heading = rnd() * 2.0 * PI;
+        double speed = rnd() * MAX_SPEED;
+        w->x[i]  = rnd() * w->width;
+        w->y[i]  = rnd() * w->height;
+        w->vx[i] = speed * sin(heading);
+        w->vy[i] = speed * cos(heading);
+    }
+}
+
+static void world_free(World *w) {
+    free(w->x);
+    free(w->y);
+    free(w->vx);
+    free(w->vy);
+}
+
+/* Straight lines, bouncing off the edges */
+static void world_step(World *w) {
+    for (int i = 0; i < w->count; i++) {
+        w->x[i] += w->vx[i] * DT;
+        w->y[i] += w->vy[i] * DT;
+        if (w->x[i] < 0.0 || w->x[i] > w->width) {
+            w->vx[i] = -w->vx[i];
+            w->x[i] = fmin(fmax(w->x[i], 0.0), w->width);
+        }
+        if (w->y[i] < 0.0 || w->y[i] > w->height) {
+            w->vy[i] = -w->vy[i];
+            w->y[i] = fmin(fmax(w->y[i], 0.0), w->height);
+        }
+    }
+}
+
+static void brute_pairs(const World *w, double radius, SpatialPairs *out) {
+    double r2 = radius * radius;
+    out->count = 0;
+
+    for (int a = 0; a < w->count; a++) {
+        for (int b = a + 1; b < w->count; b++) {
+            double dx = w->x[b] - w->x[a], dy = w->y[b] - w->y[a];
+            if (dx * dx + dy * dy < r2) {
+                if (out->count == out->capacity) {
+                    out->capacity = out->capacity ? out->capacity * 2 : 1024;
+                    out->pairs = realloc(out->pairs, out->capacity * sizeof(SpatialPair));
+                }
+                out->pairs[out->count++] = (SpatialPair){ a, b };
+            }
+        }
+    }
+}
+
+static int by_pair(const void *pa, const void *pb) {
+    const SpatialPair *a = pa, *b = pb;
+    if (a->a != b->a)
+        return (a->a > b->a) - (a->a < b->a);
+    return (a->b > b->b) - (a->b < b->b);
+}
+
+static bool same_pairs(SpatialPairs *a, SpatialPairs *b) {
+    if (a->count != b->count)
+        return false;
+    qsort(a->pairs, a->count, sizeof(SpatialPair), by_pair);
+    qsort(b->pairs, b->count, sizeof(SpatialPair), by_pair);
+    return memcmp(a->pairs, b->pairs, a->count * sizeof(SpatialPair)) == 0;
+}
+
+/* ns per vehicle per tick for each method; false if the pair sets differ */
+static bool bench(int count, int ticks, double radius, double area, bool road) {
+    World w;
+    world_init(&w, count, area, road);
+
+    SpatialGrid *grid = spatial_grid_create(radius);
+    SweepPrune *sap = spatial_sap_create();
+    SpatialPairs gp = { 0 }, sp = { 0 }, bp = { 0 };
+
+    /* First builds (and the initial sort) are not timed */
+    spatial_grid_build(grid, w.x, w.y, count);
+    spatial_sap_update(sap, w.x, count);
+
+    long long grid_ns = 0, sap_ns = 0;
+    long moves = 0;
+    size_t pairs = 0;
+
+    for (int t = 0; t < ticks; t++) {
+        world_step(&w);
+
+        long long t0 = sched_now_ns();
+        spatial_grid_build(grid, w.x, w.y, count);
+        spatial_grid_pairs(grid, radius, &gp);
+        long long t1 = sched_now_ns();
+        spatial_sap_update(sap, w.x, count);
+        spatial_sap_pairs(sap, w.y, radius, &sp);
+        long long t2 = sched_now_ns();
+
+        grid_ns += t1 - t0;
+        sap_ns  += t2 - t1;
+        moves   += sap->moves;
+        pairs   += gp.count;
+    }
+
+    double per = (double)count * ticks;
+    printf("%9d %11.1f %11.1f", count, grid_ns / per, sap_ns / per);
+
+    bool ok;
+    if (count <= BRUTE_MAX) {
+        long long t0 = sched_now_ns();
+        brute_pairs(&w, radius, &bp);
+        printf(" %11.1f", (sched_now_ns() - t0) / (double)count);
+        ok = same_pairs(&gp, &bp) && same_pairs(&sp, &bp);
+    } else {
+        printf(" %11s", "-");
+        ok = same_pairs(&gp, &sp);
+    }
+    printf(" %9.1f %9.2f %s\n", (double)pairs / ticks, (double)moves / per,
+           ok ? "" : "MISMATCH");
+
+    spatial_pairs_free(&gp);
+    spatial_pairs_free(&sp);
+    spatial_pairs_free(&bp);
+    spatial_grid_free(grid);
+    spatial_sap_free(sap);
+    world_free(&w);
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    const char *sizes = "1000,10000,100000";
+    int ticks = 100;
+    double radius = 5.0;
+    double area = 400.0;
+    bool road = false;
+
+    static const struct option opts[] = {
+        { "vehicles", required_argument, NULL, 'n' },
+        { "ticks",    required_argument, NULL, 't' },
+        { "radius",   required_argument, NULL, 'r' },
+        { "area",     required_argument, NULL, 'a' },
+        { "road",     no_argument,       NULL, 'w' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    int c;
+    while ((c = getopt_long(argc, argv, "n:t:r:a:w", opts, NULL)) != -1) {
+        if (c == 'n') {
+            sizes = optarg;
+        } else if (c == 't') {
+            ticks = atoi(optarg);
+        } else if (c == 'r') {
+            radius = atof(optarg);
+        } else if (c == 'a') {
+            area = atof(optarg);
+        } else if (c == 'w') {
+            road = true;
+        } else {
+            fprintf(stderr, "Usage: %s [-n N,N,...] [-t ticks] [-r radius] [-a m2-per-vehicle] [-w]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+    if (ticks < 1 || !(radius > 0.0) || !(area > 0.0)) {
+        fprintf(stderr, "ticks, radius and area must be positive\n");
+        return 1;
+    }
+
+    printf("%s world, %.0f m2 per vehicle, contact under %.1f m, %d ticks\n",
+           road ? "road" : "square", area, radius, ticks);
+    printf("%9s %11s %11s %11s %9s %9s\n", "vehicles", "grid ns/veh", "sap ns/veh",
+           "all ns/veh", "pairs", "sap moves");
+
+    bool ok = true;
+    char *list = strdup(sizes);
+    for (char *tok = strtok(list, ","); tok; tok = strtok(NULL, ",")) {
+        int n = atoi(tok);
+        if (n > 1)
+            ok &= bench(n, ticks, radius, area, road);
+    }
+    free(list);
+
+    return ok ? 0 : 1;
+}
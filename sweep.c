@@ -0,0 +1,453 @@
+/*
+ * Parameter sweep: run the engine, transmission and fuel steps for every
+ * configuration in a grid (or a random sample of it) over a scripted drive
+ * and tabulate how each one did.
+ *
+ *     ./sweep -S accel_drive.txt [-m model] [-N samples] SPEC > results.csv
+ *
+ * SPEC names the parameters to vary, one per line:
+ *
+ *     upshift_rpm        2500:4500:250     # lo:hi:step
+ *     downshift_rpm      1200 1500 1800    # or a list
+ *     gear1              3.0:4.0:0.5
+ *
+ * Without -N every combination runs; with -N that many configurations are
+ * drawn at random, ranges uniformly between lo and hi (step optional) and
+ * lists by picking one value.  Each run is a sequential in-process tick
+ * loop, as the server's, spread over all cores by a work-stealing pool.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include <getopt.h>
+
+#include "common.h"
+#include "sim_plugin.h"
+#include "sim_tick.h"
+#include "pool.h"
+#include "tick_sched.h"
+
+#define DT 0.016
+#define TANK_FULL 100.0
+#define TARGET_KMH 100.0           // for the time-to-speed column
+
+#define MAX_SWEEP_VALUES 256        // per parameter
+#define MAX_SWEEP_RUNS   10000000
+
+/* ---------------- PARAMETERS ---------------- */
+
+enum {
+    P_UPSHIFT, P_DOWNSHIFT, P_COOLDOWN, P_EFFICIENCY, P_FINAL_DRIVE,
+    P_GEAR1,                                // .. P_GEAR1 + MAX_MODEL_GEARS - 1
+    NUM_PARAMS = P_GEAR1 + MAX_MODEL_GEARS
+};
+
+static const char *param_key[NUM_PARAMS] = {
+    "upshift_rpm", "downshift_rpm", "shift_cooldown", "engine_efficiency", "final_drive",
+    "gear1", "gear2", "gear3", "gear4", "gear5", "gear6", "gear7", "gear8",
+};
+
+typedef struct {
+    bool   swept;
+    bool   range;           // lo:hi[:step] rather than a list
+    double lo, hi;          // of a range
+    int    count;           // grid points
+    double value[MAX_SWEEP_VALUES];
+} SweepParam;
+
+typedef struct {
+    SweepParam param[NUM_PARAMS];
+    double     base[NUM_PARAMS];    // value of a parameter that is not swept
+    bool       random;
+    int        runs;
+    uint64_t   seed;
+
+    const VehicleModel *model;
+    const DriveScript  *script;
+    double              dt;
+    long                ticks;
+    double              target_kmh;
+} Sweep;
+
+typedef struct {
+    double fuel_used;       // litres
+    double time_target;     // s to target_kmh, < 0 if never
+    int    shifts;
+    double top_speed;       // km/h
+    double distance;        // m
+} SweepResult;
+
+static int find_param(const char *key) {
+    for (int i = 0; i < NUM_PARAMS; i++)
+        if (strcmp(key, param_key[i]) == 0)
+            return i;
+    return -1;
+}
+
+/* "lo:hi[:step]" or a list of numbers; false if malformed. */
+static bool parse_values(SweepParam *p, const char *rest, bool random) {
+    double lo, hi, step;
+    int fields = sscanf(rest, " %lf:%lf:%lf", &lo, &hi, &step);
+
+    if (fields >= 2) {
+        if (hi < lo)
+            return false;
+        p->range = true;
+        p->lo = lo;
+        p->hi = hi;
+        if (fields == 2) {
+            /* Only a random search can sample a range without a step */
+            p->count = 1;
+            p->value[0] = lo;
+            return random;
+        }
+        if (step <= 0.0)
+            return false;
+        p->count = 0;
+        for (double v = lo; v <= hi + step * 1e-9; v = lo + step * p->count) {
+            if (p->count == MAX_SWEEP_VALUES)
+                return false;
+            p->value[p->count++] = v;
+        }
+        return true;
+    }
+
+    p->count = 0;
+    double v;
+    int n;
+    while (sscanf(rest, "%lf%n", &v, &n) == 1) {
+        if (p->count == MAX_SWEEP_VALUES)
+            return false;
+        p->value[p->count++] = v;
+        rest += n;
+    }
+    return p->count > 0;
+}
+
+static bool load_spec(Sweep *s, const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+
+    char line[4096];
+    int lineno = 0;
+    while (fgets(line, sizeof(line), f)) {
+        lineno++;
+
+        char *hash = strchr(line, '#');
+        if (hash)
+            *hash = '\0';
+
+        char key[32];
+        int used;
+        if (sscanf(line, "%31s%n", key, &used) != 1)
+            continue;
+
+        int i = find_param(key);
+        const char *what = NULL;
+        if (i < 0)
+            what = "unknown parameter";
+        else if (i >= P_GEAR1 && i - P_GEAR1 >= s->model->num_gears)
+            what = "the model has no such gear";
+        else if (!parse_values(&s->param[i], line + used, s->random))
+            what = "expected lo:hi:step or a list of numbers (lo:hi needs --random)";
+
+        if (what) {
+            fprintf(stderr, "%s:%d: %s\n", path, lineno, what);
+            fclose(f);
+            return false;
+        }
+        s->param[i].swept = true;
+    }
+    fclose(f);
+    return true;
+}
+
+/* ---------------- CONFIGURATIONS ---------------- */
+
+/* Counter-based, so a run's draw does not depend on which thread ran it */
+static uint64_t splitmix64(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+static double uniform(uint64_t *state) {
+    *state = splitmix64(*state);
+    return (*state >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* Parameter values of run `job`: a grid index in mixed radix, or a draw */
+static void config_of(const Sweep *s, int job, double *v) {
+    uint64_t rng = s->seed ^ ((uint64_t)job << 32);
+    long rest = job;
+
+    for (int i = 0; i < NUM_PARAMS; i++) {
+        const SweepParam *p = &s->param[i];
+        v[i] = s->base[i];
+        if (!p->swept)
+            continue;
+
+        if (!s->random) {
+            v[i] = p->value[rest % p->count];
+            rest /= p->count;
+        } else if (p->range) {
+            v[i] = p->lo + (p->hi - p->lo) * uniform(&rng);
+        } else {
+            v[i] = p->value[(int)(uniform(&rng) * p->count)];
+        }
+    }
+}
+
+/* ---------------- ONE RUN ---------------- */
+
+/* The transmission and fuel steps with this run's parameters as their state. */
+static void shift_step(void *params, const void *in, void *out) {
+    transmission_shift(params, in, out);
+}
+
+static void burn_step(void *params, const void *in, void *out) {
+    fuel_burn(params, in, out);
+}
+
+/* The server's sequential tick (sim_tick) with the config's parameters. */
+static void run_drive(const Sweep *s, const double *v, SweepResult *r) {
+    VehicleModel model = *s->model;
+    bool drivetrain = s->param[P_FINAL_DRIVE].swept;
+    model.final_drive = v[P_FINAL_DRIVE];
+    for (int g = 0; g < model.num_gears; g++) {
+        model.gears[g] = v[P_GEAR1 + g];
+        drivetrain |= s->param[P_GEAR1 + g].swept;
+    }
+    if (drivetrain)
+        vehicle_model_rebuild(&model);
+
+    ShiftParams shift = {
+        .upshift_rpm   = v[P_UPSHIFT],
+        .downshift_rpm = v[P_DOWNSHIFT],
+        .cooldown      = v[P_COOLDOWN],
+    };
+    FuelParams fuel = { .engine_efficiency = v[P_EFFICIENCY] };
+
+    EngineState es;
+    engine_init(&es);
+    es.model = &model;
+
+    SimStages stages = {
+        .step  = { engine_plugin.step, shift_step, burn_step },
+        .state = { &es, &shift, &fuel },
+    };
+
+    DriveScript script = *s->script;
+    script.cursor = 0;
+
+    CarSnapshot car;
+    memset(&car, 0, sizeof(car));
+    car.fuel = TANK_FULL;
+    double last_shift = NEVER_SHIFTED;
+    double sim_time = 0.0;
+
+    memset(r, 0, sizeof(*r));
+    r->time_target = -1.0;
+
+    for (long tick = 0; tick < s->ticks; tick++) {
+        drive_script_at(&script, sim_time, &es.driver);
+
+        double x0 = car.x, y0 = car.y, shifted = last_shift;
+        sim_tick(&stages, &car, &last_shift, sim_time, s->dt);
+        if (last_shift != shifted)
+            r->shifts++;
+
+        sim_time += s->dt;
+
+        r->distance += hypot(car.x - x0, car.y - y0);
+        if (car.speed * 3.6 > r->top_speed)
+            r->top_speed = car.speed * 3.6;
+        if (r->time_target < 0.0 && car.speed * 3.6 >= s->target_kmh)
+            r->time_target = sim_time;
+    }
+    r->fuel_used = TANK_FULL - car.fuel;
+}
+
+typedef struct {
+    const Sweep *sweep;
+    SweepResult *results;
+} Batch;
+
+static void run_job(int job, void *arg) {
+    Batch *b = arg;
+    double v[NUM_PARAMS];
+    config_of(b->sweep, job, v);
+    run_drive(b->sweep, v, &b->results[job]);
+}
+
+/* ---------------- OUTPUT ---------------- */
+
+static void write_table(FILE *out, const Sweep *s, const SweepResult *results) {
+    fprintf(out, "run");
+    for (int i = 0; i < NUM_PARAMS; i++)
+        if (s->param[i].swept)
+            fprintf(out, ",%s", param_key[i]);
+    fprintf(out, ",fuel_used_l,time_0_%g_s,shifts,top_speed_kmh,distance_m\n", s->target_kmh);
+
+    for (int job = 0; job < s->runs; job++) {
+        const SweepResult *r = &results[job];
+        double v[NUM_PARAMS];
+        config_of(s, job, v);
+
+        fprintf(out, "%d", job);
+        for (int i = 0; i < NUM_PARAMS; i++)
+            if (s->param[i].swept)
+                fprintf(out, ",%.6g", v[i]);
+        fprintf(out, ",%.6f,", r->fuel_used);
+        if (r->time_target >= 0.0)
+            fprintf(out, "%.3f", r->time_target);
+        fprintf(out, ",%d,%.2f,%.1f\n", r->shifts, r->top_speed, r->distance);
+    }
+}
+
+/* ---------------- MAIN ---------------- */
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+        "Usage: %s -S script [options] SPEC\n"
+        "  -S, --script F    drive cycle to run every configuration on\n"
+        "  -m, --model F     vehicle model to start from (default built-in)\n"
+        "  -N, --random N    N random configurations instead of the full grid\n"
+        "  -s, --seed N      seed for --random (default 1)\n"
+        "  -d, --duration S  sim seconds per run (default: to the end of the script)\n"
+        "  -r, --rate HZ     tick rate (default %.1f)\n"
+        "  -v, --target KMH  speed the time-to-speed column measures (default %g)\n"
+        "  -j, --threads N   worker threads (default: online CPUs)\n"
+        "  -o, --output F    results table (CSV) to F instead of stdout\n",
+        prog, 1.0 / DT, TARGET_KMH);
+}
+
+int main(int argc, char **argv) {
+    static Sweep s;
+    s.seed = 1;
+    s.dt = DT;
+    s.target_kmh = TARGET_KMH;
+
+    const char *script_path = NULL;
+    const char *output_path = NULL;
+    VehicleModel *model = NULL;
+    double duration = -1.0;
+    int threads = pool_default_threads();
+
+    static const struct option opts[] = {
+        { "script",   required_argument, NULL, 'S' },
+        { "model",    required_argument, NULL, 'm' },
+        { "random",   required_argument, NULL, 'N' },
+        { "seed",     required_argument, NULL, 's' },
+        { "duration", required_argument, NULL, 'd' },
+        { "rate",     required_argument, NULL, 'r' },
+        { "target",   required_argument, NULL, 'v' },
+        { "threads",  required_argument, NULL, 'j' },
+        { "output",   required_argument, NULL, 'o' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    int c;
+    while ((c = getopt_long(argc, argv, "S:m:N:s:d:r:v:j:o:", opts, NULL)) != -1) {
+        if (c == 'S') {
+            script_path = optarg;
+        } else if (c == 'm') {
+            model = vehicle_model_load(optarg);
+            if (!model)
+                return 1;
+        } else if (c == 'N') {
+            s.random = true;
+            s.runs = atoi(optarg);
+        } else if (c == 's') {
+            s.seed = strtoull(optarg, NULL, 0);
+        } else if (c == 'd') {
+            duration = atof(optarg);
+        } else if (c == 'r' && atof(optarg) > 0.0) {
+            s.dt = 1.0 / atof(optarg);
+        } else if (c == 'v') {
+            s.target_kmh = atof(optarg);
+        } else if (c == 'j') {
+            threads = atoi(optarg);
+        } else if (c == 'o') {
+            output_path = optarg;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (!script_path || optind != argc - 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    DriveScript *script = drive_script_load(script_path);
+    if (!script)
+        return 1;
+    s.script = script;
+    s.model = model ? model : vehicle_model_default();
+
+    /* engine_init points each run at the built-in model, which is built on
+     * first use: build it now, before the workers race to */
+    vehicle_model_default();
+
+    /* What a parameter is when it is not swept: the built-in values */
+    s.base[P_UPSHIFT]     = transmission_default_params()->upshift_rpm;
+    s.base[P_DOWNSHIFT]   = transmission_default_params()->downshift_rpm;
+    s.base[P_COOLDOWN]    = transmission_default_params()->cooldown;
+    s.base[P_EFFICIENCY]  = fuel_default_params()->engine_efficiency;
+    s.base[P_FINAL_DRIVE] = s.model->final_drive;
+    for (int g = 0; g < MAX_MODEL_GEARS; g++)
+        s.base[P_GEAR1 + g] = s.model->gears[g];
+
+    if (!load_spec(&s, argv[optind]))
+        return 1;
+
+    if (!s.random) {
+        long long runs = 1;
+        for (int i = 0; i < NUM_PARAMS; i++)
+            if (s.param[i].swept && (runs *= s.param[i].count) > MAX_SWEEP_RUNS)
+                break;
+        s.runs = (int)(runs > MAX_SWEEP_RUNS ? MAX_SWEEP_RUNS + 1 : runs);
+    }
+    if (s.runs < 1 || s.runs > MAX_SWEEP_RUNS) {
+        fprintf(stderr, "%d runs: must be 1..%d\n", s.runs, MAX_SWEEP_RUNS);
+        return 1;
+    }
+
+    if (duration < 0.0)
+        duration = drive_script_end(script);
+    s.ticks = (long)ceil(duration / s.dt - 1e-9);
+
+    FILE *out = stdout;
+    if (output_path && !(out = fopen(output_path, "w"))) {
+        perror(output_path);
+        return 1;
+    }
+
+    Batch b = { &s, calloc(s.runs, sizeof(SweepResult)) };
+    long long t0 = sched_now_ns();
+    long steals = pool_run(threads, s.runs, run_job, &b);
+    double secs = (sched_now_ns() - t0) / 1e9;
+
+    write_table(out, &s, b.results);
+    if (out != stdout)
+        fclose(out);
+
+    double ticks = (double)s.runs * s.ticks;
+    fprintf(stderr, "%d runs x %ld ticks on %d threads: %.2f s, %.1f M ticks/s, %ld steals\n",
+            s.runs, s.ticks, threads < s.runs ? threads : s.runs, secs,
+            ticks / secs / 1e6, steals);
+
+    free(b.results);
+    drive_script_free(script);
+    vehicle_model_free(model);
+    return 0;
+}
@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "telemetry.h"
+
+/* ---------------- FILES ---------------- */
+
+static bool open_file(Telemetry *t) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s.%03u.tlm", t->prefix, t->sequence);
+
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror(path);
+        return false;
+    }
+
+    /* Reserve the blocks now so appends never hit ENOSPC through a SIGBUS */
+    int err = posix_fallocate(fd, 0, (off_t)t->file_bytes);
+    if (err) {
+        fprintf(stderr, "%s: cannot preallocate %zu bytes: %s\n",
+                path, t->file_bytes, strerror(err));
+        close(fd);
+        return false;
+    }
+
+    void *map = mmap(NULL, t->file_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        close(fd);
+        return false;
+    }
+    madvise(map, t->file_bytes, MADV_SEQUENTIAL);
+
+    t->fd      = fd;
+    t->header  = map;
+    t->records = (TelemetryRecord *)((char *)map + TELEMETRY_DATA_OFFSET);
+    t->count   = 0;
+
+    TelemetryHeader *h = t->header;
+    memcpy(h->magic, TELEMETRY_MAGIC, sizeof(h->magic));
+    h->version     = TELEMETRY_VERSION;
+    h->record_size = sizeof(TelemetryRecord);
+    h->capacity    = (t->file_bytes - TELEMETRY_DATA_OFFSET) / sizeof(TelemetryRecord);
+    h->sequence    = t->sequence;
+    h->dt          = t->dt;
+    atomic_store_explicit(&h->count, 0, memory_order_release);
+    return true;
+}
+
+/* Unmap and cut the file down to the records actually written. */
+static void close_file(Telemetry *t) {
+    if (!t->header)
+        return;
+
+    munmap(t->header, t->file_bytes);
+    if (ftruncate(t->fd, TELEMETRY_DATA_OFFSET + (off_t)(t->count * sizeof(TelemetryRecord))) < 0)
+        perror("telemetry: ftruncate");
+    close(t->fd);
+
+    t->header  = NULL;
+    t->records = NULL;
+}
+
+/* ---------------- API ---------------- */
+
+Telemetry *telemetry_open(const char *prefix, size_t file_bytes, double dt) {
+    if (file_bytes < TELEMETRY_DATA_OFFSET + sizeof(TelemetryRecord)) {
+        fprintf(stderr, "telemetry: file size too small\n");
+        return NULL;
+    }
+
+    Telemetry *t = calloc(1, sizeof(Telemetry));
+    snprintf(t->prefix, sizeof(t->prefix), "%s", prefix);
+    t->file_bytes = file_bytes;
+    t->dt = dt;
+
+    if (!open_file(t)) {
+        free(t);
+        return NULL;
+    }
+    return t;
+}
+
+void telemetry_close(Telemetry *t) {
+    if (!t)
+        return;
+    close_file(t);
+    free(t);
+}
+
+void telemetry_write(Telemetry *t, uint32_t vehicle, uint64_t tick,
+                     double sim_time, const CarSnapshot *car) {
+    if (!t->header)
+        return;     // stopped after a failed rotation
+
+    if (t->count == t->header->capacity) {
+        close_file(t);
+        t->sequence++;
+        if (!open_file(t)) {
+            fprintf(stderr, "telemetry: capture stopped after %llu records\n",
+                    (unsigned long long)t->total);
+            return;
+        }
+    }
+
+    TelemetryRecord *r = &t->records[t->count];
+    r->tick     = tick;
+    r->sim_time = sim_time;
+    r->vehicle  = vehicle;
+    r->reserved = 0;
+    r->car      = *car;
+
+    t->count++;
+    t->total++;
+    atomic_store_explicit(&t->header->count, t->count, memory_order_release);
+}
@@ -0,0 +1,67 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "common.h"
+
+/*
+ * Full-rate telemetry: every completed tick of every vehicle, appended to
+ * memory-mapped files of fixed-size records.
+ *
+ * A file is a TelemetryHeader padded to TELEMETRY_DATA_OFFSET, followed by
+ * `capacity` TelemetryRecords.  The file is preallocated when opened, so
+ * a record is one struct copy into the mapping and a release store of
+ * `count`; a reader (even of a file still being written) mmaps it, checks
+ * magic/version/record_size and uses records[0 .. count).  Nothing needs
+ * parsing.
+ *
+ * When a file is full the writer truncates it to its used length and
+ * moves on to the next: PREFIX.000.tlm, PREFIX.001.tlm, ...
+ */
+
+#define TELEMETRY_MAGIC       "CARTLM\r\n"
+#define TELEMETRY_VERSION     1
+#define TELEMETRY_DATA_OFFSET 4096
+
+typedef struct {
+    char             magic[8];      // TELEMETRY_MAGIC
+    uint32_t         version;       // TELEMETRY_VERSION
+    uint32_t         record_size;   // sizeof(TelemetryRecord)
+    uint64_t         capacity;      // records the file has room for
+    _Atomic uint64_t count;         // records written, release-stored
+    uint32_t         sequence;      // position in the rotation, 0 first
+    uint32_t         reserved;
+    double           dt;            // tick period of the run
+} TelemetryHeader;
+
+typedef struct {
+    uint64_t    tick;           // vehicle's tick number, from 0
+    double      sim_time;       // simulation time at the end of the tick
+    uint32_t    vehicle;
+    uint32_t    reserved;
+    CarSnapshot car;
+} TelemetryRecord;
+
+typedef struct {
+    char             prefix[200];
+    size_t           file_bytes;    // rotation size
+    double           dt;
+    int              fd;
+    uint32_t         sequence;
+    TelemetryHeader *header;
+    TelemetryRecord *records;
+    uint64_t         count;         // writer's copy of header->count
+    uint64_t         total;         // records over all files
+} Telemetry;
+
+/* NULL (with a message) if the first file cannot be created. */
+Telemetry *telemetry_open(const char *prefix, size_t file_bytes, double dt);
+void telemetry_close(Telemetry *t);
+
+/* Rotation failures stop the capture with a message; the run continues. */
+void telemetry_write(Telemetry *t, uint32_t vehicle, uint64_t tick,
+                     double sim_time, const CarSnapshot *car);
+
+#endif
@@ -0,0 +1,141 @@
+/*
+ * Print telemetry files (see telemetry.h) as CSV.
+ *
+ *     ./telemetry_dump [-v vehicle] [-a out.car] run.000.tlm run.001.tlm ...
+ *
+ * Files are mapped read-only and their records used in place; a file the
+ * server is still writing shows the records published so far.  With -a
+ * the records are packed into a columnar archive (see archive.h) instead.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "telemetry.h"
+#include "archive.h"
+
+static int dump(const char *path, long vehicle, ArchiveWriter *archive) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return 1;
+    }
+
+    struct stat st;
+    fstat(fd, &st);
+    if ((size_t)st.st_size < TELEMETRY_DATA_OFFSET) {
+        fprintf(stderr, "%s: too short for a telemetry file\n", path);
+        close(fd);
+        return 1;
+    }
+
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+
+    const TelemetryHeader *h = map;
+    if (memcmp(h->magic, TELEMETRY_MAGIC, sizeof(h->magic)) != 0 ||
+        h->version != TELEMETRY_VERSION || h->record_size != sizeof(TelemetryRecord)) {
+        fprintf(stderr, "%s: not a version %d telemetry file from this build\n",
+                path, TELEMETRY_VERSION);
+        munmap(map, (size_t)st.st_size);
+        return 1;
+    }
+
+    uint64_t count = atomic_load_explicit(&h->count, memory_order_acquire);
+    uint64_t fits = ((size_t)st.st_size - TELEMETRY_DATA_OFFSET) / sizeof(TelemetryRecord);
+    if (count > fits)
+        count = fits;
+
+    const TelemetryRecord *rec =
+        (const TelemetryRecord *)((const char *)map + TELEMETRY_DATA_OFFSET);
+
+    for (uint64_t i = 0; i < count; i++) {
+        const TelemetryRecord *r = &rec[i];
+        const CarSnapshot *c = &r->car;
+        if (vehicle >= 0 && r->vehicle != (uint32_t)vehicle)
+            continue;
+        if (archive) {
+            archive_append(archive, r);
+            continue;
+        }
+
+        printf("%u,%llu,%.4f,%.3f,%.3f,%.3f,%d,%.6f,%.3f,%.3f,%.6f,%.1f,%.1f,%.2f,%.4f,%d\n",
+               r->vehicle, (unsigned long long)r->tick, r->sim_time,
+               c->throttle, c->brake, c->steer, c->gear, c->speed,
+               c->x, c->y, c->heading, c->rpm, c->power, c->torque, c->fuel,
+               c->reverse);
+    }
+
+    munmap(map, (size_t)st.st_size);
+    return 0;
+}
+
+/* The run's tick period, from the first file's header (0 if unreadable). */
+static double file_dt(const char *path) {
+    TelemetryHeader h = { 0 };
+    FILE *f = fopen(path, "rb");
+    if (f) {
+        if (fread(&h, sizeof(h), 1, f) != 1)
+            h.dt = 0.0;
+        fclose(f);
+    }
+    return h.dt;
+}
+
+int main(int argc, char **argv) {
+    long vehicle = -1;
+    const char *archive_path = NULL;
+
+    int c;
+    while ((c = getopt(argc, argv, "v:a:")) != -1) {
+        if (c == 'v') {
+            vehicle = atol(optarg);
+        } else if (c == 'a') {
+            archive_path = optarg;
+        } else {
+            fprintf(stderr, "Usage: %s [-v vehicle] [-a out.car] FILE.tlm...\n", argv[0]);
+            return 1;
+        }
+    }
+    if (optind == argc) {
+        fprintf(stderr, "Usage: %s [-v vehicle] [-a out.car] FILE.tlm...\n", argv[0]);
+        return 1;
+    }
+
+    if (archive_path) {
+        ArchiveWriter *archive = archive_create(archive_path, file_dt(argv[optind]));
+        if (!archive)
+            return 1;
+
+        int status = 0;
+        for (int i = optind; i < argc; i++)
+            status |= dump(argv[i], vehicle, archive);
+
+        archive_flush(archive);
+        uint64_t rows = archive->rows, bytes = archive->bytes;
+        archive_close(archive);
+        fprintf(stderr, "%llu rows, %llu bytes (%.1f B/row, %.1fx smaller than .tlm)\n",
+                (unsigned long long)rows, (unsigned long long)bytes,
+                rows ? (double)bytes / rows : 0.0,
+                bytes ? (double)rows * sizeof(TelemetryRecord) / bytes : 0.0);
+        return status;
+    }
+
+    printf("vehicle,tick,sim_time,throttle,brake,steer,gear,speed,"
+           "x,y,heading,rpm,power,torque,fuel,reverse\n");
+
+    int status = 0;
+    for (int i = optind; i < argc; i++)
+        status |= dump(argv[i], vehicle, NULL);
+    return status;
+}
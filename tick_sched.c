@@ -0,0 +1,95 @@
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/timerfd.h>
+
+#include "tick_sched.h"
+
+long long sched_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static struct timespec to_timespec(long long ns) {
+    struct timespec ts = { ns / 1000000000LL, ns % 1000000000LL };
+    return ts;
+}
+
+void sched_init(TickSched *s, double period_s, int policy, SchedStats *stats) {
+    s->period_ns = (long long)(period_s * 1e9);
+    s->policy = policy;
+    s->stats = stats;
+    s->deadline_ns = sched_now_ns() + s->period_ns;
+
+    if (stats) {
+        stats->period_ns = s->period_ns;
+        stats->policy = policy;
+    }
+}
+
+/* Account the wake-up for the current deadline and pick the next one. */
+void sched_expired(TickSched *s) {
+    long long now = sched_now_ns();
+    long long late = now - s->deadline_ns;
+
+    if (s->stats) {
+        hist_record(&s->stats->lateness, late > 0 ? (unsigned long)late : 0);
+        hist_add(&s->stats->ticks, 1);
+    }
+
+    long long next = s->deadline_ns + s->period_ns;
+
+    if (next > now) {
+        s->deadline_ns = next;
+        return;
+    }
+
+    /* The next deadline is already in the past: an overrun. */
+    long long behind = (now - next) / s->period_ns + 1;
+
+    if (s->policy == OVERRUN_STRETCH) {
+        s->deadline_ns = now + s->period_ns;
+    } else if (s->policy == OVERRUN_CATCHUP && behind <= MAX_CATCHUP) {
+        s->deadline_ns = next;      // fires immediately
+    } else {
+        s->deadline_ns = next + behind * s->period_ns;
+        if (s->stats)
+            hist_add(&s->stats->skipped, (unsigned long)behind);
+    }
+}
+
+void sched_wait(TickSched *s) {
+    struct timespec ts = to_timespec(s->deadline_ns);
+
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        ;
+
+    sched_expired(s);
+}
+
+void sched_arm_timerfd(TickSched *s, int tfd) {
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    its.it_value = to_timespec(s->deadline_ns);
+
+    timerfd_settime(tfd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+int sched_parse_policy(const char *name) {
+    if (strcmp(name, "skip") == 0)
+        return OVERRUN_SKIP;
+    if (strcmp(name, "catchup") == 0)
+        return OVERRUN_CATCHUP;
+    if (strcmp(name, "stretch") == 0)
+        return OVERRUN_STRETCH;
+    return -1;
+}
+
+const char *sched_policy_name(int policy) {
+    switch (policy) {
+    case OVERRUN_SKIP:    return "skip";
+    case OVERRUN_CATCHUP: return "catchup";
+    default:              return "stretch";
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef TICK_SCHED_H
+#define TICK_SCHED_H
+
+#include "common.h"
+
+/*
+ * Fixed-step tick scheduler on absolute CLOCK_MONOTONIC deadlines.
+ *
+ * Deadlines sit on a fixed grid (start + k * period), so the tick rate
+ * does not drift however long each tick's work takes.  When a tick wakes
+ * up after the following deadline has already passed, the overrun policy
+ * decides what happens to the grid:
+ *
+ *   SKIP     drop the missed deadlines and continue at the next grid point
+ *   CATCHUP  run the missed ticks back to back (at most MAX_CATCHUP behind,
+ *            beyond that it skips)
+ *   STRETCH  re-anchor the grid at now + period (the old usleep behaviour,
+ *            minus the accumulated I/O time)
+ *
+ * Each wake-up records its lateness into SchedStats.lateness.
+ */
+
+#define OVERRUN_SKIP    0
+#define OVERRUN_CATCHUP 1
+#define OVERRUN_STRETCH 2
+
+#define MAX_CATCHUP 8
+
+typedef struct {
+    long long   period_ns;
+    long long   deadline_ns;    // absolute, CLOCK_MONOTONIC
+    int         policy;
+    SchedStats *stats;
+} TickSched;
+
+long long sched_now_ns();
+
+void sched_init(TickSched *s, double period_s, int policy, SchedStats *stats);
+
+/* Blocking loops: sleep until the deadline, account it and advance. */
+void sched_wait(TickSched *s);
+
+/* Event loops: arm a timerfd for the current deadline (TFD_TIMER_ABSTIME)... */
+void sched_arm_timerfd(TickSched *s, int tfd);
+
+/* ...and call this when it fires, before running the tick. */
+void sched_expired(TickSched *s);
+
+int sched_parse_policy(const char *name);   // -1 if unknown
+const char *sched_policy_name(int policy);
+
+#endif
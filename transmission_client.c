@@ -1,161 +1,108 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <stdbool.h>
-#include <sys/socket.h>
-#include <arpa/inet.h>
 #include <time.h>
 #include <errno.h>
 #include <math.h>
+#include <getopt.h>
 
-/* ---------------- CONSTANTS ---------------- */
+#include "protocol.h"
+#include "transport.h"
+#include "sim_plugin.h"
+#include "simlog.h"
+#include "session.h"
 
-#define SERVER_PORT 9734
-#define CLIENT_ID 2   // transmission
-
-#define MAX_GEAR 5
-#define MIN_GEAR 0
-#define REVERSE_GEAR -1
-
-#define IDLE_RPM 900
-#define UPSHIFT_RPM 3500
-#define DOWNSHIFT_RPM 1500
-
-#define SPEED_EPSILON 0.1
-#define GEAR_CHANGE_COOLDOWN 0.5
-#define REVERSE_ENGAGE_SPEED 0.2   // m/s (~0.7 km/h)
-
-/* ---------------- SOCKET STRUCTS ---------------- */
-
-typedef struct {
-    int    client_id;
-    double speed_mps;
-    int    gear;
-    double rpm;
-    int    reverse;
-    double throttle;
-} TransmissionIn;
-
-typedef struct {
-    int client_id;
-    int updated_gear;
-} TransmissionOut;
-
-/* ---------------- TIME UTILS ---------------- */
-
-double now_seconds() {
-    struct timespec ts;
-    clock_gettime(CLOCK_MONOTONIC, &ts);
-    return ts.tv_sec + ts.tv_nsec * 1e-9;
-}
+#define CLIENT_ID CLIENT_TRANSMISSION
 
 /* ---------------- MAIN ---------------- */
 
-int main() {
-    int sock = socket(AF_INET, SOCK_STREAM, 0);
-
-    struct sockaddr_in addr = {0};
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(SERVER_PORT);
-    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+int main(int argc, char **argv) {
+    int vehicle_id = 0;
+    int transport = TRANSPORT_TCP;
+    const char *host = "127.0.0.1";
+
+    static const struct option opts[] = {
+        { "vehicle",   required_argument, NULL, 'v' },
+        { "transport", required_argument, NULL, 't' },
+        { "host",      required_argument, NULL, 'H' },
+        { "log",       required_argument, NULL, 'L' },
+        { "session",   required_argument, NULL, 'i' },
+        { "cpus",      required_argument, NULL, 'C' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    simlog_init();
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "v:t:H:L:i:C:", opts, NULL)) != -1) {
+        if (opt == 'v') {
+            vehicle_id = atoi(optarg);
+        } else if (opt == 't' && transport_parse(optarg) >= 0) {
+            transport = transport_parse(optarg);
+        } else if (opt == 'H') {
+            host = optarg;
+        } else if (opt == 'L' && simlog_configure(optarg)) {
+            continue;
+        } else if (opt == 'i' && session_set(optarg)) {
+            continue;
+        } else if (opt == 'C' && session_pin(optarg)) {
+            continue;
+        } else {
+            fprintf(stderr, "Usage: %s [-v vehicle_id] [-t tcp|shm] [-H host] [-L log-spec]\n"
+                    "       [-i session] [-C cpus]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
 
-    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
-        perror("Transmission: connect failed");
+    /* Identify as transmission client */
+    int id = HANDSHAKE(CLIENT_ID, vehicle_id);
+    Transport *link = transport_connect(transport, host, id);
+    if (!link) {
+        fprintf(stderr, "Transmission: connect failed\n");
         return 1;
     }
 
-    printf("[TRANSMISSION] Connected to server\n");
+    simlog(SIMLOG_INFO, "[TRANSMISSION] Connected to server");
+    simlog(SIMLOG_INFO, "[TRANSMISSION] Sent client ID = %d (vehicle %d)", CLIENT_ID, vehicle_id);
 
-    /* Identify as transmission client */
-    int id = CLIENT_ID;
-    write(sock, &id, sizeof(id));
-    printf("[TRANSMISSION] Sent client ID = %d\n", id);
-    fflush(stdout);
-
-    double last_gear_change_time = 0.0;
     int last_reported_gear = -999;
 
+    /* Per-message lines are debug; with changes=1 only when the gear moves */
+    SimLogKey rx_key = { 0 }, tx_key = { 0 };
+
     while (1) {
         TransmissionIn in;
         TransmissionOut out;
 
-        ssize_t n = read(sock, &in, sizeof(in));
-        if (n <= 0) {
-            printf("[TRANSMISSION] Server disconnected\n");
+        if (!transport_recv(link, &in, sizeof(in))) {
+            simlog(SIMLOG_INFO, "[TRANSMISSION] Server disconnected");
             break;
         }
 
-        printf(
-            "[TRANSMISSION] RX | speed=%.2f m/s gear=%d rpm=%.0f reverse=%d\n",
+        simlog_change(&rx_key, in.gear, SIMLOG_DEBUG,
+            "[TRANSMISSION] RX | speed=%.2f m/s gear=%d rpm=%.0f reverse=%d",
             in.speed_mps, in.gear, in.rpm, in.reverse
         );
 
-        out.client_id = CLIENT_ID;
-        out.updated_gear = in.gear;
-
-        double current_time = now_seconds();
-
-        /* ---------------- REVERSE HANDLING ---------------- */
-        if (in.reverse) {
-            if (fabs(in.speed_mps) < REVERSE_ENGAGE_SPEED) {
-                out.updated_gear = REVERSE_GEAR;
-            } else {
-                /* Moving → do NOT engage reverse */
-                out.updated_gear = MIN_GEAR;  // neutral
-            }
-
-            write(sock, &out, sizeof(out));
-            continue;
-        }
-                /* STATIONARY LOGIC */
-        if (in.speed_mps < SPEED_EPSILON) {
-            if (!in.reverse && in.rpm >= IDLE_RPM && in.throttle > 0.05) {
-                out.updated_gear = 1;   // engage first gear
-            } else {
-                out.updated_gear = MIN_GEAR;
-            }
-            write(sock, &out, sizeof(out));
-            continue;
-        }
-        /* ---------------- GEAR VALIDATION ---------------- */
-        else if (in.gear < REVERSE_GEAR || in.gear > MAX_GEAR) {
-            out.updated_gear = MIN_GEAR;
-        }
-        /* ---------------- COOLDOWN ---------------- */
-        else if ((current_time - last_gear_change_time) < GEAR_CHANGE_COOLDOWN) {
-            out.updated_gear = in.gear;
-        }
-        /* ---------------- UPSHIFT ---------------- */
-        else if (in.gear > 0 &&
-                 in.gear < MAX_GEAR &&
-                 in.rpm > UPSHIFT_RPM) {
-
-            out.updated_gear = in.gear + 1;
-            last_gear_change_time = current_time;
-        }
-        /* ---------------- DOWNSHIFT ---------------- */
-        else if (in.gear > 1 &&
-                 in.rpm < DOWNSHIFT_RPM) {
-
-            out.updated_gear = in.gear - 1;
-            last_gear_change_time = current_time;
-        }
+        transmission_step(&in, &out);
 
         /* Log only if gear changed */
         if (out.updated_gear != last_reported_gear) {
-            printf(
-                "[TRANSMISSION] GEAR DECISION: %d → %d\n",
+            simlog(SIMLOG_INFO,
+                "[TRANSMISSION] GEAR DECISION: %d → %d",
                 in.gear, out.updated_gear
             );
             last_reported_gear = out.updated_gear;
         }
 
-        write(sock, &out, sizeof(out));
-        printf("[TRANSMISSION] TX | updated_gear=%d\n", out.updated_gear);
-        fflush(stdout);
-
-        usleep(100000); // 100 ms
+        transport_send(link, &out, sizeof(out));
+        simlog_change(&tx_key, out.updated_gear, SIMLOG_DEBUG,
+                      "[TRANSMISSION] TX | updated_gear=%d", out.updated_gear);
     }
 
-    close(sock);
+    transport_close(link);
+    simlog_shutdown();
     return 0;
 }
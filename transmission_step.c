@@ -0,0 +1,102 @@
+#include <math.h>
+
+#include "sim_plugin.h"
+
+/* ---------------- CONSTANTS ---------------- */
+
+#define DEFAULT_TOP_GEAR 5   // until the engine reports its model's gears
+#define MIN_GEAR 0
+#define REVERSE_GEAR -1
+
+#define UPSHIFT_RPM 3500
+#define DOWNSHIFT_RPM 1500
+
+#define SPEED_EPSILON 0.1
+#define GEAR_CHANGE_COOLDOWN 0.5
+#define REVERSE_ENGAGE_SPEED 0.2   // m/s (~0.7 km/h)
+
+/* ---------------- STEP ---------------- */
+
+const ShiftParams *transmission_default_params() {
+    static const ShiftParams defaults = {
+        .upshift_rpm   = UPSHIFT_RPM,
+        .downshift_rpm = DOWNSHIFT_RPM,
+        .cooldown      = GEAR_CHANGE_COOLDOWN,
+    };
+    return &defaults;
+}
+
+void transmission_shift(const ShiftParams *p, const TransmissionIn *in, TransmissionOut *out) {
+    out->client_id = CLIENT_TRANSMISSION;
+    out->updated_gear = in->gear;
+    out->last_shift_time = in->last_shift_time;
+
+    double current_time = in->sim_time;
+    int top_gear = in->num_gears > 0 ? in->num_gears : DEFAULT_TOP_GEAR;
+
+    /* ---------------- REVERSE HANDLING ---------------- */
+    if (in->reverse) {
+        if (fabs(in->speed_mps) < REVERSE_ENGAGE_SPEED) {
+            out->updated_gear = REVERSE_GEAR;
+        } else {
+            /* Moving → do NOT engage reverse */
+            out->updated_gear = MIN_GEAR;  // neutral
+        }
+        return;
+    }
+
+    /* ---------------- STATIONARY LOGIC ---------------- */
+    if (in->speed_mps < SPEED_EPSILON) {
+        /* Any rpm means the engine is running; idle depends on the model */
+        if (in->rpm > 0.0 && in->throttle > 0.05) {
+            out->updated_gear = 1;   // engage first gear
+        } else {
+            out->updated_gear = MIN_GEAR;
+        }
+    }
+    /* ---------------- GEAR VALIDATION ---------------- */
+    else if (in->gear < REVERSE_GEAR || in->gear > top_gear) {
+        out->updated_gear = MIN_GEAR;
+    }
+    /* ---------------- COOLDOWN ---------------- */
+    else if ((current_time - in->last_shift_time) < p->cooldown) {
+        out->updated_gear = in->gear;
+    }
+    /* ---------------- UPSHIFT ---------------- */
+    else if (in->gear > 0 &&
+             in->gear < top_gear &&
+             in->rpm > p->upshift_rpm) {
+
+        out->updated_gear = in->gear + 1;
+        out->last_shift_time = current_time;
+    }
+    /* ---------------- DOWNSHIFT ---------------- */
+    else if (in->gear > 1 &&
+             in->rpm < p->downshift_rpm) {
+
+        out->updated_gear = in->gear - 1;
+        out->last_shift_time = current_time;
+    }
+}
+
+void transmission_step(const TransmissionIn *in, TransmissionOut *out) {
+    transmission_shift(transmission_default_params(), in, out);
+}
+
+/* ---------------- PLUGIN DESCRIPTOR ---------------- */
+
+static void step(void *state, const void *in, void *out) {
+    (void)state;
+    transmission_step(in, out);
+}
+
+const SimPlugin transmission_plugin = {
+    .abi        = SIM_PLUGIN_ABI,
+    .type       = CLIENT_TRANSMISSION,
+    .name       = "transmission",
+    .state_size = 0,
+    .in_size    = sizeof(TransmissionIn),
+    .out_size   = sizeof(TransmissionOut),
+    .init       = NULL,
+    .step       = step,
+};
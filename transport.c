@@ -0,0 +1,396 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "transport.h"
+#include "protocol.h"
+#include "session.h"
+
+/* Polls of the ring before a consumer blocks (multi-core hosts only). */
+#define RING_SPIN 2000
+
+static int  endpoint_port = 0;          // 0: the session's
+static char endpoint_path[108];         // "": the session's
+
+#if defined(__x86_64__) || defined(__i386__)
+#define cpu_relax() __builtin_ia32_pause()
+#else
+#define cpu_relax() ((void)0)
+#endif
+
+/* ---------------- SPSC RING ---------------- */
+
+bool ring_push(ShmRing *r, const void *msg, size_t len) {
+    unsigned head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+
+    if (head - tail == RING_SLOTS || len > RING_MSG_MAX)
+        return false;
+
+    RingSlot *slot = &r->slots[head & (RING_SLOTS - 1)];
+    slot->len = (unsigned)len;
+    memcpy(slot->data, msg, len);
+
+    atomic_store_explicit(&r->head, head + 1, memory_order_release);
+    return true;
+}
+
+bool ring_pop(ShmRing *r, void *msg, size_t len) {
+    unsigned tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&r->head, memory_order_acquire);
+
+    if (head == tail)
+        return false;
+
+    RingSlot *slot = &r->slots[tail & (RING_SLOTS - 1)];
+    memcpy(msg, slot->data, slot->len < len ? slot->len : len);
+
+    atomic_store_explicit(&r->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+/* ---------------- HELPERS ---------------- */
+
+static bool write_full(int fd, const void *buf, size_t len) {
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = write(fd, (const char *)buf + done, len - done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        done += (size_t)n;
+    }
+    return true;
+}
+
+static bool read_full(int fd, void *buf, size_t len) {
+    size_t got = 0;
+    while (got < len) {
+        ssize_t n = read(fd, (char *)buf + got, len - got);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        got += (size_t)n;
+    }
+    return true;
+}
+
+static int spin_limit() {
+    static int limit = -1;
+    if (limit < 0)
+        limit = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? RING_SPIN : 0;
+    return limit;
+}
+
+static void ring_signal(ShmRing *r, int efd) {
+    /* Pairs with the fence in shm_wait(): either we see waiting, or the
+       consumer sees our head update before it sleeps. */
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&r->waiting, memory_order_relaxed)) {
+        uint64_t one = 1;
+        write(efd, &one, sizeof(one));
+    }
+}
+
+static bool shm_wait(Transport *t, void *buf, size_t len) {
+    int spins = spin_limit();
+
+    for (;;) {
+        for (int i = 0; i < spins; i++) {
+            if (ring_pop(t->rx, buf, len))
+                return true;
+            cpu_relax();
+        }
+
+        atomic_store_explicit(&t->rx->waiting, 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+
+        if (ring_pop(t->rx, buf, len)) {
+            atomic_store_explicit(&t->rx->waiting, 0, memory_order_relaxed);
+            return true;
+        }
+
+        /* The unix socket only ever becomes readable at hangup. */
+        struct pollfd pfd[2] = {
+            { .fd = t->rx_efd, .events = POLLIN },
+            { .fd = t->fd,     .events = POLLIN },
+        };
+        if (poll(pfd, 2, -1) < 0 && errno != EINTR)
+            return false;
+
+        if (pfd[0].revents & POLLIN) {
+            uint64_t count;
+            read(t->rx_efd, &count, sizeof(count));
+        }
+        atomic_store_explicit(&t->rx->waiting, 0, memory_order_relaxed);
+
+        if (ring_pop(t->rx, buf, len))
+            return true;
+        if (pfd[1].revents)
+            return false;
+    }
+}
+
+/* ---------------- CONNECT ---------------- */
+
+static Transport *tcp_connect(const char *host) {
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0) {
+        perror("socket");
+        return NULL;
+    }
+
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(endpoint_port ? endpoint_port : session_port());
+    addr.sin_addr.s_addr = inet_addr(host);
+
+    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("connect");
+        close(sock);
+        return NULL;
+    }
+
+    int one = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    Transport *t = calloc(1, sizeof(Transport));
+    t->kind = TRANSPORT_TCP;
+    t->fd = sock;
+    t->rx_efd = t->tx_efd = -1;
+    return t;
+}
+
+static Transport *shm_connect() {
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock < 0) {
+        perror("socket");
+        return NULL;
+    }
+
+    struct sockaddr_un addr = {0};
+    addr.sun_family = AF_UNIX;
+    const char *path = endpoint_path[0] ? endpoint_path : session_socket_path();
+    if (snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path) >= (int)sizeof(addr.sun_path)) {
+        fprintf(stderr, "%s: socket path too long\n", path);
+        close(sock);
+        return NULL;
+    }
+
+    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("connect");
+        close(sock);
+        return NULL;
+    }
+
+    Transport *t = calloc(1, sizeof(Transport));
+    t->kind = TRANSPORT_SHM;
+    t->fd = sock;
+    t->rx_efd = t->tx_efd = -1;
+    return t;
+}
+
+/* Receive the memfd and both eventfds the server sent after the handshake. */
+static bool shm_receive_channel(Transport *t) {
+    char ack;
+    struct iovec iov = { .iov_base = &ack, .iov_len = 1 };
+
+    union {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE(3 * sizeof(int))];
+    } ctrl;
+
+    struct msghdr msg = {0};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl.buf;
+    msg.msg_controllen = sizeof(ctrl.buf);
+
+    if (recvmsg(t->fd, &msg, 0) <= 0)
+        return false;
+
+    struct cmsghdr *c = CMSG_FIRSTHDR(&msg);
+    if (!c || c->cmsg_type != SCM_RIGHTS ||
+        c->cmsg_len != CMSG_LEN(3 * sizeof(int)))
+        return false;
+
+    int fds[3];
+    memcpy(fds, CMSG_DATA(c), sizeof(fds));
+
+    t->chan = mmap(NULL, sizeof(ShmChannel), PROT_READ | PROT_WRITE,
+                   MAP_SHARED, fds[0], 0);
+    close(fds[0]);
+    if (t->chan == MAP_FAILED) {
+        t->chan = NULL;
+        close(fds[1]);
+        close(fds[2]);
+        return false;
+    }
+
+    t->rx = &t->chan->to_client;
+    t->tx = &t->chan->to_server;
+    t->rx_efd = fds[1];
+    t->tx_efd = fds[2];
+    return true;
+}
+
+void transport_set_endpoint(int port, const char *socket_path) {
+    endpoint_port = port;
+    if (socket_path)
+        snprintf(endpoint_path, sizeof(endpoint_path), "%s", socket_path);
+}
+
+Transport *transport_connect(int kind, const char *host, int handshake) {
+    Transport *t = (kind == TRANSPORT_SHM) ? shm_connect() : tcp_connect(host);
+    if (!t)
+        return NULL;
+
+    if (!write_full(t->fd, &handshake, sizeof(handshake)) ||
+        (kind == TRANSPORT_SHM && !shm_receive_channel(t))) {
+        fprintf(stderr, "transport: handshake failed\n");
+        transport_close(t);
+        return NULL;
+    }
+
+    return t;
+}
+
+/* ---------------- SERVER SIDE ---------------- */
+
+Transport *transport_shm_accept(int sock) {
+    int mfd = memfd_create("car_sim_channel", MFD_CLOEXEC);
+    if (mfd < 0) {
+        perror("memfd_create");
+        return NULL;
+    }
+
+    if (ftruncate(mfd, sizeof(ShmChannel)) < 0) {
+        perror("ftruncate");
+        close(mfd);
+        return NULL;
+    }
+
+    ShmChannel *chan = mmap(NULL, sizeof(ShmChannel), PROT_READ | PROT_WRITE,
+                            MAP_SHARED, mfd, 0);
+    if (chan == MAP_FAILED) {
+        perror("mmap");
+        close(mfd);
+        return NULL;
+    }
+
+    int to_client_efd = eventfd(0, EFD_CLOEXEC);
+    int to_server_efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+    /* The server never sleeps on its ring directly: it always sits in
+       epoll on the doorbell, so clients must always ring it. */
+    atomic_store(&chan->to_server.waiting, 1);
+
+    char ack = 1;
+    struct iovec iov = { .iov_base = &ack, .iov_len = 1 };
+
+    union {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE(3 * sizeof(int))];
+    } ctrl;
+    memset(&ctrl, 0, sizeof(ctrl));
+
+    struct msghdr msg = {0};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl.buf;
+    msg.msg_controllen = sizeof(ctrl.buf);
+
+    struct cmsghdr *c = CMSG_FIRSTHDR(&msg);
+    c->cmsg_level = SOL_SOCKET;
+    c->cmsg_type = SCM_RIGHTS;
+    c->cmsg_len = CMSG_LEN(3 * sizeof(int));
+
+    int fds[3] = { mfd, to_client_efd, to_server_efd };
+    memcpy(CMSG_DATA(c), fds, sizeof(fds));
+
+    ssize_t sent = sendmsg(sock, &msg, MSG_NOSIGNAL);
+    close(mfd);
+
+    if (sent <= 0 || to_client_efd < 0 || to_server_efd < 0) {
+        munmap(chan, sizeof(ShmChannel));
+        if (to_client_efd >= 0) close(to_client_efd);
+        if (to_server_efd >= 0) close(to_server_efd);
+        return NULL;
+    }
+
+    Transport *t = calloc(1, sizeof(Transport));
+    t->kind = TRANSPORT_SHM;
+    t->fd = sock;
+    t->chan = chan;
+    t->rx = &chan->to_server;
+    t->tx = &chan->to_client;
+    t->rx_efd = to_server_efd;
+    t->tx_efd = to_client_efd;
+    return t;
+}
+
+/* ---------------- SEND / RECEIVE ---------------- */
+
+bool transport_send(Transport *t, const void *buf, size_t len) {
+    if (t->kind == TRANSPORT_TCP)
+        return write_full(t->fd, buf, len);
+
+    /* One request in flight per direction, so a full ring is a bug. */
+    if (!ring_push(t->tx, buf, len))
+        return false;
+
+    ring_signal(t->tx, t->tx_efd);
+    return true;
+}
+
+bool transport_recv(Transport *t, void *buf, size_t len) {
+    if (t->kind == TRANSPORT_TCP)
+        return read_full(t->fd, buf, len);
+
+    return shm_wait(t, buf, len);
+}
+
+void transport_clear_doorbell(Transport *t) {
+    uint64_t count;
+    read(t->rx_efd, &count, sizeof(count));    // non-blocking on the server
+}
+
+bool transport_try_recv(Transport *t, void *buf, size_t len) {
+    return ring_pop(t->rx, buf, len);
+}
+
+void transport_close(Transport *t) {
+    if (!t)
+        return;
+
+    if (t->chan)
+        munmap(t->chan, sizeof(ShmChannel));
+    if (t->rx_efd >= 0) close(t->rx_efd);
+    if (t->tx_efd >= 0) close(t->tx_efd);
+    if (t->fd >= 0) close(t->fd);
+    free(t);
+}
+
+int transport_parse(const char *name) {
+    if (strcmp(name, "tcp") == 0)
+        return TRANSPORT_TCP;
+    if (strcmp(name, "shm") == 0)
+        return TRANSPORT_SHM;
+    return -1;
+}
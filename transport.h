@@ -0,0 +1,105 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+/*
+ * Client <-> server message transports.
+ *
+ * TCP: the original socket path, usable across machines.
+ *
+ * SHM: same-host only.  The client connects to a unix socket and sends the
+ *      usual handshake int; the server answers with a memfd holding one
+ *      SPSC ring per direction plus two eventfds for wakeups (SCM_RIGHTS).
+ *      After that the socket only carries hangup notification, and the
+ *      messages themselves never pass through the kernel.
+ */
+
+#define TRANSPORT_TCP 0
+#define TRANSPORT_SHM 1
+
+#define SHM_SOCKET_PATH "/tmp/car_sim.sock"
+
+/* ---------------- SPSC RING ---------------- */
+
+#define RING_SLOTS     8            // power of two
+#define RING_SLOT_SIZE 128
+#define RING_MSG_MAX   (RING_SLOT_SIZE - sizeof(unsigned))
+
+#define CACHE_LINE 64
+
+typedef struct {
+    unsigned      len;
+    unsigned char data[RING_MSG_MAX];
+} RingSlot;
+
+/*
+ * head is written only by the producer, tail only by the consumer; each
+ * sits on its own cache line.  `waiting` is set by a consumer that is about
+ * to block on the eventfd, so producers only pay for a write() when
+ * someone is actually asleep.
+ */
+typedef struct {
+    _Alignas(CACHE_LINE) atomic_uint head;
+    _Alignas(CACHE_LINE) atomic_uint tail;
+    _Alignas(CACHE_LINE) atomic_uint waiting;
+    _Alignas(CACHE_LINE) RingSlot slots[RING_SLOTS];
+} ShmRing;
+
+typedef struct {
+    ShmRing to_client;
+    ShmRing to_server;
+} ShmChannel;
+
+bool ring_push(ShmRing *r, const void *msg, size_t len);
+bool ring_pop(ShmRing *r, void *msg, size_t len);
+
+/* ---------------- ENDPOINT ---------------- */
+
+typedef struct {
+    int kind;           // TRANSPORT_*
+    int fd;             // TCP socket, or the unix socket (hangup only) for SHM
+
+    /* SHM only */
+    ShmChannel *chan;
+    ShmRing    *rx;
+    ShmRing    *tx;
+    int         rx_efd; // signalled when rx gets a message
+    int         tx_efd; // we signal this after pushing to tx
+} Transport;
+
+/*
+ * Where transport_connect() goes: the session's port and socket path (see
+ * session.h) unless overridden (socket_path may be NULL to keep the
+ * current one).
+ */
+void transport_set_endpoint(int port, const char *socket_path);
+
+/* Client side: connect and send the handshake.  NULL on failure. */
+Transport *transport_connect(int kind, const char *host, int handshake);
+
+/*
+ * Server side of SHM: build the channel for an accepted unix socket that
+ * has already sent its handshake, and hand it to the client.  The returned
+ * endpoint's rx_efd is what the server should poll.
+ */
+Transport *transport_shm_accept(int sock);
+
+/* Blocking send/receive of one whole message.  false = peer is gone. */
+bool transport_send(Transport *t, const void *buf, size_t len);
+bool transport_recv(Transport *t, void *buf, size_t len);
+
+/*
+ * SHM only, for an event loop polling rx_efd: clear the doorbell, then
+ * pop messages until transport_try_recv() says the ring is empty.
+ */
+void transport_clear_doorbell(Transport *t);
+bool transport_try_recv(Transport *t, void *buf, size_t len);
+
+void transport_close(Transport *t);
+
+int transport_parse(const char *name);   // "tcp" / "shm", -1 if unknown
+
+#endif
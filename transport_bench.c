@@ -0,0 +1,205 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "protocol.h"
+#include "transport.h"
+
+/*
+ * Round-trip latency of one engine exchange (EngineStateIn out,
+ * EngineStateOut back) over each transport.  The parent plays the server,
+ * a forked child plays an engine client that answers immediately.
+ */
+
+/* ---------------- CONSTANTS ---------------- */
+
+#define DEFAULT_ITERATIONS 100000
+#define WARMUP 1000
+
+/* ---------------- TIME UTILS ---------------- */
+
+static double now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* ---------------- ECHO CLIENT ---------------- */
+
+static void run_client(int kind) {
+    Transport *t = transport_connect(kind, "127.0.0.1",
+                                     HANDSHAKE(CLIENT_ENGINE, 0));
+    if (!t)
+        _exit(1);
+
+    EngineStateIn in;
+    EngineStateOut out;
+    memset(&out, 0, sizeof(out));
+
+    while (transport_recv(t, &in, sizeof(in))) {
+        out.speed = in.speed;
+        if (!transport_send(t, &out, sizeof(out)))
+            break;
+    }
+
+    transport_close(t);
+    _exit(0);
+}
+
+/* ---------------- SERVER SIDE ---------------- */
+
+static int listen_tcp(int *port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+
+    socklen_t len = sizeof(addr);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(fd, 1) < 0 ||
+        getsockname(fd, (struct sockaddr *)&addr, &len) < 0) {
+        perror("tcp listen");
+        exit(1);
+    }
+
+    *port = ntohs(addr.sin_port);
+    return fd;
+}
+
+static int listen_unix(const char *path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    struct sockaddr_un addr = {0};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(fd, 1) < 0) {
+        perror("unix listen");
+        exit(1);
+    }
+    return fd;
+}
+
+static void bench(int kind, int iterations) {
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/car_sim_bench.%d.sock", (int)getpid());
+
+    int port = 0;
+    int lfd = (kind == TRANSPORT_SHM) ? listen_unix(path) : listen_tcp(&port);
+    transport_set_endpoint(port, path);
+
+    pid_t child = fork();
+    if (child == 0) {
+        close(lfd);
+        run_client(kind);
+    }
+
+    int sock = accept(lfd, NULL, NULL);
+    close(lfd);
+
+    int handshake;
+    if (read(sock, &handshake, sizeof(handshake)) != sizeof(handshake)) {
+        fprintf(stderr, "bench: no handshake\n");
+        exit(1);
+    }
+
+    Transport *t;
+    if (kind == TRANSPORT_SHM) {
+        t = transport_shm_accept(sock);
+        unlink(path);
+    } else {
+        int one = 1;
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        t = calloc(1, sizeof(Transport));
+        t->kind = TRANSPORT_TCP;
+        t->fd = sock;
+        t->rx_efd = t->tx_efd = -1;
+    }
+    if (!t)
+        exit(1);
+
+    double *rtt = malloc(sizeof(double) * iterations);
+
+    EngineStateIn in;
+    EngineStateOut out;
+    memset(&in, 0, sizeof(in));
+
+    for (int i = 0; i < WARMUP + iterations; i++) {
+        in.speed = i;
+
+        double t0 = now_ns();
+        if (!transport_send(t, &in, sizeof(in)) ||
+            !transport_recv(t, &out, sizeof(out))) {
+            fprintf(stderr, "bench: client went away\n");
+            exit(1);
+        }
+        double t1 = now_ns();
+
+        if (out.speed != in.speed) {
+            fprintf(stderr, "bench: reply mismatch\n");
+            exit(1);
+        }
+        if (i >= WARMUP)
+            rtt[i - WARMUP] = t1 - t0;
+    }
+
+    transport_close(t);
+    waitpid(child, NULL, 0);
+
+    double sum = 0.0;
+    for (int i = 0; i < iterations; i++)
+        sum += rtt[i];
+    qsort(rtt, iterations, sizeof(double), cmp_double);
+
+    printf("%-4s %10.2f %10.2f %10.2f %10.2f %10.2f\n",
+           kind == TRANSPORT_SHM ? "shm" : "tcp",
+           sum / iterations / 1e3,
+           rtt[iterations / 2] / 1e3,
+           rtt[(int)(iterations * 0.99)] / 1e3,
+           rtt[(int)(iterations * 0.999)] / 1e3,
+           rtt[iterations - 1] / 1e3);
+
+    free(rtt);
+}
+
+/* ---------------- MAIN ---------------- */
+
+int main(int argc, char **argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : DEFAULT_ITERATIONS;
+    if (iterations <= 0) {
+        fprintf(stderr, "Usage: %s [iterations]\n", argv[0]);
+        return 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+
+    printf("engine round trip, %d iterations (us)\n", iterations);
+    printf("%-4s %10s %10s %10s %10s %10s\n",
+           "", "mean", "p50", "p99", "p99.9", "max");
+
+    bench(TRANSPORT_TCP, iterations);
+    bench(TRANSPORT_SHM, iterations);
+
+    return 0;
+}
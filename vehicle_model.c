@@ -0,0 +1,249 @@
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vehicle_model.h"
+
+#define PI 3.14159265359
+
+/* ---------------- BUILT-IN MODEL ---------------- */
+
+static void set_defaults(VehicleModel *m) {
+    memset(m, 0, sizeof(*m));
+
+    strcpy(m->name, "default");
+    m->mass         = 1500.0;
+    m->wheel_radius = 0.3;
+    m->final_drive  = 3.5;
+    m->efficiency   = 0.85 * 0.95;     // system * driveline
+
+    static const double gears[] = { 3.5, 2.0, 1.5, 1.0, 0.8 };
+    m->num_gears = 5;
+    memcpy(m->gears, gears, sizeof(gears));
+    m->reverse_ratio = 3.5;
+
+    m->idle_rpm          = 900.0;
+    m->max_rpm           = 7000.0;
+    m->max_power         = 150000.0;
+    m->resistance        = 0.1;
+    m->max_speed         = 100.0;
+    m->max_reverse_speed = 5.5;
+
+    /* Linear rise to 250 Nm at 3500 rpm, linear fall to zero at redline */
+    static const double rpm[]    = { 0.0, 3500.0, 7000.0 };
+    static const double torque[] = { 0.0,  250.0,    0.0 };
+    m->num_points = 3;
+    memcpy(m->map_rpm, rpm, sizeof(rpm));
+    memcpy(m->map_torque, torque, sizeof(torque));
+}
+
+/* ---------------- TABLES ---------------- */
+
+/* Piecewise-linear map, flat beyond the ends. */
+static double map_torque(const VehicleModel *m, double rpm) {
+    if (rpm <= m->map_rpm[0])
+        return m->map_torque[0];
+
+    for (int i = 1; i < m->num_points; i++) {
+        if (rpm <= m->map_rpm[i]) {
+            double r0 = m->map_rpm[i - 1], r1 = m->map_rpm[i];
+            double t0 = m->map_torque[i - 1], t1 = m->map_torque[i];
+            return t0 + (t1 - t0) * (rpm - r0) / (r1 - r0);
+        }
+    }
+    return m->map_torque[m->num_points - 1];
+}
+
+static void build_tables(VehicleModel *m) {
+    double step = m->max_rpm / TORQUE_TABLE_SIZE;
+    m->torque_cells_per_rpm = TORQUE_TABLE_SIZE / m->max_rpm;
+
+    for (int i = 0; i < TORQUE_TABLE_SIZE; i++) {
+        double r0 = i * step, r1 = (i + 1) * step;
+        double t0 = map_torque(m, r0), t1 = map_torque(m, r1);
+        double slope = (t1 - t0) / step;
+
+        m->torque_b[i] = slope;
+        m->torque_a[i] = t0 - slope * r0;
+    }
+    /* rpm == max_rpm lands one past the end */
+    m->torque_a[TORQUE_TABLE_SIZE] = map_torque(m, m->max_rpm);
+    m->torque_b[TORQUE_TABLE_SIZE] = 0.0;
+
+    /* Slot 0 reverse, 1 neutral, 2.. forward gears; past the top gear it stays */
+    double wheel_rpm_per_mps = 60.0 / (2.0 * PI * m->wheel_radius);
+    double force_per_nm = m->final_drive * m->efficiency / m->wheel_radius;
+
+    for (int slot = 0; slot < MODEL_GEAR_SLOTS; slot++) {
+        double ratio;
+        if (slot == 0)
+            ratio = m->reverse_ratio;
+        else if (slot == 1)
+            ratio = 0.0;
+        else if (slot - 2 < m->num_gears)
+            ratio = m->gears[slot - 2];
+        else
+            ratio = m->gears[m->num_gears - 1];
+
+        m->rpm_per_mps[slot]  = ratio * m->final_drive * wheel_rpm_per_mps;
+        m->accel_per_nm[slot] = ratio * force_per_nm / m->mass;
+    }
+}
+
+const VehicleModel *vehicle_model_default() {
+    static VehicleModel model;
+    static int built = 0;
+
+    if (!built) {
+        set_defaults(&model);
+        build_tables(&model);
+        built = 1;
+    }
+    return &model;
+}
+
+/* ---------------- LOADING ---------------- */
+
+static VehicleModel *fail(VehicleModel *m, FILE *f, const char *path, int line,
+                          const char *what) {
+    fprintf(stderr, "%s:%d: %s\n", path, line, what);
+    fclose(f);
+    free(m);
+    return NULL;
+}
+
+VehicleModel *vehicle_model_load(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return NULL;
+    }
+
+    VehicleModel *m = aligned_alloc(64, sizeof(VehicleModel));
+    set_defaults(m);
+
+    int custom_map = 0;
+    char line[256];
+    int lineno = 0;
+
+    while (fgets(line, sizeof(line), f)) {
+        lineno++;
+
+        char *hash = strchr(line, '#');
+        if (hash)
+            *hash = '\0';
+
+        char key[32];
+        int used;
+        if (sscanf(line, "%31s%n", key, &used) != 1)
+            continue;   // blank or comment
+        char *rest = line + used;
+
+        if (strcmp(key, "name") == 0) {
+            sscanf(rest, "%31s", m->name);
+        } else if (strcmp(key, "gears") == 0) {
+            m->num_gears = 0;
+            double ratio;
+            int n;
+            while (m->num_gears < MAX_MODEL_GEARS &&
+                   sscanf(rest, "%lf%n", &ratio, &n) == 1) {
+                m->gears[m->num_gears++] = ratio;
+                rest += n;
+            }
+            if (m->num_gears == 0)
+                return fail(m, f, path, lineno, "gears needs at least one ratio");
+        } else if (strcmp(key, "torque") == 0) {
+            if (!custom_map) {
+                m->num_points = 0;
+                custom_map = 1;
+            }
+            if (m->num_points == MAX_TORQUE_POINTS)
+                return fail(m, f, path, lineno, "too many torque points");
+
+            double rpm, nm;
+            if (sscanf(rest, "%lf %lf", &rpm, &nm) != 2)
+                return fail(m, f, path, lineno, "torque needs rpm and Nm");
+            if (m->num_points > 0 && rpm <= m->map_rpm[m->num_points - 1])
+                return fail(m, f, path, lineno, "torque points must be in increasing rpm");
+
+            m->map_rpm[m->num_points] = rpm;
+            m->map_torque[m->num_points] = nm;
+            m->num_points++;
+        } else {
+            static const struct { const char *key; size_t offset; } scalars[] = {
+                { "mass",              offsetof(VehicleModel, mass) },
+                { "wheel_radius",      offsetof(VehicleModel, wheel_radius) },
+                { "final_drive",       offsetof(VehicleModel, final_drive) },
+                { "efficiency",        offsetof(VehicleModel, efficiency) },
+                { "reverse",           offsetof(VehicleModel, reverse_ratio) },
+                { "idle_rpm",          offsetof(VehicleModel, idle_rpm) },
+                { "max_rpm",           offsetof(VehicleModel, max_rpm) },
+                { "max_power",         offsetof(VehicleModel, max_power) },
+                { "resistance",        offsetof(VehicleModel, resistance) },
+                { "max_speed",         offsetof(VehicleModel, max_speed) },
+                { "max_reverse_speed", offsetof(VehicleModel, max_reverse_speed) },
+            };
+
+            size_t i;
+            for (i = 0; i < sizeof(scalars) / sizeof(scalars[0]); i++)
+                if (strcmp(key, scalars[i].key) == 0)
+                    break;
+            if (i == sizeof(scalars) / sizeof(scalars[0]))
+                return fail(m, f, path, lineno, "unknown key");
+
+            double *field = (double *)((char *)m + scalars[i].offset);
+            if (sscanf(rest, "%lf", field) != 1)
+                return fail(m, f, path, lineno, "expected a number");
+        }
+    }
+
+    if (m->mass <= 0.0 || m->wheel_radius <= 0.0 || m->max_rpm <= m->idle_rpm)
+        return fail(m, f, path, lineno, "mass, wheel_radius or rpm range invalid");
+
+    fclose(f);
+    build_tables(m);
+    return m;
+}
+
+void vehicle_model_free(VehicleModel *m) {
+    free(m);
+}
+
+void vehicle_model_rebuild(VehicleModel *m) {
+    build_tables(m);
+}
+
+/* ---------------- IDENTITY ---------------- */
+
+static uint64_t fnv1a(uint64_t h, const void *data, size_t len) {
+    const unsigned char *p = data;
+    for (size_t i = 0; i < len; i++)
+        h = (h ^ p[i]) * 1099511628211ull;
+    return h;
+}
+
+#define HASH_FIELD(h, m, f) fnv1a(h, &(m)->f, sizeof((m)->f))
+
+uint64_t vehicle_model_hash(const VehicleModel *m) {
+    uint64_t h = 14695981039346656037ull;
+    h = fnv1a(h, m->name, strnlen(m->name, sizeof(m->name)));
+    h = HASH_FIELD(h, m, mass);
+    h = HASH_FIELD(h, m, wheel_radius);
+    h = HASH_FIELD(h, m, final_drive);
+    h = HASH_FIELD(h, m, efficiency);
+    h = HASH_FIELD(h, m, num_gears);
+    h = fnv1a(h, m->gears, m->num_gears * sizeof(m->gears[0]));
+    h = HASH_FIELD(h, m, reverse_ratio);
+    h = HASH_FIELD(h, m, idle_rpm);
+    h = HASH_FIELD(h, m, max_rpm);
+    h = HASH_FIELD(h, m, max_power);
+    h = HASH_FIELD(h, m, resistance);
+    h = HASH_FIELD(h, m, max_speed);
+    h = HASH_FIELD(h, m, max_reverse_speed);
+    h = HASH_FIELD(h, m, num_points);
+    h = fnv1a(h, m->map_rpm, m->num_points * sizeof(m->map_rpm[0]));
+    h = fnv1a(h, m->map_torque, m->num_points * sizeof(m->map_torque[0]));
+    return h;
+}
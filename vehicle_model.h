@@ -0,0 +1,96 @@
+#ifndef VEHICLE_MODEL_H
+#define VEHICLE_MODEL_H
+
+#include <stdint.h>
+
+/*
+ * Vehicle models: drivetrain constants and a torque map, loaded from a
+ * text file and turned into lookup tables once.
+ *
+ *     name          hatchback
+ *     mass          1250          # kg
+ *     wheel_radius  0.31          # m
+ *     final_drive   4.1
+ *     efficiency    0.85          # engine to wheels
+ *     gears         3.6 2.1 1.4 1.0 0.8
+ *     reverse       3.4
+ *     idle_rpm      850
+ *     max_rpm       6800
+ *     max_power     96000         # W
+ *     resistance    0.1           # deceleration per m/s of speed, 1/s
+ *     max_speed     55            # m/s
+ *     max_reverse_speed 5.5
+ *     torque        1000 140      # rpm  Nm, one line per map point
+ *     torque        4000 210
+ *
+ * Missing keys keep the built-in model's value.  The map is linear between
+ * points and flat beyond the ends.
+ *
+ * At load time the map is resampled into TORQUE_TABLE_SIZE cells over
+ * 0..max_rpm, each cell stored as intercept + slope so a lookup is one
+ * index and one multiply-add, and each gear gets its rpm-per-speed and
+ * acceleration-per-Nm factors.
+ */
+
+#define MAX_MODEL_GEARS    8
+#define MODEL_GEAR_SLOTS   (MAX_MODEL_GEARS + 2)   // reverse, neutral, 1..N
+#define MAX_TORQUE_POINTS  64
+#define TORQUE_TABLE_SIZE  256
+
+typedef struct {
+    /* Torque lookup: cell i covers [i, i+1) / torque_cells_per_rpm */
+    _Alignas(64) double torque_a[TORQUE_TABLE_SIZE + 1];   // intercept, Nm
+    _Alignas(64) double torque_b[TORQUE_TABLE_SIZE + 1];   // slope, Nm/rpm
+    double torque_cells_per_rpm;
+
+    /* Per gear slot (vm_gear_slot): 0 in neutral */
+    _Alignas(64) double rpm_per_mps[MODEL_GEAR_SLOTS];
+    _Alignas(64) double accel_per_nm[MODEL_GEAR_SLOTS];    // m/s^2 per Nm
+
+    double idle_rpm;
+    double max_rpm;
+    double max_power;
+    double resistance;
+    double max_speed;
+    double max_reverse_speed;
+
+    /* As loaded */
+    char   name[32];
+    double mass;
+    double wheel_radius;
+    double final_drive;
+    double efficiency;
+    int    num_gears;
+    double gears[MAX_MODEL_GEARS];
+    double reverse_ratio;
+    int    num_points;
+    double map_rpm[MAX_TORQUE_POINTS];
+    double map_torque[MAX_TORQUE_POINTS];
+} VehicleModel;
+
+/* Built-in model (the original triangular 250 Nm curve); never NULL. */
+const VehicleModel *vehicle_model_default();
+
+/* NULL (with a message on stderr) if missing or malformed. */
+VehicleModel *vehicle_model_load(const char *path);
+void vehicle_model_free(VehicleModel *m);
+
+/* Recompute the tables after changing the as-loaded fields of a copy. */
+void vehicle_model_rebuild(VehicleModel *m);
+
+/* FNV-1a over the as-loaded fields: equal for models that step alike. */
+uint64_t vehicle_model_hash(const VehicleModel *m);
+
+/* Gear -1 (reverse) .. MAX_MODEL_GEARS to a table slot; 0 is neutral. */
+static inline int vm_gear_slot(int gear) {
+    int slot = gear + 1;
+    return slot < 0 ? 1 : (slot >= MODEL_GEAR_SLOTS ? MODEL_GEAR_SLOTS - 1 : slot);
+}
+
+/* Full-throttle torque at rpm, which must be in 0..max_rpm. */
+static inline double vm_torque(const VehicleModel *m, double rpm) {
+    int i = (int)(rpm * m->torque_cells_per_rpm);
+    return m->torque_a[i] + m->torque_b[i] * rpm;
+}
+
+#endif
@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+
+#include "view.h"
+
+/* ---------------- VIEWER ---------------- */
+
+int view_subscribe(SimShared *sim, const ViewFilter *f) {
+    for (int i = 0; i < MAX_VIEWERS; i++) {
+        ViewSlot *s = &sim->views[i];
+        int expected = VIEW_FREE;
+        if (!atomic_compare_exchange_strong(&s->state, &expected, VIEW_CLAIMED))
+            continue;
+
+        s->owner = (int)getpid();
+        view_set_filter(sim, i, f);
+        atomic_store_explicit(&s->state, VIEW_ACTIVE, memory_order_release);
+        atomic_fetch_add_explicit(&sim->view_claims, 1, memory_order_release);
+        return i;
+    }
+    fprintf(stderr, "all %d viewer slots are taken\n", MAX_VIEWERS);
+    return -1;
+}
+
+void view_set_filter(SimShared *sim, int slot, const ViewFilter *f) {
+    ViewSlot *s = &sim->views[slot];
+    unsigned seq = atomic_load_explicit(&s->filter_seq, memory_order_relaxed);
+
+    atomic_store_explicit(&s->filter_seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    s->filter = *f;
+    atomic_store_explicit(&s->filter_seq, seq + 2, memory_order_release);
+}
+
+void view_unsubscribe(SimShared *sim, int slot) {
+    if (slot >= 0)
+        atomic_store_explicit(&sim->views[slot].state, VIEW_FREE, memory_order_release);
+}
+
+bool view_read(const SimShared *sim, int slot, unsigned after, ViewFrame *out) {
+    const ViewSlot *s = &sim->views[slot];
+
+    for (;;) {
+        unsigned seq = atomic_load_explicit(&s->seq, memory_order_acquire);
+        if (seq & 1)
+            continue;
+        if (s->frame == after)
+            return false;
+
+        out->frame    = s->frame;
+        out->sim_time = s->sim_time;
+        out->count    = s->count;
+        if (out->count < 0 || out->count > MAX_VEHICLES)
+            out->count = 0;
+        memcpy(out->match, s->match, out->count * sizeof(int));
+
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&s->seq, memory_order_relaxed) == seq)
+            return true;
+    }
+}
+
+bool view_parse_area(ViewFilter *f, const char *arg) {
+    double x0, y0, x1, y1;
+    char end;
+    if (sscanf(arg, "%lf,%lf,%lf,%lf%c", &x0, &y0, &x1, &y1, &end) != 4 ||
+        x1 <= x0 || y1 <= y0) {
+        fprintf(stderr, "area must be x0,y0,x1,y1 with x0 < x1 and y0 < y1\n");
+        return false;
+    }
+    f->flags |= VIEW_REGION;
+    f->x0 = x0;
+    f->y0 = y0;
+    f->x1 = x1;
+    f->y1 = y1;
+    return true;
+}
+
+bool view_parse_ids(ViewFilter *f, const char *arg) {
+    f->num_ids = 0;
+    const char *p = arg;
+    while (*p) {
+        char *end;
+        long id = strtol(p, &end, 10);
+        if (end == p || id < 0 || id >= MAX_VEHICLES || f->num_ids == MAX_VIEW_IDS ||
+            (*end != ',' && *end != '\0')) {
+            fprintf(stderr, "ids must be up to %d vehicle ids 0..%d, comma-separated\n",
+                    MAX_VIEW_IDS, MAX_VEHICLES - 1);
+            return false;
+        }
+        f->ids[f->num_ids++] = (int)id;
+        p = *end ? end + 1 : end;
+    }
+    f->flags |= VIEW_IDS;
+    return f->num_ids > 0;
+}
+
+/* ---------------- SERVER ---------------- */
+
+/* The segment is world-writable: nothing in a copied filter is trusted. */
+static bool filter_valid(const ViewFilter *f) {
+    return f->num_ids >= 0 && f->num_ids <= MAX_VIEW_IDS &&
+           isfinite(f->rate) && f->rate >= 0.0 &&
+           isfinite(f->x0) && isfinite(f->y0) && isfinite(f->x1) && isfinite(f->y1);
+}
+
+bool view_copy_filter(const ViewSlot *s, ViewFilter *f) {
+    for (int i = 0; i < VIEW_FILTER_TRIES; i++) {
+        unsigned seq = atomic_load_explicit(&s->filter_seq, memory_order_acquire);
+        if (seq & 1)
+            continue;
+
+        *f = s->filter;
+
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&s->filter_seq, memory_order_relaxed) == seq)
+            return filter_valid(f);
+    }
+    return false;
+}
+
+void view_publish(ViewSlot *s, double sim_time, const int *match, int count) {
+    unsigned seq = atomic_load_explicit(&s->seq, memory_order_relaxed);
+
+    atomic_store_explicit(&s->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    s->frame++;
+    s->sim_time = sim_time;
+    s->count = count;
+    memcpy(s->match, match, count * sizeof(int));
+
+    atomic_store_explicit(&s->seq, seq + 2, memory_order_release);
+}
@@ -0,0 +1,58 @@
+#ifndef VIEW_H
+#define VIEW_H
+
+#include <stdbool.h>
+
+#include "common.h"
+
+/*
+ * Area-of-interest subscriptions over the shared memory segment (the slot
+ * layout is in common.h).
+ *
+ *     ViewFilter f = { .flags = VIEW_REGION, .x0 = -50, .y0 = 0,
+ *                      .x1 = 50, .y1 = 200, .rate = 10 };
+ *     int slot = view_subscribe(sim, &f);
+ *     ...
+ *     if (view_read(sim, slot, last, &frame))
+ *         for each frame.match[i]: car_read(&sim->cars[frame.match[i]], ...)
+ *     ...
+ *     view_unsubscribe(sim, slot);
+ *
+ * The server serves every active slot once per tick round, or at the
+ * filter's rate, using a hash grid over the vehicles for regions.
+ */
+
+typedef struct {
+    unsigned frame;
+    double   sim_time;
+    int      count;
+    int      match[MAX_VEHICLES];
+} ViewFrame;
+
+/* ---------------- VIEWER ---------------- */
+
+/* Slot index, or -1 (with a message) if every slot is taken. */
+int  view_subscribe(SimShared *sim, const ViewFilter *f);
+void view_set_filter(SimShared *sim, int slot, const ViewFilter *f);
+void view_unsubscribe(SimShared *sim, int slot);
+
+/* The slot's latest frame, if it is newer than frame number `after`. */
+bool view_read(const SimShared *sim, int slot, unsigned after, ViewFrame *out);
+
+/* "x0,y0,x1,y1" and "3,7,12" (-a / -I); false (with a message) if malformed. */
+bool view_parse_area(ViewFilter *f, const char *arg);
+bool view_parse_ids(ViewFilter *f, const char *arg);
+
+/* ---------------- SERVER ---------------- */
+
+/* A consistent copy of the slot's filter; false if the viewer was still
+ * changing it after VIEW_FILTER_TRIES looks (or died half way through:
+ * the server's reaping frees such a slot), or if the copy is out of range:
+ * num_ids beyond 0..MAX_VIEW_IDS, a negative or non-finite rate, or a
+ * non-finite box. */
+#define VIEW_FILTER_TRIES 64
+bool view_copy_filter(const ViewSlot *s, ViewFilter *f);
+
+void view_publish(ViewSlot *s, double sim_time, const int *match, int count);
+
+#endif